@@ -45,6 +45,17 @@ void GLContainer::display_block()
         glUniform1i(glGetUniformLocation(display_compute_shader, "current"), 0);
         glUniform1i(glGetUniformLocation(display_compute_shader, "block"),   2 + tex_offset);
         glUniform1i(glGetUniformLocation(display_compute_shader, "lighting"), 6);
+        glUniform3iv(glGetUniformLocation(display_compute_shader, "block_offset"), 1, glm::value_ptr(block_offset));
+
+        // the content box, in the space of the [-1,1] cube - the whole cube while shifted, since content wraps around
+        glm::vec3 box_min = glm::vec3(-1), box_max = glm::vec3(1);
+        if(tight_bounds && block_offset == glm::ivec3(0))
+        {
+            box_min = glm::vec3(content_min) * (2.0f / DIM) - glm::vec3(1);
+            box_max = glm::vec3(content_max + glm::ivec3(1)) * (2.0f / DIM) - glm::vec3(1);
+        }
+        glUniform3fv(glGetUniformLocation(display_compute_shader, "content_min"), 1, glm::value_ptr(box_min));
+        glUniform3fv(glGetUniformLocation(display_compute_shader, "content_max"), 1, glm::value_ptr(box_max));
 
         // rotation parameters
         glUniform1f(glGetUniformLocation(display_compute_shader, "theta"), theta);
@@ -160,6 +171,22 @@ void GLContainer::single_screenshot()
             image_bytes_to_save[output_base+1] = temp[input_base+1];
             image_bytes_to_save[output_base+2] = temp[input_base+2];
         }
+
+    // cropped to where the content's box lands on the screen
+    glm::ivec3 lo, hi;
+    if(crop_screenshots && content_bounds(crop_threshold, lo, hi))
+    {
+        glm::ivec2 min, max;
+        screen_rect(lo, hi, min, max);
+
+        temp.clear();
+        for(int y = min.y; y <= max.y; y++)
+            temp.insert(temp.end(), image_bytes_to_save.begin() + 3 * (y * width + min.x), image_bytes_to_save.begin() + 3 * (y * width + max.x + 1));
+
+        image_bytes_to_save.swap(temp);
+        width = max.x - min.x + 1;
+        height = max.y - min.y + 1;
+    }
     
     //save the resulting image - using the same buffer makes it so you don't have to copy it 
     unsigned error = lodepng::encode( filename.c_str( ), image_bytes_to_save, width, height, LCT_RGB, 8 );
@@ -270,53 +297,189 @@ void GLContainer::display_orientation_widget()
 // ------------------------
 // ------------------------
 // initialization functions
+
+// defines for one pass of the separable gaussian - only the last (z) pass looks at touch_alpha and respect_mask,
+// so the others don't get separate variants for them
+static shader_defines gaussian_pass_defines(bool mask_pass, int axis, bool touch_alpha, bool respect_mask, bool roi_mask)
+{
+    bool last = (axis == 2);
+    return {{"AXIS", std::to_string(axis)}, {"MASK_PASS", mask_pass ? "1" : "0"},
+            {"TOUCH_ALPHA", (last && !mask_pass && touch_alpha) ? "1" : "0"}, {"RESPECT_MASK", (last && respect_mask) ? "1" : "0"},
+            {"ROI_MASK", (last && roi_mask) ? "1" : "0"}};
+}
+
+// defines for one pass of the summed volume table - only the x pass reads the source, so only it cares which channel
+static shader_defines summed_volume_pass_defines(int axis, int channel)
+{
+    return {{"AXIS", std::to_string(axis)}, {"CHANNEL", axis == 0 ? std::to_string(channel) : "0"}};
+}
+
+// sizes for the light list shaders, from includes.h
+static shader_defines light_list_defines()
+{
+    return {{"LIGHT_LIST_MAX", std::to_string(LIGHT_LIST_MAX)}, {"LIGHT_LIST_RES", std::to_string(LIGHT_LIST_RES)}, {"LIGHT_LIST_SHELLS", std::to_string(LIGHT_LIST_SHELLS)}};
+}
+
 void GLContainer::compile_shaders()
 {
-  // reporting status is not super important, just compile them - may want to add some code to
-  // the shader class (and cshader class) to report the filename upon unsuccessful compilation
+  // compute shaders are registered here, but not compiled - each one is compiled the first time it is
+  // used, so time to first frame does not depend on how many operations there are. If the driver supports
+  // parallel shader compilation, everything gets kicked off right away and finishes on the driver's threads,
+  // otherwise nothing is compiled ahead of time - a compile would block the frame it happened in either way.
 
     // ------------------------
     // compiling display shaders
 
-    display_compute_shader    = CShader("resources/code/shaders/raycast.cs.glsl").Program;
+    register_shader(display_compute_shader, "resources/code/shaders/raycast.cs.glsl");
     display_shader            = Shader("resources/code/shaders/blit.vs.glsl", "resources/code/shaders/blit.fs.glsl").Program;
     orientation_widget_shader = Shader("resources/code/shaders/widget.vs.glsl", "resources/code/shaders/widget.fs.glsl").Program;
     cout << "display shaders ................... done." << endl;
 
     // ------------------------
-    // compiling compute shaders - note that ___.cs.glsl is just a placeholder with the bare minimum to compile
+    // registering compute shaders - note that ___.cs.glsl is just a placeholder with the bare minimum to compile
+
+    // flags that used to be uniforms are #defines now, and each combination is its own program - these are
+    // the lists of variants that get prewarmed (the shader preprocessor lives in shader.h)
+    std::vector<shader_defines> draw_mask = shader_define_combinations({{"DRAW", {"0", "1"}}, {"MASK", {"0", "1"}}});
+    std::vector<shader_defines> respect   = shader_define_combinations({{"RESPECT_MASK", {"0", "1"}}});
+    std::vector<shader_defines> roi       = shader_define_combinations({{"ROI_MASK", {"0", "1"}}});
+    std::vector<shader_defines> clearing  = shader_define_combinations({{"RESPECT_MASK", {"0", "1"}}, {"ROI_MASK", {"0", "1"}}});
+    std::vector<shader_defines> box       = shader_define_combinations({{"CHANNEL", {"0", "1", "2", "3", "4"}}, {"RESPECT_MASK", {"0", "1"}}, {"ROI_MASK", {"0", "1"}}, {"BRICK_LIST", {"1"}}});
+    std::vector<shader_defines> shifting  = shader_define_combinations({{"LOOP", {"0", "1"}}, {"MODE", {"1", "2", "3"}}, {"ROI_MASK", {"0", "1"}}});
+    std::vector<shader_defines> fake_GI   = shader_define_combinations({{"PASS", {"0", "1", "2"}}, {"SOURCE_IS_LIGHTING", {"0", "1"}}});
+    std::vector<shader_defines> distance  = shader_define_combinations({{"PASS", {"0", "1", "2"}}});
+    std::vector<shader_defines> morphology = shader_define_combinations({{"ERODE", {"0", "1"}}, {"RESPECT_MASK", {"0", "1"}}, {"ROI_MASK", {"0", "1"}}});
+    std::vector<shader_defines> undo      = shader_define_combinations({{"PASS", {"0", "1", "2", "3"}}});
+    undo.push_back({{"PASS", "0"}, {"BRICK_LIST", "1"}});
+    std::vector<shader_defines> components = shader_define_combinations({{"PASS", {"0", "1", "2", "3"}}});
+    std::vector<shader_defines> clipboard = shader_define_combinations({{"PASS", {"0", "1"}}, {"MASKED_ONLY", {"0", "1"}}});
+    std::vector<shader_defines> pasting   = shader_define_combinations({{"PASS", {"2"}}, {"RESPECT_MASK", {"0", "1"}}, {"OVERWRITE", {"0", "1"}}});
+    clipboard.insert(clipboard.end(), pasting.begin(), pasting.end());
+    std::vector<shader_defines> pyramid   = shader_define_combinations({{"LEVEL0", {"0", "1"}}});
+    std::vector<shader_defines> cone_GI   = shader_define_combinations({{"CONES", {"6", "16", "32"}}});
+    std::vector<shader_defines> bricks    = shader_define_combinations({{"BRICK_LIST", {"1"}}});
+    std::vector<shader_defines> sparse    = shader_define_combinations({{"BRICK_LIST", {"0", "1"}}});
+    std::vector<shader_defines> mashing   = shader_define_combinations({{"ROI_MASK", {"0", "1"}}, {"BRICK_LIST", {"1"}}});
+    std::vector<shader_defines> brick_list = {{{"PASS", "0"}}, {{"PASS", "1"}, {"AXIS", "0"}}, {{"PASS", "1"}, {"AXIS", "1"}},
+                                              {{"PASS", "1"}, {"AXIS", "2"}}, {{"PASS", "2"}}, {{"PASS", "3"}}, {{"PASS", "4"}}};
+
+    std::set<shader_defines> gaussian_set;
+    for(int p = 0; p < 16; p++)
+        for(int axis = 0; axis < 3; axis++)
+            gaussian_set.insert(gaussian_pass_defines(p & 1, axis, p & 2, p & 4, p & 8));
+    std::vector<shader_defines> gaussian(gaussian_set.begin(), gaussian_set.end());
+
+    std::set<shader_defines> summed_volume_set;
+    for(int axis = 0; axis < 3; axis++)
+        for(int channel = 0; channel < 5; channel++)
+            summed_volume_set.insert(summed_volume_pass_defines(axis, channel));
+    std::vector<shader_defines> summed_volume(summed_volume_set.begin(), summed_volume_set.end());
 
     // Shapes
-    aabb_compute                     = CShader("resources/code/shaders/aabb.cs.glsl").Program;               cout << "aabb shader ....................... done." << endl;
-    cuboid_compute                   = CShader("resources/code/shaders/cuboid.cs.glsl").Program;             cout << "cuboid shader ..................... done." << endl;
-    cylinder_compute                 = CShader("resources/code/shaders/cylinder.cs.glsl").Program;           cout << "cylinder shader ................... done." << endl;
-    ellipsoid_compute                = CShader("resources/code/shaders/ellipsoid.cs.glsl").Program;          cout << "ellipsoid shader .................. done." << endl;
-    grid_compute                     = CShader("resources/code/shaders/grid.cs.glsl").Program;               cout << "grid shader ....................... done." << endl;
-    heightmap_compute                = CShader("resources/code/shaders/heightmap.cs.glsl").Program;          cout << "heightmap shader .................. done." << endl;
-    perlin_compute                   = CShader("resources/code/shaders/perlin.cs.glsl").Program;             cout << "perlin shader ..................... done." << endl;
-    sphere_compute                   = CShader("resources/code/shaders/sphere.cs.glsl").Program;             cout << "sphere shader ..................... done." << endl;
-    tube_compute                     = CShader("resources/code/shaders/tube.cs.glsl").Program;               cout << "tube shader ....................... done." << endl;
-    triangle_compute                 = CShader("resources/code/shaders/triangle.cs.glsl").Program;           cout << "triangle shader ................... done." << endl;
+    register_shader(aabb_compute,                      "resources/code/shaders/aabb.cs.glsl", draw_mask);
+    register_shader(cuboid_compute,                    "resources/code/shaders/cuboid.cs.glsl", draw_mask);
+    register_shader(cylinder_compute,                  "resources/code/shaders/cylinder.cs.glsl", draw_mask);
+    register_shader(ellipsoid_compute,                 "resources/code/shaders/ellipsoid.cs.glsl", draw_mask);
+    register_shader(grid_compute,                      "resources/code/shaders/grid.cs.glsl", draw_mask);
+    register_shader(heightmap_compute,                 "resources/code/shaders/heightmap.cs.glsl", draw_mask);
+    register_shader(perlin_compute,                    "resources/code/shaders/perlin.cs.glsl", draw_mask);
+    register_shader(sphere_compute,                    "resources/code/shaders/sphere.cs.glsl", draw_mask);
+    register_shader(tube_compute,                      "resources/code/shaders/tube.cs.glsl", draw_mask);
+    register_shader(triangle_compute,                  "resources/code/shaders/triangle.cs.glsl", draw_mask);
 
     // GPU-side utilities
-    clear_all_compute                = CShader("resources/code/shaders/clear_all.cs.glsl").Program;          cout << "clear_all shader .................. done." << endl;
-    unmask_all_compute               = CShader("resources/code/shaders/unmask_all.cs.glsl").Program;         cout << "unmask_all shader ................. done." << endl;
-    invert_mask_compute              = CShader("resources/code/shaders/invert_mask.cs.glsl").Program;        cout << "invert_mask shader ................ done." << endl;
-    mask_by_color_compute            = CShader("resources/code/shaders/mask_by_color.cs.glsl").Program;      cout << "mask_by_color shader .............. done." << endl;
-    box_blur_compute                 = CShader("resources/code/shaders/box_blur.cs.glsl").Program;           cout << "box blur shader ................... done." << endl;
-    gaussian_blur_compute            = CShader("resources/code/shaders/gauss_blur.cs.glsl").Program;         cout << "gaussian blur shader .............. done." << endl;
-    shift_compute                    = CShader("resources/code/shaders/shift.cs.glsl").Program;              cout << "shift shader ...................... done." << endl;
-    copy_loadbuff_compute            = CShader("resources/code/shaders/copy_loadbuff.cs.glsl").Program;      cout << "loadbuffer copy shader ............ done." << endl;
+    register_shader(clear_all_compute,                 "resources/code/shaders/clear_all.cs.glsl", clearing);
+    register_shader(unmask_all_compute,                "resources/code/shaders/unmask_all.cs.glsl", roi);
+    register_shader(invert_mask_compute,               "resources/code/shaders/invert_mask.cs.glsl", roi);
+    register_shader(mask_by_color_compute,             "resources/code/shaders/mask_by_color.cs.glsl", roi);
+    register_shader(components_compute,                "resources/code/shaders/components.cs.glsl", components);
+    register_shader(summed_volume_compute,             "resources/code/shaders/summed_volume.cs.glsl", summed_volume);
+    register_shader(box_blur_compute,                  "resources/code/shaders/box_blur.cs.glsl", box);
+    register_shader(gaussian_blur_compute,             "resources/code/shaders/gauss_blur.cs.glsl", gaussian);
+    register_shader(distance_field_compute,            "resources/code/shaders/distance_field.cs.glsl", distance);
+    register_shader(morphology_compute,                "resources/code/shaders/morphology.cs.glsl", morphology);
+    register_shader(shift_compute,                     "resources/code/shaders/shift.cs.glsl", shifting);
+    register_shader(clipboard_compute,                 "resources/code/shaders/clipboard.cs.glsl", clipboard);
+    register_shader(copy_loadbuff_compute,             "resources/code/shaders/copy_loadbuff.cs.glsl", respect);
 
     // Lighting
-    lighting_clear_compute           = CShader("resources/code/shaders/light_clear.cs.glsl").Program;        cout << "light_clear shader ................ done." << endl;
-    new_directional_lighting_compute = CShader("resources/code/shaders/new_directional.cs.glsl").Program;    cout << "new directional light shader ...... done." << endl;
-    point_lighting_compute           = CShader("resources/code/shaders/point_light.cs.glsl").Program;        cout << "point light shader ................ done." << endl;
-    cone_lighting_compute            = CShader("resources/code/shaders/cone_light.cs.glsl").Program;         cout << "cone light shader ................. done." << endl;
-    ambient_occlusion_compute        = CShader("resources/code/shaders/ambient_occlusion.cs.glsl").Program;  cout << "ambient occlusion shader .......... done." << endl;
-    fakeGI_compute                   = CShader("resources/code/shaders/fakeGI.cs.glsl").Program;             cout << "fake global illumination shader ... done." << endl;
-    mash_compute                     = CShader("resources/code/shaders/mash.cs.glsl").Program;               cout << "lighting mash shader .............. done." << endl;
+    register_shader(lighting_clear_compute,            "resources/code/shaders/light_clear.cs.glsl");
+    register_shader(new_directional_lighting_compute,  "resources/code/shaders/new_directional.cs.glsl");
+    register_shader(light_cube_compute,                "resources/code/shaders/light_cube.cs.glsl");
+    register_shader(point_lighting_compute,            "resources/code/shaders/point_light.cs.glsl", sparse);
+    register_shader(cone_lighting_compute,             "resources/code/shaders/cone_light.cs.glsl", sparse);
+    register_shader(light_list_shadow_compute,         "resources/code/shaders/light_list_shadow.cs.glsl", {light_list_defines()});
+    register_shader(light_list_compute,                "resources/code/shaders/light_list.cs.glsl", {light_list_defines()});
+    register_shader(ambient_occlusion_compute,         "resources/code/shaders/ambient_occlusion.cs.glsl", bricks);
+    register_shader(fakeGI_compute,                    "resources/code/shaders/fakeGI.cs.glsl", fake_GI);
+    register_shader(gi_pyramid_compute,                "resources/code/shaders/gi_pyramid.cs.glsl", pyramid);
+    register_shader(cone_GI_compute,                   "resources/code/shaders/cone_gi.cs.glsl", cone_GI);
+    register_shader(mash_compute,                      "resources/code/shaders/mash.cs.glsl", mashing);
+
+    // undo history
+    register_shader(undo_compute,                      "resources/code/shaders/undo.cs.glsl", undo);
+
+    // brick lists, for indirect dispatch
+    register_shader(brick_list_compute,                "resources/code/shaders/brick_list.cs.glsl", brick_list);
+
+    // statistics
+    register_shader(statistics_compute,                "resources/code/shaders/statistics.cs.glsl");
+
+    if(parallel_shader_compile_available())
+    {
+        // the driver compiles these on its own threads - this returns right away
+        for(auto s : compute_shaders)
+            s->prewarm();
+        cout << "compute shaders ................... compiling in parallel." << endl;
+    }
+    else
+    {
+        cout << "compute shaders ................... deferred to first use." << endl;
+    }
+}
+
+void GLContainer::register_shader(LazyCShader &s, std::string path, std::vector<shader_defines> variants)
+{
+    s = LazyCShader(path);
+
+    if(variants.empty())
+        compute_shaders.push_back(&s);
+    else // only the specialized versions are ever used, so only those are worth prewarming
+        for(auto &d : variants)
+            compute_shaders.push_back(&s.variant(d));
+}
+
+int GLContainer::shaders_pending()
+{
+    // without parallel compile nothing happens in the background, so there's nothing to wait on
+    if(!parallel_shader_compile_available())
+        return 0;
+
+    int count = 0;
+    for(auto s : compute_shaders)
+        if(!s->ready())
+            count++;
+    return count;
+}
+
+void GLContainer::prewarm_shaders(int count)
+{
+    // without parallel compile, each of these would block the frame while it compiled - those are left to their
+    // first use instead
+    if(!parallel_shader_compile_available())
+        return;
+
+    for(auto s : compute_shaders)
+    {
+        if(count <= 0)
+            break;
 
+        if(!s->started_compile())
+        {
+            s->prewarm();
+            count--;
+        }
+    }
 }
 
 void GLContainer::buffer_geometry()
@@ -614,13 +777,13 @@ void GLContainer::load_textures()
     //     }
 
     random.resize(4*screen_height*screen_width*SSFACTOR*SSFACTOR);
-    light.resize(3*DIM*DIM*DIM, 64); // fill the array with '64'
+    light.resize(3*LIGHT_DIM*LIGHT_DIM*LIGHT_DIM, 64); // fill the array with '64'
     zeroes.resize(3*DIM*DIM*DIM, 0); // fill the array with zeroes
 
 
     cout << "Creating texture handles...";
     // create all the texture handles
-    glGenTextures(13, &textures[0]);
+    glGenTextures(17, &textures[0]);
     cout << "...........done." << endl;
     
     class MyNumPunct : public std::numpunct<char>
@@ -677,49 +840,56 @@ void GLContainer::load_textures()
     glBindImageTexture(3, textures[3], 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
     cout << "...........done." << endl;
     
-    cout << "mask voxel blocks at " << DIM << " resolution (" << DIM*DIM*DIM*2 << " bytes)......." ;
+    cout << "mask voxel blocks at " << DIM << " resolution (" << DIM*DIM*DIM/4 << " bytes)......." ;
     
+    // the masks are bit-packed, 32 voxels along x to a uint - see shaders/include/mask.glsl. Anything that
+    // reads or writes them has to go through the macros there, they can't be sampled or treated as r8
     // main block front mask buffer - initially empty
     glActiveTexture(GL_TEXTURE0 + 4);
     glBindTexture(GL_TEXTURE_3D, textures[4]);
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, DIM, DIM, DIM, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R32UI, DIM/32, DIM, DIM, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
     // glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     // glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindImageTexture(4, textures[4], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R8);
+    glBindImageTexture(4, textures[4], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 
 
     // main block back mask buffer - initially empty
     glActiveTexture(GL_TEXTURE0 + 5);
     glBindTexture(GL_TEXTURE_3D, textures[5]);
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, DIM, DIM, DIM, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R32UI, DIM/32, DIM, DIM, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
     // glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     // glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindImageTexture(5, textures[5], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R8);
+    glBindImageTexture(5, textures[5], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 
     cout << "...........done." << endl;
 
-    cout << "light buffer voxel blocks at " << DIM << " resolution (" << DIM*DIM*DIM*2 << " bytes)......." ;
+    cout << "light buffer voxel blocks at " << LIGHT_DIM << " resolution (" << LIGHT_DIM*LIGHT_DIM*LIGHT_DIM*4*2 << " bytes)......." ;
 
-    // display lighting buffer - initialize with some base value representing neutral coloration
+    // display lighting buffer - initialize with some base value representing neutral coloration. RGB, packed
+    // as three small floats in 32 bits - a quarter of the size of RGBA32F, and with the range to stack up
+    // bright lights without clamping at 1.0 like an 8-bit buffer does. LIGHT_SCALE times coarser than the block
     glActiveTexture(GL_TEXTURE0 + 6);
     glBindTexture(GL_TEXTURE_3D, textures[6]);
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, DIM, DIM, DIM, 0, GL_RED, GL_UNSIGNED_BYTE, &light[0]);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R11F_G11F_B10F, LIGHT_DIM, LIGHT_DIM, LIGHT_DIM, 0, GL_RGB, GL_UNSIGNED_BYTE, &light[0]);
     // glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     // glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindImageTexture(6, textures[6], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R8);
+    glBindImageTexture(6, textures[6], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R11F_G11F_B10F);
 
 
     // lighting cache buffer - this is going to have the same data in it as the regular lighting buffer initially
     glActiveTexture(GL_TEXTURE0 + 7);
     glBindTexture(GL_TEXTURE_3D, textures[7]);
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, DIM, DIM, DIM, 0, GL_RED, GL_UNSIGNED_BYTE, &light[0]);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R11F_G11F_B10F, LIGHT_DIM, LIGHT_DIM, LIGHT_DIM, 0, GL_RGB, GL_UNSIGNED_BYTE, &light[0]);
     // glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     // glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindImageTexture(7, textures[7], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R8);
+    glBindImageTexture(7, textures[7], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R11F_G11F_B10F);
+
+    // so until the first lighting clear, relighting after an edit starts over from the cache
+    lighting_history.push_back({[=]{ lighting_clear(true); }, [](glm::ivec3 &, glm::ivec3 &){}});
 
     cout << "...........done." << endl;
 
-    // copy/paste front buffer - initally empty
+    // front scratch buffer - this used to hold the copy/paste buffer, which is sparse now and lives in SSBOs
     glActiveTexture(GL_TEXTURE0 + 8);
     glBindTexture(GL_TEXTURE_3D, textures[8]);
     glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, DIM, DIM, DIM, 0,  GL_RGBA, GL_UNSIGNED_BYTE, NULL);
@@ -728,7 +898,7 @@ void GLContainer::load_textures()
     glBindImageTexture(8, textures[8], 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
 
 
-    // copy/paste back buffer - initially empty
+    // back scratch buffer
     glActiveTexture(GL_TEXTURE0 + 9);
     glBindTexture(GL_TEXTURE_3D, textures[9]);
     glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, DIM, DIM, DIM, 0,  GL_RGBA, GL_UNSIGNED_BYTE, NULL);
@@ -737,6 +907,24 @@ void GLContainer::load_textures()
     glBindImageTexture(9, textures[9], 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
 
 
+    // summed volume table - not its own texture, this is the front copy/paste buffer again, seen as one 32 bit
+    // uint per texel instead of four bytes (the formats are compatible by size). Nothing that uses the table
+    // uses the copy/paste buffer at the same time, and it saves another DIM^3 * 4 bytes
+    glBindImageTexture(13, textures[8], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+
+    // light transmittance for the directional light sweep - the same idea, the back copy/paste buffer seen
+    // as one float per texel
+    glBindImageTexture(14, textures[9], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32F);
+
+    // and both of them in the same packed rgb format as the lighting buffer, so multi-pass lighting operations
+    // (fake GI) can ping-pong between them
+    glBindImageTexture(17, textures[8], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R11F_G11F_B10F);
+    glBindImageTexture(18, textures[9], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R11F_G11F_B10F);
+
+    // and as one uint per texel - the jump flood ping-pongs between this and the summed volume view on 13
+    glBindImageTexture(22, textures[9], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+
+
     // load buffer - initially empty
     glActiveTexture(GL_TEXTURE0 + 10);
     glBindTexture(GL_TEXTURE_3D, textures[10]);
@@ -746,6 +934,130 @@ void GLContainer::load_textures()
     glBindImageTexture(10, textures[10], 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
 
     
+    cout << "light cube (" << LIGHT_CUBE_RES*LIGHT_CUBE_RES*6*LIGHT_CUBE_SHELLS*2 << " bytes)......." ;
+    // light cube - transmittance from a point light, a cube map per distance shell. This gets sampled (texture
+    // unit 13, filtered and seamless across faces) and written (image unit 15 - 13 and 14 are taken by the views
+    // above). This and the shadow atlas are done ahead of the perlin texture and heightmap, so that unit 12 is
+    // still active at the end
+    glActiveTexture(GL_TEXTURE0 + 13);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, textures[13]);
+    glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_R16F, LIGHT_CUBE_RES, LIGHT_CUBE_RES, 6*LIGHT_CUBE_SHELLS, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glBindImageTexture(15, textures[13], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R16F);
+    cout << "...........done." << endl;
+
+    cout << "light list shadow atlas (" << 3*LIGHT_LIST_RES*2*LIGHT_LIST_RES*LIGHT_LIST_MAX*LIGHT_LIST_SHELLS*2 << " bytes)......." ;
+    // shadow atlas - one tile per light in the light list, stacked along y, sampled on texture unit 14 and
+    // written through image unit 16
+    glActiveTexture(GL_TEXTURE0 + 14);
+    glBindTexture(GL_TEXTURE_3D, textures[14]);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R16F, 3*LIGHT_LIST_RES, 2*LIGHT_LIST_RES*LIGHT_LIST_MAX, LIGHT_LIST_SHELLS, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindImageTexture(16, textures[14], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R16F);
+
+    // and the light list itself, which goes in a shader storage buffer at binding 0
+    glGenBuffers(1, &light_list_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, light_list_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, LIGHT_LIST_MAX * sizeof(light_t), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, light_list_buffer);
+    cout << "...........done." << endl;
+
+    // two uints for connected component labeling - whether the last pass changed anything, and how many roots
+    // there are - at binding 1
+    glGenBuffers(1, &components_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, components_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, components_buffer);
+
+    // the undo history's list of changed bricks (a count, the workgroups to gather them with, then up to every brick
+    // in the block) at binding 2, and deltas for a batch of them going back to the block at binding 3 - the buffer
+    // they're recorded into is made once the first operation is, since its size goes with the budget
+    glGenBuffers(1, &undo_list_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, undo_list_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (4 + (DIM/8)*(DIM/8)*(DIM/8)) * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, undo_list_buffer);
+
+    glGenBuffers(1, &undo_payload_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, undo_payload_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, UNDO_BATCH * UNDO_BRICK_WORDS * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, undo_payload_buffer);
+
+    // the clipboard - a count and a slot for every brick a selection can have at binding 4, and the occupied bricks
+    // at binding 5, which is sized to fit whenever something is copied
+    glGenBuffers(1, &clipboard_index_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clipboard_index_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (1 + (DIM/8)*(DIM/8)*(DIM/8)) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, clipboard_index_buffer);
+
+    glGenBuffers(1, &clipboard_data_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clipboard_data_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 512 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, clipboard_data_buffer);
+
+    // brick lists - the classes of every brick and two more arrays to dilate them through at binding 6, and a
+    // count, three workgroup counts and up to every brick in the block at binding 7, which is also where indirect
+    // dispatches read from
+    glGenBuffers(1, &brick_flags_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, brick_flags_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 3 * (DIM/8)*(DIM/8)*(DIM/8) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, brick_flags_buffer);
+
+    glGenBuffers(1, &brick_list_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, brick_list_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (4 + (DIM/8)*(DIM/8)*(DIM/8)) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, brick_list_buffer);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, brick_list_buffer);
+
+    // the list of an in-place brick edit, kept at binding 9 till the undo history has looked through it
+    glGenBuffers(1, &edit_list_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, edit_list_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (4 + (DIM/8)*(DIM/8)*(DIM/8)) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, edit_list_buffer);
+
+    // statistics - two counts, the bounds, and four 256 bin histograms at binding 8
+    glGenBuffers(1, &statistics_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statistics_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (8 + 4*256) * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, statistics_buffer);
+
+    cout << "signed distance field (" << DIM*DIM*DIM*2 << " bytes)......." ;
+    // signed distance field - one half float per voxel, sampled on texture unit 16 and written through image unit 21
+    glActiveTexture(GL_TEXTURE0 + 16);
+    glBindTexture(GL_TEXTURE_3D, textures[16]);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R16F, DIM, DIM, DIM, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindImageTexture(21, textures[16], 0, GL_TRUE, 0, GL_READ_WRITE, GL_R16F);
+    cout << "...........done." << endl;
+
+    cout << "GI radiance pyramid (" << 6*GI_RES*GI_RES*GI_RES*8*8/7 << " bytes)......." ;
+    // radiance pyramid for cone traced GI - a mipmapped 3d texture with the six directional tiles side by side
+    // along x, so every level halves them together and they stay lined up. Sampled on texture unit 15, each
+    // level is bound to image units 19 and 20 while it is built
+    glActiveTexture(GL_TEXTURE0 + 15);
+    glBindTexture(GL_TEXTURE_3D, textures[15]);
+    for(int level = 0; (GI_RES >> level) > 0; level++)
+        glTexImage3D(GL_TEXTURE_3D, level, GL_RGBA16F, 6*(GI_RES >> level), GI_RES >> level, GI_RES >> level, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, int(std::log2(GI_RES)));
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    cout << "...........done." << endl;
+
+
     cout << "perlin texture generation....." << std::flush;
 
     // perlin noise - initialize with noise at some default scaling
@@ -781,6 +1093,17 @@ void GLContainer::load_textures()
 // manipulating the block
 void GLContainer::swap_blocks()
 {
+    // everything that swaps works on the block as it is laid out - a virtual shift has to be put in place first
+    materialize_offset();
+    block_changed();
+
+    // the operation before this one is done - get it into the undo history before its starting point is written over
+    commit_undo();
+    undo_pending = true;
+    undo_from_list = false;
+    undo_min = glm::ivec3(0);
+    undo_max = glm::ivec3(DIM-1);
+
     // keep the data from moving
     tex_offset = tex_offset==1 ? 0 : 1; // because the blocks are in neighboring units, adding this value
                                      // to the number of the lower unit works to switch between them
@@ -794,23 +1117,23 @@ void GLContainer::draw_aabb(glm::vec3 min, glm::vec3 max, glm::vec4 color, bool
 {
     // need to redraw after any drawing operation is done
     redraw_flag = true;
+    mark_dirty(min, max);
 
     swap_blocks();
-    glUseProgram(aabb_compute);
+    LazyCShader &shader = aabb_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
     // Uniforms
-    glUniform1i(glGetUniformLocation(aabb_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(aabb_compute, "draw"), draw);
-    glUniform4fv(glGetUniformLocation(aabb_compute, "color"), 1, glm::value_ptr(color));
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
 
-    glUniform3fv(glGetUniformLocation(aabb_compute, "mins"), 1, glm::value_ptr(min));
-    glUniform3fv(glGetUniformLocation(aabb_compute, "maxs"), 1, glm::value_ptr(max));
+    glUniform3fv(glGetUniformLocation(shader, "mins"), 1, glm::value_ptr(min));
+    glUniform3fv(glGetUniformLocation(shader, "maxs"), 1, glm::value_ptr(max));
 
-    glUniform1i(glGetUniformLocation(aabb_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(aabb_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(aabb_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(aabb_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -820,28 +1143,29 @@ void GLContainer::draw_aabb(glm::vec3 min, glm::vec3 max, glm::vec4 color, bool
 void GLContainer::draw_cuboid(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d, glm::vec3 e, glm::vec3 f, glm::vec3 g, glm::vec3 h, glm::vec4 color, bool draw, bool mask)
 {
     redraw_flag = true;
+    mark_dirty(glm::min(glm::min(glm::min(a, b), glm::min(c, d)), glm::min(glm::min(e, f), glm::min(g, h))),
+               glm::max(glm::max(glm::max(a, b), glm::max(c, d)), glm::max(glm::max(e, f), glm::max(g, h))));
 
     swap_blocks();
-    glUseProgram(cuboid_compute);
+    LazyCShader &shader = cuboid_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(cuboid_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(cuboid_compute, "draw"), draw);
-    glUniform4fv(glGetUniformLocation(cuboid_compute, "color"), 1, glm::value_ptr(color));
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
 
-    glUniform3fv(glGetUniformLocation(cuboid_compute, "a"), 1, glm::value_ptr(a));
-    glUniform3fv(glGetUniformLocation(cuboid_compute, "b"), 1, glm::value_ptr(b));
-    glUniform3fv(glGetUniformLocation(cuboid_compute, "c"), 1, glm::value_ptr(c));
-    glUniform3fv(glGetUniformLocation(cuboid_compute, "d"), 1, glm::value_ptr(d));
-    glUniform3fv(glGetUniformLocation(cuboid_compute, "e"), 1, glm::value_ptr(e));
-    glUniform3fv(glGetUniformLocation(cuboid_compute, "f"), 1, glm::value_ptr(f));
-    glUniform3fv(glGetUniformLocation(cuboid_compute, "g"), 1, glm::value_ptr(g));
-    glUniform3fv(glGetUniformLocation(cuboid_compute, "h"), 1, glm::value_ptr(h));
+    glUniform3fv(glGetUniformLocation(shader, "a"), 1, glm::value_ptr(a));
+    glUniform3fv(glGetUniformLocation(shader, "b"), 1, glm::value_ptr(b));
+    glUniform3fv(glGetUniformLocation(shader, "c"), 1, glm::value_ptr(c));
+    glUniform3fv(glGetUniformLocation(shader, "d"), 1, glm::value_ptr(d));
+    glUniform3fv(glGetUniformLocation(shader, "e"), 1, glm::value_ptr(e));
+    glUniform3fv(glGetUniformLocation(shader, "f"), 1, glm::value_ptr(f));
+    glUniform3fv(glGetUniformLocation(shader, "g"), 1, glm::value_ptr(g));
+    glUniform3fv(glGetUniformLocation(shader, "h"), 1, glm::value_ptr(h));
 
-    glUniform1i(glGetUniformLocation(aabb_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(aabb_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(aabb_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(aabb_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -851,23 +1175,23 @@ void GLContainer::draw_cuboid(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d
 void GLContainer::draw_cylinder(glm::vec3 bvec, glm::vec3 tvec, float radius, glm::vec4 color, bool draw, bool mask)
 {
     redraw_flag = true;
+    mark_dirty(glm::min(bvec, tvec) - radius, glm::max(bvec, tvec) + radius);
 
     swap_blocks();
-    glUseProgram(cylinder_compute);
+    LazyCShader &shader = cylinder_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(cylinder_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(cylinder_compute, "draw"), draw);
-    glUniform4fv(glGetUniformLocation(cylinder_compute, "color"), 1, glm::value_ptr(color));
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
 
-    glUniform1fv(glGetUniformLocation(cylinder_compute, "radius"), 1, &radius);
-    glUniform3fv(glGetUniformLocation(cylinder_compute, "bvec"), 1, glm::value_ptr(bvec));
-    glUniform3fv(glGetUniformLocation(cylinder_compute, "tvec"), 1, glm::value_ptr(tvec));
+    glUniform1fv(glGetUniformLocation(shader, "radius"), 1, &radius);
+    glUniform3fv(glGetUniformLocation(shader, "bvec"), 1, glm::value_ptr(bvec));
+    glUniform3fv(glGetUniformLocation(shader, "tvec"), 1, glm::value_ptr(tvec));
 
-    glUniform1i(glGetUniformLocation(aabb_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(aabb_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(aabb_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(aabb_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -877,23 +1201,24 @@ void GLContainer::draw_cylinder(glm::vec3 bvec, glm::vec3 tvec, float radius, gl
 void GLContainer::draw_ellipsoid(glm::vec3 center, glm::vec3 radii, glm::vec3 rotation, glm::vec4 color, bool draw, bool mask)
 {
     redraw_flag = true;
+    float extent = std::max(std::max(radii.x, radii.y), radii.z); // it can be rotated any which way
+    mark_dirty(center - extent, center + extent);
 
     swap_blocks();
-    glUseProgram(ellipsoid_compute);
+    LazyCShader &shader = ellipsoid_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(ellipsoid_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(ellipsoid_compute, "draw"), draw);
-    glUniform4fv(glGetUniformLocation(ellipsoid_compute, "color"), 1, glm::value_ptr(color));
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
 
-    glUniform3fv(glGetUniformLocation(ellipsoid_compute, "radii"), 1, glm::value_ptr(radii));
-    glUniform3fv(glGetUniformLocation(ellipsoid_compute, "rotation"), 1, glm::value_ptr(rotation));
-    glUniform3fv(glGetUniformLocation(ellipsoid_compute, "center"), 1, glm::value_ptr(center));
+    glUniform3fv(glGetUniformLocation(shader, "radii"), 1, glm::value_ptr(radii));
+    glUniform3fv(glGetUniformLocation(shader, "rotation"), 1, glm::value_ptr(rotation));
+    glUniform3fv(glGetUniformLocation(shader, "center"), 1, glm::value_ptr(center));
 
-    glUniform1i(glGetUniformLocation(ellipsoid_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(ellipsoid_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(ellipsoid_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(ellipsoid_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -1027,23 +1352,23 @@ void GLContainer::draw_regular_icosahedron(double x_rot, double y_rot, double z_
 void GLContainer::draw_grid(glm::ivec3 spacing, glm::ivec3 widths, glm::ivec3 offsets, glm::vec4 color, bool draw, bool mask)
 {
     redraw_flag = true;
+    mark_dirty();
 
     swap_blocks();
-    glUseProgram(grid_compute);
+    LazyCShader &shader = grid_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(grid_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(grid_compute, "draw"), draw);
-    glUniform4fv(glGetUniformLocation(grid_compute, "color"), 1, glm::value_ptr(color));
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
 
-    glUniform3i(glGetUniformLocation(grid_compute, "spacing"), spacing.x, spacing.y, spacing.z);
-    glUniform3i(glGetUniformLocation(grid_compute, "offsets"), offsets.x, offsets.y, offsets.z);
-    glUniform3i(glGetUniformLocation(grid_compute, "width"), widths.x, widths.y, widths.z);
+    glUniform3i(glGetUniformLocation(shader, "spacing"), spacing.x, spacing.y, spacing.z);
+    glUniform3i(glGetUniformLocation(shader, "offsets"), offsets.x, offsets.y, offsets.z);
+    glUniform3i(glGetUniformLocation(shader, "width"), widths.x, widths.y, widths.z);
 
-    glUniform1i(glGetUniformLocation(grid_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(grid_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(grid_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(grid_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -1053,23 +1378,23 @@ void GLContainer::draw_grid(glm::ivec3 spacing, glm::ivec3 widths, glm::ivec3 of
 void GLContainer::draw_heightmap(float height_scale, bool height_color, glm::vec4 color, bool mask, bool draw)
 {
     redraw_flag = true;
+    mark_dirty();
 
     swap_blocks();
-    glUseProgram(heightmap_compute);
+    LazyCShader &shader = heightmap_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(heightmap_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(heightmap_compute, "draw"), draw);
-    glUniform4fv(glGetUniformLocation(heightmap_compute, "color"), 1, glm::value_ptr(color));
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
 
-    glUniform1i(glGetUniformLocation(heightmap_compute, "height_color"), height_color);
-    glUniform1i(glGetUniformLocation(heightmap_compute, "map"), 12);
-    glUniform1f(glGetUniformLocation(heightmap_compute, "vscale"), height_scale);
+    glUniform1i(glGetUniformLocation(shader, "height_color"), height_color);
+    glUniform1i(glGetUniformLocation(shader, "map"), 12);
+    glUniform1f(glGetUniformLocation(shader, "vscale"), height_scale);
 
-    glUniform1i(glGetUniformLocation(heightmap_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(heightmap_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(heightmap_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(heightmap_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -1079,26 +1404,26 @@ void GLContainer::draw_heightmap(float height_scale, bool height_color, glm::vec
 void GLContainer::draw_perlin_noise(float low_thresh, float high_thresh, bool smooth, glm::vec4 color, bool draw, bool mask)
 {
     redraw_flag = true;
+    mark_dirty();
 
     swap_blocks();
-    glUseProgram(perlin_compute);
+    LazyCShader &shader = perlin_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(perlin_compute, "usmooth"), smooth);
+    glUniform1i(glGetUniformLocation(shader, "usmooth"), smooth);
 
-    glUniform1i(glGetUniformLocation(perlin_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(perlin_compute, "draw"), draw);
-    glUniform4fv(glGetUniformLocation(perlin_compute, "ucolor"), 1, glm::value_ptr(color));
+    glUniform4fv(glGetUniformLocation(shader, "ucolor"), 1, glm::value_ptr(color));
 
-    glUniform1i(glGetUniformLocation(perlin_compute, "tex"), 11);
+    glUniform1i(glGetUniformLocation(shader, "tex"), 11);
 
-    glUniform1f(glGetUniformLocation(perlin_compute, "low_thresh"), low_thresh);
-    glUniform1f(glGetUniformLocation(perlin_compute, "high_thresh"), high_thresh);
+    glUniform1f(glGetUniformLocation(shader, "low_thresh"), low_thresh);
+    glUniform1f(glGetUniformLocation(shader, "high_thresh"), high_thresh);
 
-    glUniform1i(glGetUniformLocation(heightmap_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(heightmap_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(heightmap_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(heightmap_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -1108,22 +1433,22 @@ void GLContainer::draw_perlin_noise(float low_thresh, float high_thresh, bool sm
 void GLContainer::draw_sphere(glm::vec3 location, float radius, glm::vec4 color, bool draw, bool mask)
 {
     redraw_flag = true;
+    mark_dirty(location - radius, location + radius);
 
     swap_blocks();
-    glUseProgram(sphere_compute);
+    LazyCShader &shader = sphere_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(sphere_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(sphere_compute, "draw"), draw);
-    glUniform4fv(glGetUniformLocation(sphere_compute, "color"), 1, glm::value_ptr(color));
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
 
-    glUniform1fv(glGetUniformLocation(sphere_compute, "radius"), 1, &radius);
-    glUniform3fv(glGetUniformLocation(sphere_compute, "location"), 1, glm::value_ptr(location));
+    glUniform1fv(glGetUniformLocation(shader, "radius"), 1, &radius);
+    glUniform3fv(glGetUniformLocation(shader, "location"), 1, glm::value_ptr(location));
 
-    glUniform1i(glGetUniformLocation(sphere_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(sphere_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(sphere_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(sphere_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -1133,23 +1458,23 @@ void GLContainer::draw_sphere(glm::vec3 location, float radius, glm::vec4 color,
 void GLContainer::draw_tube(glm::vec3 bvec, glm::vec3 tvec, float inner_radius, float outer_radius, glm::vec4 color, bool draw, bool mask)
 {
     redraw_flag = true;
+    mark_dirty(glm::min(bvec, tvec) - outer_radius, glm::max(bvec, tvec) + outer_radius);
 
     swap_blocks();
-    glUseProgram(tube_compute);
+    LazyCShader &shader = tube_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(tube_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(tube_compute, "draw"), draw);
-    glUniform1fv(glGetUniformLocation(tube_compute, "iradius"), 1, &inner_radius);
-    glUniform1fv(glGetUniformLocation(tube_compute, "oradius"), 1, &outer_radius);
-    glUniform3fv(glGetUniformLocation(tube_compute, "bvec"), 1, glm::value_ptr(bvec));
-    glUniform3fv(glGetUniformLocation(tube_compute, "tvec"), 1, glm::value_ptr(tvec));
-    glUniform4fv(glGetUniformLocation(tube_compute, "color"), 1, glm::value_ptr(color));
+    glUniform1fv(glGetUniformLocation(shader, "iradius"), 1, &inner_radius);
+    glUniform1fv(glGetUniformLocation(shader, "oradius"), 1, &outer_radius);
+    glUniform3fv(glGetUniformLocation(shader, "bvec"), 1, glm::value_ptr(bvec));
+    glUniform3fv(glGetUniformLocation(shader, "tvec"), 1, glm::value_ptr(tvec));
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
 
-    glUniform1i(glGetUniformLocation(tube_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(tube_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(tube_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(tube_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -1159,24 +1484,24 @@ void GLContainer::draw_tube(glm::vec3 bvec, glm::vec3 tvec, float inner_radius,
 void GLContainer::draw_triangle(glm::vec3 point1, glm::vec3 point2, glm::vec3 point3, float thickness, glm::vec4 color, bool draw, bool mask)
 {
     redraw_flag = true;
+    mark_dirty(glm::min(glm::min(point1, point2), point3) - thickness, glm::max(glm::max(point1, point2), point3) + thickness);
 
     swap_blocks();
-    glUseProgram(triangle_compute);
+    LazyCShader &shader = triangle_compute.variant({{"DRAW", draw ? "1" : "0"}, {"MASK", mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(triangle_compute, "mask"), mask);
-    glUniform1i(glGetUniformLocation(triangle_compute, "draw"), draw);
-    glUniform4fv(glGetUniformLocation(triangle_compute, "color"), 1, glm::value_ptr(color));
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
 
-    glUniform1fv(glGetUniformLocation(triangle_compute, "thickness"), 1, &thickness);
-    glUniform3fv(glGetUniformLocation(triangle_compute, "point1"), 1, glm::value_ptr(point1));
-    glUniform3fv(glGetUniformLocation(triangle_compute, "point2"), 1, glm::value_ptr(point2));
-    glUniform3fv(glGetUniformLocation(triangle_compute, "point3"), 1, glm::value_ptr(point3));
+    glUniform1fv(glGetUniformLocation(shader, "thickness"), 1, &thickness);
+    glUniform3fv(glGetUniformLocation(shader, "point1"), 1, glm::value_ptr(point1));
+    glUniform3fv(glGetUniformLocation(shader, "point2"), 1, glm::value_ptr(point2));
+    glUniform3fv(glGetUniformLocation(shader, "point3"), 1, glm::value_ptr(point3));
 
-    glUniform1i(glGetUniformLocation(triangle_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(triangle_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(triangle_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(triangle_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -1189,340 +1514,1863 @@ void GLContainer::draw_triangle(glm::vec3 point1, glm::vec3 point2, glm::vec3 po
         // clear all
 void GLContainer::clear_all(bool respect_mask)
 {
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
     redraw_flag = true;
+    mark_dirty(glm::vec3(lo), glm::vec3(hi));
 
-    swap_blocks();
-    glUseProgram(clear_all_compute);
+    begin_utility(lo, hi);
+    LazyCShader &shader = clear_all_compute.variant({{"RESPECT_MASK", respect_mask ? "1" : "0"}, roi_define()}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(clear_all_compute, "respect_mask"), respect_mask);
 
-    glUniform1i(glGetUniformLocation(clear_all_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(clear_all_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(clear_all_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(clear_all_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
-    glDispatchCompute( DIM/8, DIM/8, DIM/8 );
+    dispatch_region(shader, lo, hi);
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
 }
 
         // unmask all
 void GLContainer::unmask_all()
 {
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
     // don't need to redraw
-    swap_blocks();
-    glUseProgram(unmask_all_compute);
+    begin_utility(lo, hi);
+    LazyCShader &shader = unmask_all_compute.variant({roi_define()});
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(unmask_all_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(unmask_all_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(unmask_all_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(unmask_all_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
-    glDispatchCompute( DIM/8, DIM/8, DIM/8 );
+    dispatch_region(shader, lo, hi);
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
 }
 
         // invert mask
 void GLContainer::invert_mask()
 {
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
     // don't need to redraw
-    swap_blocks();
-    glUseProgram(invert_mask_compute);
+    begin_utility(lo, hi);
+    LazyCShader &shader = invert_mask_compute.variant({roi_define()});
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(invert_mask_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(invert_mask_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(invert_mask_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(invert_mask_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
-    glDispatchCompute( DIM/8, DIM/8, DIM/8 );
+    dispatch_region(shader, lo, hi);
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
 }
 
         // mask by color
 void GLContainer::mask_by_color(bool r, bool g, bool b, bool a, bool l, glm::vec4 color, float l_val, float r_var, float g_var, float b_var, float a_var, float l_var)
 {
-    // don't need to redraw
-    swap_blocks();
-    glUseProgram(mask_by_color_compute);
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
+    // don't need to redraw - the lighting lookup looks through the block up to a lighting cell away
+    begin_utility(lo - glm::ivec3(LIGHT_SCALE), hi + glm::ivec3(LIGHT_SCALE));
+    LazyCShader &shader = mask_by_color_compute.variant({roi_define()});
+    glUseProgram(shader);
  
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "use_r"), r);
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "use_g"), g);
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "use_b"), b);
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "use_a"), a);
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "use_l"), l);
+    glUniform1i(glGetUniformLocation(shader, "use_r"), r);
+    glUniform1i(glGetUniformLocation(shader, "use_g"), g);
+    glUniform1i(glGetUniformLocation(shader, "use_b"), b);
+    glUniform1i(glGetUniformLocation(shader, "use_a"), a);
+    glUniform1i(glGetUniformLocation(shader, "use_l"), l);
 
-    glUniform4fv(glGetUniformLocation(mask_by_color_compute, "color"), 1, glm::value_ptr(color));
-    glUniform1f(glGetUniformLocation(mask_by_color_compute, "l_val"), l_val);
+    glUniform4fv(glGetUniformLocation(shader, "color"), 1, glm::value_ptr(color));
+    glUniform1f(glGetUniformLocation(shader, "l_val"), l_val);
 
-    glUniform1f(glGetUniformLocation(mask_by_color_compute, "r_var"), r_var);
-    glUniform1f(glGetUniformLocation(mask_by_color_compute, "g_var"), g_var);
-    glUniform1f(glGetUniformLocation(mask_by_color_compute, "b_var"), b_var);
-    glUniform1f(glGetUniformLocation(mask_by_color_compute, "a_var"), a_var);
-    glUniform1f(glGetUniformLocation(mask_by_color_compute, "l_var"), l_var);
+    glUniform1f(glGetUniformLocation(shader, "r_var"), r_var);
+    glUniform1f(glGetUniformLocation(shader, "g_var"), g_var);
+    glUniform1f(glGetUniformLocation(shader, "b_var"), b_var);
+    glUniform1f(glGetUniformLocation(shader, "a_var"), a_var);
+    glUniform1f(glGetUniformLocation(shader, "l_var"), l_var);
 
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "lighting"), 6);
+    glUniform1i(glGetUniformLocation(shader, "lighting"), 6);
 
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(mask_by_color_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
-    glDispatchCompute( DIM/8, DIM/8, DIM/8 );
+    dispatch_region(shader, lo, hi);
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
 }
 
-        // box blur
-void GLContainer::box_blur(int radius, bool touch_alpha, bool respect_mask)
+        // connected components
+int GLContainer::label_components(float alpha_threshold)
 {
-    redraw_flag = true;
-    swap_blocks();
-    glUseProgram(box_blur_compute);
-
-    glUniform1i(glGetUniformLocation(box_blur_compute, "radius"), radius);
-    glUniform1i(glGetUniformLocation(box_blur_compute, "respect_mask"), respect_mask);
-    glUniform1i(glGetUniformLocation(box_blur_compute, "touch_alpha"), touch_alpha);
-
-    glUniform1i(glGetUniformLocation(box_blur_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(box_blur_compute, "current_mask"), 4+tex_offset);
+    materialize_offset();
+
+    // only in the box of the region of interest, if there is one
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
+    // the labels are one uint per voxel, so they go in the front copy/paste buffer seen as r32ui - the same
+    // view as the summed volume table. Start with every solid voxel as its own component
+    LazyCShader &init = components_compute.variant({{"PASS", "0"}});
+    glUseProgram(init);
+    glUniform1i(glGetUniformLocation(init, "labels"), 13);
+    glUniform1i(glGetUniformLocation(init, "current"), 2+tex_offset);
+    glUniform1f(glGetUniformLocation(init, "alpha_threshold"), alpha_threshold);
+    dispatch_region(init, lo, hi);
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
 
-    glUniform1i(glGetUniformLocation(box_blur_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(box_blur_compute, "previous_mask"), 5-tex_offset);
+    // then hook and compress till a pass doesn't merge anything - this usually takes a handful of passes. There's
+    // no cap, since stopping early would leave components split and the count wrong - and it always ends, since
+    // every pass that reports a change has merged at least two roots, and there are only so many
+    LazyCShader &hook = components_compute.variant({{"PASS", "1"}});
+    LazyCShader &compress = components_compute.variant({{"PASS", "2"}});
+    GLuint status[2] = {1, 0};
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, components_buffer);
+    while(status[0])
+    {
+        GLuint zero[2] = {0, 0};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, components_buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+
+        glUseProgram(hook);
+        glUniform1i(glGetUniformLocation(hook, "labels"), 13);
+        dispatch_region(hook, lo, hi);
+        glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+
+        glUseProgram(compress);
+        glUniform1i(glGetUniformLocation(compress, "labels"), 13);
+        dispatch_region(compress, lo, hi);
+        glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT );
+
+        // one small readback per pass, to know when to stop
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(status), status);
+    }
 
-    glDispatchCompute( DIM/8, DIM/8, DIM/8 );
-    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+    return int(status[1]);
 }
 
-        // gaussian blur
-void GLContainer::gaussian_blur(int radius, bool touch_alpha, bool respect_mask)
+int GLContainer::mask_component(glm::ivec3 seed, float alpha_threshold)
 {
-    redraw_flag = true;
+    int count = label_components(alpha_threshold);
 
-    // I think I'm going to restrict the range of radii, since I'm not sure about what the best way to do different sized kernels is
-    swap_blocks();
-    glUseProgram(gaussian_blur_compute);
+    // masking only adds to the mask, so a masked only region of interest has nothing to add to - just its box is used
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
+    // don't need to redraw
+    begin_utility(lo, hi);
+    LazyCShader &shader = components_compute.variant({{"PASS", "3"}});
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(gaussian_blur_compute, "radius"), radius);
-    glUniform1i(glGetUniformLocation(gaussian_blur_compute, "respect_mask"), respect_mask);
-    glUniform1i(glGetUniformLocation(gaussian_blur_compute, "touch_alpha"), touch_alpha);
+    glUniform1i(glGetUniformLocation(shader, "labels"), 13);
+    glUniform3iv(glGetUniformLocation(shader, "seed"), 1, glm::value_ptr(glm::clamp(seed, glm::ivec3(0), glm::ivec3(DIM-1))));
 
-    glUniform1i(glGetUniformLocation(gaussian_blur_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(gaussian_blur_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(gaussian_blur_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(gaussian_blur_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
-    glDispatchCompute( DIM/8, DIM/8, DIM/8 );
+    dispatch_region(shader, lo, hi);
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+
+    return count;
 }
 
-        // limiter
-void GLContainer::limiter()
+        // summed volume table
+void GLContainer::build_summed_volume(int source, int channel, glm::ivec3 lo, glm::ivec3 hi)
 {
-    redraw_flag = true;
+    // prefix sums one channel of the block bound to image unit source (0-3 for color, 4 for a mask) into the
+    // summed volume table, image unit 13 - after this, the sum over any box in lo..hi takes eight loads
+    glm::ivec3 size = hi - lo + glm::ivec3(1);
+    for(int axis = 0; axis < 3; axis++)
+    {
+        LazyCShader &shader = summed_volume_compute.variant(summed_volume_pass_defines(axis, channel));
+        glUseProgram(shader);
 
-    // the details of this operation still need to be worked out - there is a couple of different modes
+        glUniform1i(glGetUniformLocation(shader, "source"), source);
+        glUniform1i(glGetUniformLocation(shader, "sat"), 13);
+        glUniform3iv(glGetUniformLocation(shader, "region_min"), 1, glm::value_ptr(lo));
+        glUniform3iv(glGetUniformLocation(shader, "region_max"), 1, glm::value_ptr(hi));
+
+        // one workgroup per line along the axis, picked by the other two axes in order
+        glm::ivec2 across = (axis == 0) ? glm::ivec2(size.y, size.z) : ((axis == 1) ? glm::ivec2(size.x, size.z) : glm::ivec2(size.x, size.y));
+        glDispatchCompute( 1, across.x, across.y );
+        glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+    }
 }
 
-        // shifting
-void GLContainer::shift(glm::ivec3 movement, bool loop, int mode)
+        // box blur
+void GLContainer::box_blur(int radius, bool touch_alpha, bool respect_mask)
 {
-    redraw_flag = true;
-    swap_blocks();
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
 
-    glUseProgram(shift_compute);
+    redraw_flag = true;
+    mark_dirty(glm::vec3(lo), glm::vec3(hi));
+
+    // one channel at a time - build the summed volume table, then read each box average out of it. The table
+    // wraps around 32 bits, which is fine as long as a box can't sum past that: (2*127+1)^3 * 255 just fits
+    radius = std::clamp(radius, 0, 127);
+
+    // the table only needs to reach radius past what's being blurred
+    glm::ivec3 table_lo = glm::max(lo - glm::ivec3(radius), glm::ivec3(0));
+    glm::ivec3 table_hi = glm::min(hi + glm::ivec3(radius), glm::ivec3(DIM-1));
+
+    // a voxel with nothing in the box around it blurs to nothing, so only the bricks within radius of something
+    // (color, or the mask) are run - and the ones that are entirely masked, when the mask is respected, or have
+    // none of the mask a masked region of interest needs, are left out too. Only those bricks are copied to the
+    // previous block, so the tables come from the current one - each channel is still as it was when its table is
+    // built, since every pass only changes its own. The tables are still the size of the box, though
+    GLuint self = (respect_mask ? BRICK_UNMASKED : 0) | ((roi_enabled && roi_masked) ? BRICK_MASKED : 0);
+    build_brick_list(BRICK_OCCUPIED | BRICK_MASKED, radius / 8 + 1, self, 1, lo, hi);
+    begin_brick_edit();
+
+    for(int channel = 0; channel < 5; channel++)
+    {
+        if(channel == 3 && !touch_alpha)
+            continue; // the first pass starts from the existing color, so alpha is left as it was
 
-    glUniform1i(glGetUniformLocation(shift_compute, "loop"), loop);
-    glUniform1i(glGetUniformLocation(shift_compute, "mode"),  mode);
-    glUniform3i(glGetUniformLocation(shift_compute, "movement"), movement.x, movement.y, movement.z);
+        build_summed_volume(channel == 4 ? 4+tex_offset : 2+tex_offset, channel, table_lo, table_hi);
 
-    // glUniform1i(glGetUniformLocation(shift_compute, "lighting"), 6);
-    
-    glUniform1i(glGetUniformLocation(shift_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(shift_compute, "current_mask"), 4+tex_offset);
+        LazyCShader &shader = box_blur_compute.variant({{"CHANNEL", std::to_string(channel)}, {"RESPECT_MASK", respect_mask ? "1" : "0"}, roi_define(), {"BRICK_LIST", "1"}}); // flags are compiled in, not uniforms
+        glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(shift_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(shift_compute, "previous_mask"), 5-tex_offset);
+        glUniform1i(glGetUniformLocation(shader, "radius"), radius);
+        glUniform1i(glGetUniformLocation(shader, "sat"), 13);
+        glUniform3iv(glGetUniformLocation(shader, "table_min"), 1, glm::value_ptr(table_lo));
 
-    glDispatchCompute( DIM/8, DIM/8, DIM/8 );
-    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
-}
+        glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+        glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
+        glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+        glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
-// ------------------------
-// Lighting -- all of these will require redraw_flag be set true
+        dispatch_bricks(shader, lo, hi);
+        glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+    }
+}
 
-        // lighting clear (to cached level, or to some set level, default zero)
-void GLContainer::lighting_clear(bool use_cache_level, float intensity)
+        // gaussian blur
+void GLContainer::gaussian_blur(int radius, bool touch_alpha, bool respect_mask)
 {
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
     redraw_flag = true;
+    mark_dirty(glm::vec3(lo), glm::vec3(hi));
+
+    // separable - three 1d passes over the mask, then three over color, going through the scratch buffers
+    // (textures 8 and 9) in between. Sigma puts the edge of the kernel two standard deviations out
+    radius = std::clamp(radius, 0, 32); // MAX_RADIUS in the shader, sets the size of the shared memory rows
+    float sigma = std::max(radius / 2.0f, 0.5f);
+    std::vector<float> weights(radius + 1);
+    for(int i = 0; i <= radius; i++)
+        weights[i] = std::exp(-float(i * i) / (2.0f * sigma * sigma));
+
+    // the z pass writes the box, the y pass has to cover radius past it along z, and the x pass radius past that
+    // along y too - the same reach on every side is what has to be read from the block
+    glm::ivec3 pass_lo[3] = {lo - glm::ivec3(0, radius, radius), lo - glm::ivec3(0, 0, radius), lo};
+    glm::ivec3 pass_hi[3] = {hi + glm::ivec3(0, radius, radius), hi + glm::ivec3(0, 0, radius), hi};
+    for(int axis = 0; axis < 3; axis++)
+    {
+        pass_lo[axis] = glm::max(pass_lo[axis], glm::ivec3(0));
+        pass_hi[axis] = glm::min(pass_hi[axis], glm::ivec3(DIM-1));
+    }
+    begin_utility(glm::max(lo - glm::ivec3(radius), glm::ivec3(0)), glm::min(hi + glm::ivec3(radius), glm::ivec3(DIM-1)));
 
-    glUseProgram(lighting_clear_compute);
+    for(int mask_pass = 1; mask_pass >= 0; mask_pass--)
+    {
+        // image units read and written by the x, y and z passes
+        int sources[3]      = {mask_pass ? 5-tex_offset : 3-tex_offset, 8, 9};
+        int destinations[3] = {8, 9, mask_pass ? 4+tex_offset : 2+tex_offset};
 
-    glUniform1i(glGetUniformLocation(lighting_clear_compute, "lighting"), 6);
-    glUniform1i(glGetUniformLocation(lighting_clear_compute, "lighting_cache"), 7);
-    glUniform1i(glGetUniformLocation(lighting_clear_compute, "use_cache"), use_cache_level);
-    glUniform1f(glGetUniformLocation(lighting_clear_compute, "intensity"), intensity);
+        for(int axis = 0; axis < 3; axis++)
+        {
+            LazyCShader &shader = gaussian_blur_compute.variant(gaussian_pass_defines(mask_pass, axis, touch_alpha, respect_mask, roi_enabled && roi_masked));
+            glUseProgram(shader);
 
-    glDispatchCompute( DIM/8, DIM/8, DIM/8 );
+            glUniform1i(glGetUniformLocation(shader, "radius"), radius);
+            glUniform1fv(glGetUniformLocation(shader, "weights"), radius + 1, &weights[0]);
+
+            glUniform1i(glGetUniformLocation(shader, "source"), sources[axis]);
+            glUniform1i(glGetUniformLocation(shader, "destination"), destinations[axis]);
+
+            glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+            glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
+
+            glUniform3iv(glGetUniformLocation(shader, "region_min"), 1, glm::value_ptr(pass_lo[axis]));
+            glUniform3iv(glGetUniformLocation(shader, "region_max"), 1, glm::value_ptr(pass_hi[axis]));
+
+            // rows of 64 along the blur axis, 4 rows per workgroup
+            glm::ivec3 size = pass_hi[axis] - pass_lo[axis] + glm::ivec3(1);
+            glm::ivec2 across = (axis == 0) ? glm::ivec2(size.y, size.z) : ((axis == 1) ? glm::ivec2(size.x, size.z) : glm::ivec2(size.x, size.y));
+            glDispatchCompute( (size[axis] + 63) / 64, (across.x + 3) / 4, across.y );
+            glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+        }
+    }
+}
+
+        // distance field
+void GLContainer::jump_flood(glm::ivec3 lo, glm::ivec3 hi, glm::ivec3 write_lo, glm::ivec3 write_hi)
+{
+    materialize_offset();
+    // everything works inside of lo..hi - seeds first, then jumps starting at half the size of the box, down to 1,
+    // then one more at 1 to clean up the few voxels the bigger steps got wrong
+
+    LazyCShader &seed = distance_field_compute.variant({{"PASS", "0"}});
+    glUseProgram(seed);
+    glUniform1i(glGetUniformLocation(seed, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(seed, "destination"), 13);
+    glUniform1f(glGetUniformLocation(seed, "alpha_threshold"), distance_threshold);
+    dispatch_region(seed, lo, hi);
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+
+    std::vector<int> steps;
+    int extent = std::max({hi.x - lo.x, hi.y - lo.y, hi.z - lo.z}) + 1;
+    for(int step = std::max(1, int(std::exp2(std::ceil(std::log2(extent))) / 2)); step >= 1; step /= 2)
+        steps.push_back(step);
+    steps.push_back(1);
+
+    int units[2] = {13, 22};
+    LazyCShader &jump = distance_field_compute.variant({{"PASS", "1"}});
+    glUseProgram(jump);
+    for(size_t i = 0; i < steps.size(); i++)
+    {
+        glUniform1i(glGetUniformLocation(jump, "source"), units[i % 2]);
+        glUniform1i(glGetUniformLocation(jump, "destination"), units[(i + 1) % 2]);
+        glUniform1i(glGetUniformLocation(jump, "step_size"), steps[i]);
+        dispatch_region(jump, lo, hi);
+        glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+    }
+    distance_seeds = units[steps.size() % 2];
+
+    // distances from the nearest seeds, written back inside of write_lo..write_hi
+    LazyCShader &resolve = distance_field_compute.variant({{"PASS", "2"}});
+    glUseProgram(resolve);
+    glUniform1i(glGetUniformLocation(resolve, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(resolve, "destination"), distance_seeds);
+    glUniform1i(glGetUniformLocation(resolve, "distance_field"), 21);
+    glUniform1f(glGetUniformLocation(resolve, "alpha_threshold"), distance_threshold);
+    glUniform1f(glGetUniformLocation(resolve, "range"), float(DISTANCE_RANGE));
+    glUniform3iv(glGetUniformLocation(resolve, "write_min"), 1, glm::value_ptr(write_lo));
+    glUniform3iv(glGetUniformLocation(resolve, "write_max"), 1, glm::value_ptr(write_hi));
+    dispatch_region(resolve, lo, hi);
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT );
 }
 
+void GLContainer::compute_distance_field(float alpha_threshold)
+{
+    distance_threshold = alpha_threshold;
+    jump_flood(glm::ivec3(0), glm::ivec3(DIM-1), glm::ivec3(0), glm::ivec3(DIM-1));
+    distance_valid = true;
+    distance_dirty = false;
+}
 
-void GLContainer::compute_new_directional_lighting(float theta, float phi, float initial_ray_intensity, float decay_power)
+void GLContainer::update_distance_field()
 {
-    // auto t1 = std::chrono::high_resolution_clock::now();
-    
+    if(!distance_valid || !distance_dirty)
+        return;
+    distance_dirty = false;
+
+    // distances are clamped to DISTANCE_RANGE, so an edit can't change them any farther than that from the edited
+    // box - and getting those right needs every seed within DISTANCE_RANGE of them, so the flood covers twice that
+    glm::ivec3 write_lo = glm::max(distance_dirty_min - DISTANCE_RANGE, glm::ivec3(0));
+    glm::ivec3 write_hi = glm::min(distance_dirty_max + DISTANCE_RANGE, glm::ivec3(DIM-1));
+    glm::ivec3 lo = glm::max(distance_dirty_min - 2*DISTANCE_RANGE, glm::ivec3(0));
+    glm::ivec3 hi = glm::min(distance_dirty_max + 2*DISTANCE_RANGE, glm::ivec3(DIM-1));
+    jump_flood(lo, hi, write_lo, write_hi);
+}
+
+        // morphology
+void GLContainer::morphology(bool erode, int radius, float alpha_threshold, bool respect_mask)
+{
+    // the nearest surface voxels from the flood are used for the color of dilated voxels, so this always floods
+    // the whole block fresh rather than patching
+    compute_distance_field(alpha_threshold);
+    radius = std::clamp(radius, 0, DISTANCE_RANGE - 1);
+
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
     redraw_flag = true;
-    glUseProgram(new_directional_lighting_compute);
+    mark_dirty(glm::vec3(lo), glm::vec3(hi));
 
-    glUniform1f(glGetUniformLocation(new_directional_lighting_compute, "utheta"), theta);
-    glUniform1f(glGetUniformLocation(new_directional_lighting_compute, "uphi"), phi);
-    glUniform1f(glGetUniformLocation(new_directional_lighting_compute, "light_intensity"), initial_ray_intensity);
-    glUniform1f(glGetUniformLocation(new_directional_lighting_compute, "decay_power"), decay_power);
+    // a dilated voxel takes the color of a surface voxel closer than radius to it, so that's how far past the box
+    // this reads
+    begin_utility(lo - glm::ivec3(radius), hi + glm::ivec3(radius));
+    LazyCShader &shader = morphology_compute.variant({{"ERODE", erode ? "1" : "0"}, {"RESPECT_MASK", respect_mask ? "1" : "0"}, roi_define()});
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(new_directional_lighting_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(new_directional_lighting_compute, "lighting"), 6);
+    glUniform1i(glGetUniformLocation(shader, "distance_field"), 21);
+    glUniform1i(glGetUniformLocation(shader, "seeds"), distance_seeds);
+    glUniform1f(glGetUniformLocation(shader, "radius"), float(radius));
+    glUniform1f(glGetUniformLocation(shader, "alpha_threshold"), alpha_threshold);
+
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glDispatchCompute( DIM/8, DIM/8, DIM/8 ); //workgroup is 8x8x8
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
+    dispatch_region(shader, lo, hi);
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
-    // auto t1 = std::chrono::high_resolution_clock::now();
+}
 
-    // auto t2 = std::chrono::high_resolution_clock::now();
+void GLContainer::dilate(int radius, float alpha_threshold, bool respect_mask)
+{
+    morphology(false, radius, alpha_threshold, respect_mask);
+}
 
-    // cout << "new lighting took " << std::chrono::duration_cast<std::chrono::microseconds>( t2 - t1 ).count() << " microseconds" << endl;
+void GLContainer::erode(int radius, float alpha_threshold, bool respect_mask)
+{
+    morphology(true, radius, alpha_threshold, respect_mask);
 }
 
+void GLContainer::morphological_open(int radius, float alpha_threshold, bool respect_mask)
+{
+    // removes anything thinner than the radius, and rounds off convex corners
+    erode(radius, alpha_threshold, respect_mask);
+    dilate(radius, alpha_threshold, respect_mask);
+}
 
-        // point light
-void GLContainer::compute_point_lighting(glm::vec3 location, float initial_intensity, float decay_power, float distance_power)
+void GLContainer::morphological_close(int radius, float alpha_threshold, bool respect_mask)
+{
+    // fills gaps and holes narrower than the radius, and rounds off concave corners
+    dilate(radius, alpha_threshold, respect_mask);
+    erode(radius, alpha_threshold, respect_mask);
+}
+
+        // limiter
+void GLContainer::limiter()
 {
     redraw_flag = true;
-    glUseProgram(point_lighting_compute);
 
-    glUniform3fv(glGetUniformLocation(point_lighting_compute, "light_position"), 1, glm::value_ptr(location));
+    // the details of this operation still need to be worked out - there is a couple of different modes
+}
 
-    glUniform1f(glGetUniformLocation(point_lighting_compute, "light_intensity"), initial_intensity);
-    glUniform1f(glGetUniformLocation(point_lighting_compute, "decay_power"), decay_power);
-    glUniform1f(glGetUniformLocation(point_lighting_compute, "distance_power"), distance_power);
+        // shifting
+void GLContainer::shift(glm::ivec3 movement, bool loop, int mode)
+{
+    if(loop && mode == 3 && virtual_shift && !roi_enabled)
+    {
+        // nothing moves - the raycaster reads the block through the offset, so this costs nothing till something
+        // needs the data where it looks like it is
+        block_offset = ((block_offset + movement) % DIM + DIM) % DIM;
+        redraw_flag = true;
+        block_changed();
+
+        // the lighting stays put, like it does for a real shift, so it needs relighting. The distance field is
+        // kept in the layout the data actually has, so it's still good
+        dirty = true;
+        dirty_min = glm::ivec3(0);
+        dirty_max = glm::ivec3(DIM-1);
+        return;
+    }
 
-    glUniform1i(glGetUniformLocation(point_lighting_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(point_lighting_compute, "lighting"), 6);
-    
-    glDispatchCompute(DIM/8, DIM/8, DIM/8);
+    shift_blocks(movement, loop, mode);
+}
 
-    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT ); 
+void GLContainer::materialize_offset()
+{
+    if(block_offset == glm::ivec3(0))
+        return;
+
+    // cleared first, since the shift swaps, which comes back here - and the offset is the whole block's, so
+    // it's applied to the whole block whatever the region of interest is
+    glm::ivec3 movement = block_offset;
+    block_offset = glm::ivec3(0);
+    bool saved_enabled = roi_enabled;
+    roi_enabled = false;
+    shift_blocks(movement, true, 3);
+    roi_enabled = saved_enabled;
 }
 
-        // cone light
-void GLContainer::compute_cone_lighting(glm::vec3 location, float theta, float phi, float cone_angle, float initial_intensity, float decay_power, float distance_power)
+void GLContainer::shift_blocks(glm::ivec3 movement, bool loop, int mode)
 {
+    // looping, a shift is the same as one by what's left over past whole turns - 0..DIM-1, which the shader needs
+    if(loop)
+        movement = (movement % DIM + DIM) % DIM;
+
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
     redraw_flag = true;
-    glUseProgram(cone_lighting_compute);
+    mark_dirty(glm::vec3(lo), glm::vec3(hi));
+
+    // what's shifted into the box comes from the box, moved back - or from anywhere, if that wraps around
+    glm::ivec3 from_lo = lo - movement, from_hi = hi - movement;
+    if(loop && (glm::any(glm::lessThan(from_lo, glm::ivec3(0))) || glm::any(glm::greaterThan(from_hi, glm::ivec3(DIM-1)))))
+    {
+        from_lo = glm::ivec3(0);
+        from_hi = glm::ivec3(DIM-1);
+    }
+    begin_utility(glm::min(lo, from_lo), glm::max(hi, from_hi));
 
-    glUniform3fv(glGetUniformLocation(cone_lighting_compute, "light_position"), 1, glm::value_ptr(location));
+    LazyCShader &shader = shift_compute.variant({{"LOOP", loop ? "1" : "0"}, {"MODE", std::to_string(mode)}, roi_define()}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1f(glGetUniformLocation(cone_lighting_compute, "theta"), theta);
-    glUniform1f(glGetUniformLocation(cone_lighting_compute, "phi"), phi);
-    
-    glUniform1f(glGetUniformLocation(cone_lighting_compute, "cone_angle"), cone_angle);
-    glUniform1f(glGetUniformLocation(cone_lighting_compute, "light_intensity"), initial_intensity);
-    glUniform1f(glGetUniformLocation(cone_lighting_compute, "decay_power"), decay_power);
-    glUniform1f(glGetUniformLocation(cone_lighting_compute, "distance_power"), distance_power);
+    glUniform3i(glGetUniformLocation(shader, "movement"), movement.x, movement.y, movement.z);
 
-    glUniform1i(glGetUniformLocation(cone_lighting_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(cone_lighting_compute, "lighting"), 6);
+    // glUniform1i(glGetUniformLocation(shader, "lighting"), 6);
     
-    glDispatchCompute(DIM/8, DIM/8, DIM/8);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT ); 
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
+
+    dispatch_region(shader, lo, hi);
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
 }
 
-        // ambient occlusion
-void GLContainer::compute_ambient_occlusion(int radius)
+void GLContainer::begin_region_edit(glm::ivec3 lo, glm::ivec3 hi)
 {
-    redraw_flag = true;
-    glUseProgram(ambient_occlusion_compute);
-
-    glUniform1i(glGetUniformLocation(ambient_occlusion_compute, "radius"), radius);
+    materialize_offset();
+
+    // the operation before this one goes into the undo history first, while the previous block still has its start
+    commit_undo();
+    block_changed();
+
+    // out to whole mask words along x and whole bricks along y and z, so the undo history sees everything it needs
+    lo = glm::clamp(lo, glm::ivec3(0), glm::ivec3(DIM-1)) & glm::ivec3(~31, ~7, ~7);
+    hi = glm::clamp(hi, glm::ivec3(0), glm::ivec3(DIM-1)) | glm::ivec3(31, 7, 7);
+    glm::ivec3 size = hi - lo + glm::ivec3(1);
+
+    glCopyImageSubData(textures[2+tex_offset], GL_TEXTURE_3D, 0, lo.x, lo.y, lo.z,
+                       textures[3-tex_offset], GL_TEXTURE_3D, 0, lo.x, lo.y, lo.z, size.x, size.y, size.z);
+    glCopyImageSubData(textures[4+tex_offset], GL_TEXTURE_3D, 0, lo.x/32, lo.y, lo.z,
+                       textures[5-tex_offset], GL_TEXTURE_3D, 0, lo.x/32, lo.y, lo.z, size.x/32, size.y, size.z);
+
+    undo_pending = true;
+    undo_from_list = false;
+    undo_min = lo;
+    undo_max = hi;
+}
 
-    glUniform1i(glGetUniformLocation(ambient_occlusion_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(ambient_occlusion_compute, "lighting"), 6);
+void GLContainer::begin_brick_edit()
+{
+    // build_brick_list has already put any virtual shift in place, since the list is of the block as it's laid out
+    commit_undo();
+    block_changed();
+
+    // the list is kept for the undo history - another one can be built before this operation gets recorded
+    glBindBuffer(GL_COPY_READ_BUFFER, brick_list_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, edit_list_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (4 + (DIM/8)*(DIM/8)*(DIM/8)) * sizeof(GLuint));
+
+    LazyCShader &copy = brick_list_compute.variant({{"PASS", "4"}});
+    glUseProgram(copy);
+    glUniform1i(glGetUniformLocation(copy, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(copy, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(copy, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(copy, "previous_mask"), 5-tex_offset);
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, brick_list_buffer);
+    glDispatchComputeIndirect( sizeof(GLuint) ); // past the count
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
 
-    glDispatchCompute(DIM/8, DIM/8, DIM/8);
+    undo_pending = true;
+    undo_from_list = true;
+}
 
-    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+        // copy/paste
+void GLContainer::copy(glm::ivec3 lo, glm::ivec3 hi, bool masked_only)
+{
+    materialize_offset();
+    glm::ivec3 mins = glm::clamp(glm::min(lo, hi), glm::ivec3(0), glm::ivec3(DIM-1));
+    glm::ivec3 maxs = glm::clamp(glm::max(lo, hi), glm::ivec3(0), glm::ivec3(DIM-1));
+    clipboard_extent = maxs - mins + glm::ivec3(1);
+    glm::ivec3 bricks = (clipboard_extent + glm::ivec3(7)) / 8;
+
+    // give each brick of the selection with something in it a slot
+    GLuint count = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clipboard_index_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+
+    LazyCShader &find = clipboard_compute.variant({{"PASS", "0"}, {"MASKED_ONLY", masked_only ? "1" : "0"}});
+    glUseProgram(find);
+    glUniform1i(glGetUniformLocation(find, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(find, "current_mask"), 4+tex_offset);
+    glUniform3iv(glGetUniformLocation(find, "size"), 1, glm::value_ptr(clipboard_extent));
+    glUniform3iv(glGetUniformLocation(find, "selection_min"), 1, glm::value_ptr(mins));
+    glDispatchCompute( bricks.x, bricks.y, bricks.z );
+    glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+    clipboard_count = int(count);
+
+    // then size the slots to fit (never empty, so the buffer always exists) and copy the bricks into them
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clipboard_data_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(count, GLuint(1)) * 512 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    if(count == 0)
+        return;
+
+    LazyCShader &gather = clipboard_compute.variant({{"PASS", "1"}, {"MASKED_ONLY", masked_only ? "1" : "0"}});
+    glUseProgram(gather);
+    glUniform1i(glGetUniformLocation(gather, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(gather, "current_mask"), 4+tex_offset);
+    glUniform3iv(glGetUniformLocation(gather, "size"), 1, glm::value_ptr(clipboard_extent));
+    glUniform3iv(glGetUniformLocation(gather, "selection_min"), 1, glm::value_ptr(mins));
+    glDispatchCompute( bricks.x, bricks.y, bricks.z );
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
 }
 
-        // fake GI
-void GLContainer::compute_fake_GI(float factor, float sky_intensity, float thresh)
+void GLContainer::paste(glm::ivec3 offset, glm::ivec3 quarter_turns, glm::bvec3 mirror, bool respect_mask, bool overwrite)
 {
+    if(clipboard_extent == glm::ivec3(0))
+        return; // nothing has been copied yet
+
+    // where each of the clipboard's axes points in the block - mirrored first, then turned about x, y and z
+    auto transform = [&](glm::ivec3 v)
+    {
+        for(int i = 0; i < 3; i++)
+            if(mirror[i])
+                v[i] = -v[i];
+        for(int t = 0; t < (quarter_turns.x & 3); t++)
+            v = glm::ivec3(v.x, -v.z, v.y);
+        for(int t = 0; t < (quarter_turns.y & 3); t++)
+            v = glm::ivec3(v.z, v.y, -v.x);
+        for(int t = 0; t < (quarter_turns.z & 3); t++)
+            v = glm::ivec3(-v.y, v.x, v.z);
+        return v;
+    };
+    glm::ivec3 axis[3] = {transform(glm::ivec3(1, 0, 0)), transform(glm::ivec3(0, 1, 0)), transform(glm::ivec3(0, 0, 1))};
+
+    // the transformed clipboard's size, and the low corner it has when the origin stays put - the paste is moved
+    // so that corner lands on offset
+    glm::ivec3 extent(0), low(0);
+    for(int i = 0; i < 3; i++)
+    {
+        extent += glm::abs(axis[i]) * clipboard_extent[i];
+        low += glm::min(axis[i] * (clipboard_extent[i] - 1), glm::ivec3(0));
+    }
+    glm::ivec3 origin = offset - low;
+
+    // the shader goes the other way, from the block to the clipboard - rotations and mirrors are orthogonal, so
+    // the inverse is the transpose
+    glm::ivec3 inverse[3];
+    for(int j = 0; j < 3; j++)
+        inverse[j] = glm::ivec3(axis[0][j], axis[1][j], axis[2][j]);
+
+    // only the part of the block the paste covers is touched
+    glm::ivec3 lo = glm::max(offset, glm::ivec3(0));
+    glm::ivec3 hi = glm::min(offset + extent - glm::ivec3(1), glm::ivec3(DIM-1));
+    if(glm::any(glm::lessThan(hi, lo)))
+        return; // entirely off the edge of the block
+
     redraw_flag = true;
-    glUseProgram(fakeGI_compute);
+    mark_dirty(glm::vec3(lo), glm::vec3(hi));
+    begin_region_edit(lo, hi);
 
-    glUniform1i(glGetUniformLocation(fakeGI_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(fakeGI_compute, "lighting"), 6);
+    LazyCShader &shader = clipboard_compute.variant({{"PASS", "2"}, {"RESPECT_MASK", respect_mask ? "1" : "0"}, {"OVERWRITE", overwrite ? "1" : "0"}});
+    glUseProgram(shader);
 
-    glUniform1f(glGetUniformLocation(fakeGI_compute, "scale_factor"), factor);
-    glUniform1f(glGetUniformLocation(fakeGI_compute, "alpha_thresh"), thresh);
-    glUniform1f(glGetUniformLocation(fakeGI_compute, "sky_intensity"), sky_intensity);
+    glUniform3iv(glGetUniformLocation(shader, "size"), 1, glm::value_ptr(clipboard_extent));
+    glUniform3iv(glGetUniformLocation(shader, "origin"), 1, glm::value_ptr(origin));
+    glUniform3iv(glGetUniformLocation(shader, "axes"), 3, glm::value_ptr(inverse[0]));
 
-    // This has a sequential dependence - from the same guy who did the Voxel Automata Terrain, Brent Werness:
-    //   "Totally faked the GI!  It just casts out 9 rays in upwards facing the lattice directions.
-    //    If it escapes it gets light from the sky, otherwise it gets some fraction of the light
-    //    from whatever cell it hits.  Run from top to bottom and you are set!"
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    // For that reason, I'm doing 2d workgroups, starting from the top, going to the bottom.
+    dispatch_region(shader, lo, hi);
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+}
 
-    for (int y = DIM-1; y >= 0; y--) //iterating through y, from top to bottom
-    {
-        // update y index
-        glUniform1i(glGetUniformLocation(fakeGI_compute, "y_index"), y);
 
-        // send the job, for one xz plane
-        glDispatchCompute(DIM/8, 1, DIM/8);
+// ------------------------
+// Lighting -- all of these will require redraw_flag be set true
 
-        // wait for all those shader invocations to finish
-        glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
-    }
+// direction a light travels for the given angles - the same rotations the shaders do with rotationMatrix()
+static glm::vec3 light_direction(float theta, float phi)
+{
+    auto rotation = [](glm::vec3 axis, float angle)
+    {
+        float s = std::sin(angle), c = std::cos(angle), oc = 1.0 - c;
+        return glm::mat3(oc * axis.x * axis.x + c,           oc * axis.x * axis.y - axis.z * s,  oc * axis.z * axis.x + axis.y * s,
+                         oc * axis.x * axis.y + axis.z * s,  oc * axis.y * axis.y + c,           oc * axis.y * axis.z - axis.x * s,
+                         oc * axis.z * axis.x - axis.y * s,  oc * axis.y * axis.z + axis.x * s,  oc * axis.z * axis.z + c);
+    };
+    return glm::normalize(glm::vec3(0, 0, -1) * rotation(glm::vec3(1, 0, 0), phi) * rotation(glm::vec3(0, 1, 0), theta));
 }
 
-        // mash (combine light into color buffer)
-        //   realized this morning that in some ways conceptually this really is a form of dynamic range compression
-void GLContainer::mash()
+// the box of lighting an edit between lo and hi can change for a light at location, with a cube of the given
+// resolution and shell count - the edit shadows everything behind it on rays from the light, which is the box
+// scaled away from the light, out past the edge of the block. It's grown by a couple of cube texels and a
+// shell first, since those are what the gather filters between
+static void point_shadow(glm::vec3 location, int res, int shells, glm::ivec3 &lo, glm::ivec3 &hi)
 {
-    redraw_flag = true;
-    glUseProgram(mash_compute);
+    glm::vec3 center = 0.5f * glm::vec3(lo + hi);
+    float radius = 0.5f * glm::distance(glm::vec3(lo), glm::vec3(hi));
+    float margin = 1.0f + DIM * std::sqrt(3.0f) / (shells - 1) + (glm::distance(center, location) + radius) * 4.0f / res;
 
-    glUniform1i(glGetUniformLocation(mash_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(mash_compute, "lighting"), 6);
+    glm::vec3 mins = glm::vec3(lo) - margin, maxs = glm::vec3(hi) + margin;
+    glm::vec3 nearest = glm::clamp(location, mins, maxs);
+    if(nearest == location) // the light is in the box, so it shadows everything
+    {
+        lo = glm::ivec3(0);
+        hi = glm::ivec3(DIM-1);
+        return;
+    }
 
-    glDispatchCompute(DIM/8, DIM/8, DIM/8);
+    float scale = 1.0f + 2.0f * DIM / glm::distance(nearest, location);
+    glm::vec3 far_mins = location + (mins - location) * scale, far_maxs = location + (maxs - location) * scale;
+    lo = glm::clamp(glm::ivec3(glm::floor(glm::min(mins, glm::min(far_mins, far_maxs)))), glm::ivec3(0), glm::ivec3(DIM-1));
+    hi = glm::clamp(glm::ivec3(glm::ceil(glm::max(maxs, glm::max(far_mins, far_maxs)))), glm::ivec3(0), glm::ivec3(DIM-1));
+}
 
-    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+// the same for a directional light - the box, grown by margin, swept along the light until it leaves the block
+static void directional_shadow(glm::vec3 direction, float margin, glm::ivec3 &lo, glm::ivec3 &hi)
+{
+    glm::vec3 mins = glm::vec3(lo) - margin, maxs = glm::vec3(hi) + margin;
+    glm::vec3 sweep = 2.0f * DIM * direction;
+    lo = glm::clamp(glm::ivec3(glm::floor(glm::min(mins, mins + sweep))), glm::ivec3(0), glm::ivec3(DIM-1));
+    hi = glm::clamp(glm::ivec3(glm::ceil(glm::max(maxs, maxs + sweep))), glm::ivec3(0), glm::ivec3(DIM-1));
 }
 
+// the directional light sweep's bilinear reads spread the effect of a cell out by up to a cell per plane, but
+// with weights that fall off like a gaussian with a standard deviation of at most sqrt(planes)/2 - past this
+// many cells it is under the precision of the lighting buffer
+static float sweep_spread(int planes)
+{
+    return 2.0f + 2.0f * std::sqrt(float(std::max(planes, 0)));
+}
 
-// ------------------------
-// ------------------------
-// CPU-side utilities
+void GLContainer::lighting_region(glm::ivec3 &lo, glm::ivec3 &hi)
+{
+    lo = region_min;
+    hi = region_max;
+    if(roi_enabled)
+    {
+        glm::ivec3 roi_lo, roi_hi;
+        utility_box(roi_lo, roi_hi);
+        lo = glm::max(lo, roi_lo / LIGHT_SCALE);
+        hi = glm::min(hi, roi_hi / LIGHT_SCALE);
+    }
+}
 
-   // functions to generate new heightmaps
-void GLContainer::generate_heightmap_diamond_square()
+void GLContainer::dispatch_region(GLuint shader)
 {
-    long unsigned int seed = std::chrono::system_clock::now().time_since_epoch().count();
+    glm::ivec3 lo, hi;
+    lighting_region(lo, hi);
+    dispatch_region(shader, lo, hi);
+}
 
-    std::default_random_engine engine{seed};
-    std::uniform_real_distribution<float> distribution{0, 1};
+void GLContainer::dispatch_region(GLuint shader, glm::ivec3 lo, glm::ivec3 hi)
+{
+    if(glm::any(glm::lessThan(hi, lo)))
+        return; // nothing to do
 
-    constexpr auto size =  DIM + 1;
-    constexpr auto edge = size - 1;
+    glUniform3iv(glGetUniformLocation(shader, "region_min"), 1, glm::value_ptr(lo));
+    glUniform3iv(glGetUniformLocation(shader, "region_max"), 1, glm::value_ptr(hi));
 
-    uint8_t map[size][size] = {{0}};
-    map[0][0] = map[edge][0] = map[0][edge] = map[edge][edge] = 128;
+    glm::ivec3 groups = (hi - lo) / 8 + glm::ivec3(1);
+    glDispatchCompute( groups.x, groups.y, groups.z );
+}
+
+void GLContainer::build_brick_list(GLuint near, int reach, GLuint self, int scale, glm::ivec3 lo, glm::ivec3 hi)
+{
+    // the classes are of the block as it's laid out, and they're good till the block changes
+    materialize_offset();
+
+    const int bricks = DIM/8;
+    const GLuint n = bricks * bricks * bricks;
+
+    if(!brick_flags_valid)
+    {
+        LazyCShader &classify = brick_list_compute.variant({{"PASS", "0"}});
+        glUseProgram(classify);
+        glUniform1i(glGetUniformLocation(classify, "current"), 2+tex_offset);
+        glUniform1i(glGetUniformLocation(classify, "current_mask"), 4+tex_offset);
+        glDispatchCompute( bricks, bricks, bricks ); // one workgroup per brick
+        glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+        brick_flags_valid = true;
+    }
+
+    // grown out by reach bricks one axis at a time - from the classes to the second array, to the third, and back
+    GLuint near_offset = 0;
+    reach = std::clamp(reach, 0, bricks);
+    if(reach > 0)
+    {
+        GLuint from[3] = {0, n, 2*n}, to[3] = {n, 2*n, n};
+        for(int axis = 0; axis < 3; axis++)
+        {
+            LazyCShader &dilate = brick_list_compute.variant({{"PASS", "1"}, {"AXIS", std::to_string(axis)}});
+            glUseProgram(dilate);
+            glUniform1ui(glGetUniformLocation(dilate, "source"), from[axis]);
+            glUniform1ui(glGetUniformLocation(dilate, "destination"), to[axis]);
+            glUniform1i(glGetUniformLocation(dilate, "reach"), reach);
+            glDispatchCompute( (bricks+7)/8, (bricks+7)/8, (bricks+7)/8 ); // rounded up, the shader skips what's past the end
+            glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+        }
+        near_offset = n;
+    }
+
+    GLuint count = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, brick_list_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+
+    LazyCShader &list = brick_list_compute.variant({{"PASS", "2"}});
+    glUseProgram(list);
+    glUniform1ui(glGetUniformLocation(list, "near"), near);
+    glUniform1ui(glGetUniformLocation(list, "self"), self);
+    glUniform1ui(glGetUniformLocation(list, "near_offset"), near_offset);
+    glUniform1i(glGetUniformLocation(list, "scale"), scale);
+    glUniform3iv(glGetUniformLocation(list, "box_min"), 1, glm::value_ptr(lo));
+    glUniform3iv(glGetUniformLocation(list, "box_max"), 1, glm::value_ptr(hi));
+    int groups = (bricks / scale + 7) / 8;
+    glDispatchCompute( groups, groups, groups );
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+
+    // and the count, as workgroups for glDispatchComputeIndirect
+    glUseProgram(brick_list_compute.variant({{"PASS", "3"}}));
+    glDispatchCompute( 1, 1, 1 );
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT );
+}
+
+void GLContainer::dispatch_bricks(GLuint shader, glm::ivec3 lo, glm::ivec3 hi)
+{
+    if(glm::any(glm::lessThan(hi, lo)))
+        return; // nothing to do
+
+    // the list has the bricks, the region still trims the ones it only partly covers
+    glUniform3iv(glGetUniformLocation(shader, "region_min"), 1, glm::value_ptr(lo));
+    glUniform3iv(glGetUniformLocation(shader, "region_max"), 1, glm::value_ptr(hi));
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, brick_list_buffer);
+    glDispatchComputeIndirect( sizeof(GLuint) ); // past the count
+}
+
+void GLContainer::dispatch_lighting_bricks(GLuint shader, int reach)
+{
+    // lighting cells are read by the voxels around them, so a brick of them is run if there's anything within
+    // reach bricks of voxels - a brick of lighting cells is LIGHT_SCALE^3 of those
+    glm::ivec3 lo, hi;
+    lighting_region(lo, hi);
+    if(glm::any(glm::lessThan(hi, lo)))
+        return;
+
+    GLint program;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    build_brick_list(BRICK_OCCUPIED, reach, 0, LIGHT_SCALE, lo, hi);
+    glUseProgram(program);
+    dispatch_bricks(shader, lo, hi);
+}
+
+void GLContainer::record_lighting(std::function<void()> apply, std::function<void(glm::ivec3 &, glm::ivec3 &)> affected)
+{
+    if(replaying)
+        return;
+
+    // a replay has to stay inside of the region of interest the operation ran with, not whatever is set by then
+    bool enabled = roi_enabled;
+    glm::ivec3 lo = roi_min, hi = roi_max;
+    lighting_history.push_back({[=]{
+        bool saved_enabled = roi_enabled;
+        glm::ivec3 saved_min = roi_min, saved_max = roi_max;
+        roi_enabled = enabled; roi_min = lo; roi_max = hi;
+        apply();
+        roi_enabled = saved_enabled; roi_min = saved_min; roi_max = saved_max;
+    }, affected});
+}
+
+void GLContainer::utility_box(glm::ivec3 &lo, glm::ivec3 &hi)
+{
+    lo = glm::ivec3(0);
+    hi = glm::ivec3(DIM-1);
+    if(roi_enabled)
+    {
+        lo = glm::clamp(glm::min(roi_min, roi_max), glm::ivec3(0), glm::ivec3(DIM-1));
+        hi = glm::clamp(glm::max(roi_min, roi_max), glm::ivec3(0), glm::ivec3(DIM-1));
+    }
+}
+
+void GLContainer::begin_utility(glm::ivec3 read_lo, glm::ivec3 read_hi)
+{
+    // without a region of interest the whole block is rewritten, so it flips - with one, only the box is
+    // rewritten, so it's done in place, with what the operation reads saved off to the previous block first
+    if(roi_enabled)
+        begin_region_edit(glm::max(read_lo, glm::ivec3(0)), glm::min(read_hi, glm::ivec3(DIM-1)));
+    else
+        swap_blocks();
+}
+
+std::pair<std::string, std::string> GLContainer::roi_define()
+{
+    return {"ROI_MASK", (roi_enabled && roi_masked) ? "1" : "0"};
+}
+
+        // lighting clear (to cached level, or to some set level, default zero)
+void GLContainer::lighting_clear(bool use_cache_level, float intensity)
+{
+    // this is where relighting starts over from - it doesn't depend on the block, so it doesn't grow the box. A
+    // clear inside of a region of interest leaves the rest of the lighting as it was, so that history is kept
+    if(!replaying && !roi_enabled)
+        lighting_history.clear();
+    record_lighting([=]{ lighting_clear(use_cache_level, intensity); }, [](glm::ivec3 &, glm::ivec3 &){});
+
+    redraw_flag = true;
+
+    glUseProgram(lighting_clear_compute);
+
+    glUniform1i(glGetUniformLocation(lighting_clear_compute, "lighting"), 6);
+    glUniform1i(glGetUniformLocation(lighting_clear_compute, "lighting_cache"), 7);
+    glUniform1i(glGetUniformLocation(lighting_clear_compute, "use_cache"), use_cache_level);
+    glUniform1f(glGetUniformLocation(lighting_clear_compute, "intensity"), intensity);
+
+    dispatch_region(lighting_clear_compute);
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+}
+
+
+void GLContainer::compute_new_directional_lighting(float theta, float phi, float initial_ray_intensity, float decay_power, glm::vec3 color)
+{
+    materialize_offset();
+    // auto t1 = std::chrono::high_resolution_clock::now();
+
+    glm::vec3 dir = light_direction(theta, phi);
+    record_lighting([=]{ compute_new_directional_lighting(theta, phi, initial_ray_intensity, decay_power, color); },
+                    [=](glm::ivec3 &lo, glm::ivec3 &hi){ directional_shadow(dir, sweep_spread(LIGHT_DIM) * LIGHT_SCALE, lo, hi); });
+
+    redraw_flag = true;
+    glUseProgram(new_directional_lighting_compute);
+
+    glUniform3fv(glGetUniformLocation(new_directional_lighting_compute, "light_direction"), 1, glm::value_ptr(dir));
+    glUniform1f(glGetUniformLocation(new_directional_lighting_compute, "light_intensity"), initial_ray_intensity);
+    glUniform1f(glGetUniformLocation(new_directional_lighting_compute, "decay_power"), decay_power);
+    glUniform3fv(glGetUniformLocation(new_directional_lighting_compute, "light_color"), 1, glm::value_ptr(color));
+
+    glUniform1i(glGetUniformLocation(new_directional_lighting_compute, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(new_directional_lighting_compute, "lighting"), 6);
+    glUniform1i(glGetUniformLocation(new_directional_lighting_compute, "transmittance"), 14);
+
+    glm::ivec3 region_lo, region_hi;
+    lighting_region(region_lo, region_hi);
+    if(glm::any(glm::lessThan(region_hi, region_lo)))
+        return; // nothing to relight
+
+    glUniform3iv(glGetUniformLocation(new_directional_lighting_compute, "region_min"), 1, glm::value_ptr(region_lo));
+    glUniform3iv(glGetUniformLocation(new_directional_lighting_compute, "region_max"), 1, glm::value_ptr(region_hi));
+
+    // sweep through the block one plane at a time, starting from the side the light comes in - each plane only
+    // needs the one before it. The axis and side are worked out the same way the shader does, to plan how much
+    // of each plane to sweep: the region's cross-section on the planes it covers, and on the planes upstream of
+    // it, whatever the region reads from them (followed back along the light, spread out by sweep_spread())
+    glm::vec3 a = glm::abs(dir);
+    int k = (a.x >= a.y && a.x >= a.z) ? 0 : ((a.y >= a.z) ? 1 : 2);
+    glm::ivec3 axes = glm::ivec3(k, (k + 1) % 3, (k + 2) % 3);
+    bool forward = dir[k] > 0.0;
+    glm::vec2 offset = -glm::vec2(dir[axes.y], dir[axes.z]) / a[k]; // from a cell to where its ray crossed the previous plane
+
+    int last_step = forward ? region_hi[k] : (LIGHT_DIM - 1 - region_lo[k]);
+    std::vector<glm::ivec2> sweep_min(last_step + 1), sweep_max(last_step + 1);
+
+    glm::vec2 cross_min = glm::vec2(region_lo[axes.y], region_lo[axes.z]), lo = glm::vec2(LIGHT_DIM);
+    glm::vec2 cross_max = glm::vec2(region_hi[axes.y], region_hi[axes.z]), hi = glm::vec2(-1);
+    for(int step = last_step; step >= 0; step--)
+    {
+        int plane = forward ? step : (LIGHT_DIM - 1 - step);
+        if(plane >= region_lo[k] && plane <= region_hi[k])
+        {
+            lo = glm::min(lo, cross_min);
+            hi = glm::max(hi, cross_max);
+        }
+
+        float spread = sweep_spread(forward ? (region_lo[k] - plane) : (plane - region_hi[k]));
+        sweep_min[step] = glm::clamp(glm::ivec2(glm::floor(lo - spread)), glm::ivec2(0), glm::ivec2(LIGHT_DIM-1));
+        sweep_max[step] = glm::clamp(glm::ivec2(glm::ceil(hi + spread)), glm::ivec2(0), glm::ivec2(LIGHT_DIM-1));
+
+        lo += offset;
+        hi += offset;
+    }
+
+    for(int step = 0; step <= last_step; step++)
+    {
+        int previous = std::max(step - 1, 0); // reads outside of what was swept there clamp to its edge
+        glUniform1i(glGetUniformLocation(new_directional_lighting_compute, "sweep_step"), step);
+        glUniform2iv(glGetUniformLocation(new_directional_lighting_compute, "sweep_min"), 1, glm::value_ptr(sweep_min[step]));
+        glUniform2iv(glGetUniformLocation(new_directional_lighting_compute, "sweep_max"), 1, glm::value_ptr(sweep_max[step]));
+        glUniform2iv(glGetUniformLocation(new_directional_lighting_compute, "previous_min"), 1, glm::value_ptr(sweep_min[previous]));
+        glUniform2iv(glGetUniformLocation(new_directional_lighting_compute, "previous_max"), 1, glm::value_ptr(sweep_max[previous]));
+
+        glm::ivec2 groups = (sweep_max[step] - sweep_min[step]) / 8 + glm::ivec2(1);
+        glDispatchCompute( groups.x, groups.y, 1 ); //workgroup is 8x8x1
+        glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+    }
+
+    // auto t2 = std::chrono::high_resolution_clock::now();
+
+    // cout << "new lighting took " << std::chrono::duration_cast<std::chrono::microseconds>( t2 - t1 ).count() << " microseconds" << endl;
+}
+
+
+        // point light
+void GLContainer::compute_point_lighting(glm::vec3 location, float initial_intensity, float decay_power, float distance_power, glm::vec3 color)
+{
+    materialize_offset();
+    record_lighting([=]{ compute_point_lighting(location, initial_intensity, decay_power, distance_power, color); },
+                    [=](glm::ivec3 &lo, glm::ivec3 &hi){ point_shadow(location, LIGHT_CUBE_RES, LIGHT_CUBE_SHELLS, lo, hi); });
+
+    redraw_flag = true;
+    float spacing = build_light_cube(location, decay_power, 0.0, 0.0, glm::pi<float>());
+
+    // with sparse_lighting on, only the cells near something are lit
+    LazyCShader &shader = point_lighting_compute.variant({{"BRICK_LIST", sparse_lighting ? "1" : "0"}});
+    glUseProgram(shader);
+
+    glUniform3fv(glGetUniformLocation(shader, "light_position"), 1, glm::value_ptr(location));
+
+    glUniform1f(glGetUniformLocation(shader, "light_intensity"), initial_intensity);
+    glUniform3fv(glGetUniformLocation(shader, "light_color"), 1, glm::value_ptr(color));
+    glUniform1f(glGetUniformLocation(shader, "distance_power"), distance_power);
+
+    glUniform1i(glGetUniformLocation(shader, "shells"), LIGHT_CUBE_SHELLS);
+    glUniform1f(glGetUniformLocation(shader, "shell_spacing"), spacing);
+
+    glUniform1i(glGetUniformLocation(shader, "light_cube"), 13);
+    glUniform1i(glGetUniformLocation(shader, "lighting"), 6);
+    
+    if(sparse_lighting)
+        dispatch_lighting_bricks(shader, 1);
+    else
+        dispatch_region(shader);
+
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT ); 
+}
+
+        // cone light
+void GLContainer::compute_cone_lighting(glm::vec3 location, float theta, float phi, float cone_angle, float initial_intensity, float decay_power, float distance_power, glm::vec3 color)
+{
+    materialize_offset();
+    record_lighting([=]{ compute_cone_lighting(location, theta, phi, cone_angle, initial_intensity, decay_power, distance_power, color); },
+                    [=](glm::ivec3 &lo, glm::ivec3 &hi){ point_shadow(location, LIGHT_CUBE_RES, LIGHT_CUBE_SHELLS, lo, hi); });
+
+    redraw_flag = true;
+    float spacing = build_light_cube(location, decay_power, theta, phi, cone_angle);
+
+    // with sparse_lighting on, only the cells near something are lit
+    LazyCShader &shader = cone_lighting_compute.variant({{"BRICK_LIST", sparse_lighting ? "1" : "0"}});
+    glUseProgram(shader);
+
+    glUniform3fv(glGetUniformLocation(shader, "light_position"), 1, glm::value_ptr(location));
+
+    glUniform1f(glGetUniformLocation(shader, "utheta"), theta);
+    glUniform1f(glGetUniformLocation(shader, "uphi"), phi);
+    
+    glUniform1f(glGetUniformLocation(shader, "cone_angle"), cone_angle);
+    glUniform1f(glGetUniformLocation(shader, "light_intensity"), initial_intensity);
+    glUniform3fv(glGetUniformLocation(shader, "light_color"), 1, glm::value_ptr(color));
+    glUniform1f(glGetUniformLocation(shader, "distance_power"), distance_power);
+
+    glUniform1i(glGetUniformLocation(shader, "shells"), LIGHT_CUBE_SHELLS);
+    glUniform1f(glGetUniformLocation(shader, "shell_spacing"), spacing);
+
+    glUniform1i(glGetUniformLocation(shader, "light_cube"), 13);
+    glUniform1i(glGetUniformLocation(shader, "lighting"), 6);
+    
+    if(sparse_lighting)
+        dispatch_lighting_bricks(shader, 1);
+    else
+        dispatch_region(shader);
+
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT ); 
+}
+
+        // light cube
+float GLContainer::build_light_cube(glm::vec3 location, float decay_power, float theta, float phi, float cone_angle)
+{
+    // one ray per texel of the cube, marched outward from the light - the shells are spread out to the
+    // farthest corner of the block, so every voxel lands between two of them. Returns the shell spacing
+    float farthest = 0.0;
+    for(int corner = 0; corner < 8; corner++)
+        farthest = std::max(farthest, glm::distance(location, glm::vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * float(DIM)));
+    float spacing = std::max(farthest / (LIGHT_CUBE_SHELLS - 1), 1.0f);
+
+    glUseProgram(light_cube_compute);
+
+    glUniform3fv(glGetUniformLocation(light_cube_compute, "light_position"), 1, glm::value_ptr(location));
+    glUniform1f(glGetUniformLocation(light_cube_compute, "decay_power"), decay_power);
+
+    glUniform1f(glGetUniformLocation(light_cube_compute, "utheta"), theta);
+    glUniform1f(glGetUniformLocation(light_cube_compute, "uphi"), phi);
+    glUniform1f(glGetUniformLocation(light_cube_compute, "cone_angle"), cone_angle);
+
+    glUniform1i(glGetUniformLocation(light_cube_compute, "cube_res"), LIGHT_CUBE_RES);
+    glUniform1i(glGetUniformLocation(light_cube_compute, "shells"), LIGHT_CUBE_SHELLS);
+    glUniform1f(glGetUniformLocation(light_cube_compute, "shell_spacing"), spacing);
+
+    glUniform1i(glGetUniformLocation(light_cube_compute, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(light_cube_compute, "light_cube_image"), 15);
+
+    glDispatchCompute(LIGHT_CUBE_RES/8, LIGHT_CUBE_RES/8, 6); // z is the face
+
+    // the gather reads it through a sampler, not an image
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT );
+
+    return spacing;
+}
+
+        // light list
+void GLContainer::add_point_light(glm::vec3 location, float initial_intensity, float decay_power, float distance_power, float range, glm::vec3 color)
+{
+    if(lights.size() == LIGHT_LIST_MAX) { cout << "light list is full" << endl; return; }
+    lights.push_back({glm::vec4(location, POINT_LIGHT), glm::vec4(0), glm::vec4(initial_intensity, decay_power, distance_power, range), glm::vec4(0), glm::vec4(color, 0)});
+}
+
+void GLContainer::add_cone_light(glm::vec3 location, float theta, float phi, float cone_angle, float initial_intensity, float decay_power, float distance_power, float range, glm::vec3 color)
+{
+    if(lights.size() == LIGHT_LIST_MAX) { cout << "light list is full" << endl; return; }
+    lights.push_back({glm::vec4(location, CONE_LIGHT), glm::vec4(light_direction(theta, phi), cone_angle), glm::vec4(initial_intensity, decay_power, distance_power, range), glm::vec4(0), glm::vec4(color, 0)});
+}
+
+void GLContainer::add_directional_light(float theta, float phi, float initial_intensity, float decay_power, glm::vec3 color)
+{
+    if(lights.size() == LIGHT_LIST_MAX) { cout << "light list is full" << endl; return; }
+    lights.push_back({glm::vec4(0, 0, 0, DIRECTIONAL_LIGHT), glm::vec4(light_direction(theta, phi), 0), glm::vec4(initial_intensity, decay_power, 0, 0), glm::vec4(0), glm::vec4(color, 0)});
+}
+
+void GLContainer::apply_light_list()
+{
+    if(lights.empty())
+        return;
+
+    // the atlas tiles are lower resolution than the single lights' - the shadow grows by their texels and shells
+    std::vector<light_t> list = lights;
+    record_lighting([=]() mutable { apply_lights(list); },
+                    [=](glm::ivec3 &lo, glm::ivec3 &hi)
+                    {
+                        glm::ivec3 mins = hi, maxs = lo;
+                        for(auto &l : list)
+                        {
+                            glm::ivec3 a = lo, b = hi;
+                            if(int(l.position.w) == DIRECTIONAL_LIGHT)
+                                directional_shadow(glm::vec3(l.direction), 1.0f + DIM * std::sqrt(3.0f) * (2.0f / LIGHT_LIST_RES + 1.0f / (LIGHT_LIST_SHELLS - 1)), a, b);
+                            else
+                                point_shadow(glm::vec3(l.position), LIGHT_LIST_RES, LIGHT_LIST_SHELLS, a, b);
+                            mins = glm::min(mins, a);
+                            maxs = glm::max(maxs, b);
+                        }
+                        lo = mins;
+                        hi = maxs;
+                    });
+
+    apply_lights(lights);
+}
+
+void GLContainer::apply_lights(std::vector<light_t> &list)
+{
+    materialize_offset();
+    redraw_flag = true;
+
+    // shells reach from the light to the farthest corner of the block - directional lights go across the
+    // block's bounding sphere
+    for(auto &l : list)
+    {
+        float farthest = DIM * std::sqrt(3.0f);
+        if(int(l.position.w) != DIRECTIONAL_LIGHT)
+        {
+            farthest = 0.0;
+            for(int corner = 0; corner < 8; corner++)
+                farthest = std::max(farthest, glm::distance(glm::vec3(l.position), glm::vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * float(DIM)));
+        }
+        l.shadow.x = std::max(farthest / (LIGHT_LIST_SHELLS - 1), 1.0f);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, light_list_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, list.size() * sizeof(light_t), &list[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, light_list_buffer);
+
+    // every light's shadowing, in one dispatch - z picks the light
+    LazyCShader &shadow = light_list_shadow_compute.variant(light_list_defines());
+    glUseProgram(shadow);
+
+    glUniform1i(glGetUniformLocation(shadow, "num_lights"), list.size());
+    glUniform1i(glGetUniformLocation(shadow, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shadow, "shadow_atlas_image"), 16);
+
+    glDispatchCompute( 3*LIGHT_LIST_RES/8, 2*LIGHT_LIST_RES/8, list.size() );
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT );
+
+    // then all of the lights get added up in a single pass over the lighting buffer
+    LazyCShader &gather = light_list_compute.variant(light_list_defines());
+    glUseProgram(gather);
+
+    glUniform1i(glGetUniformLocation(gather, "num_lights"), list.size());
+    glUniform1i(glGetUniformLocation(gather, "shadow_atlas"), 14);
+    glUniform1i(glGetUniformLocation(gather, "lighting"), 6);
+
+    dispatch_region(gather);
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+}
+
+        // ambient occlusion
+void GLContainer::compute_ambient_occlusion(int radius)
+{
+    compute_ambient_occlusion(glm::ivec3(radius), glm::vec3(1.0, 0.0, 0.0));
+}
+
+void GLContainer::compute_ambient_occlusion(glm::ivec3 radii, glm::vec3 weights)
+{
+    materialize_offset();
+    redraw_flag = true;
+
+    // occupancy comes from a summed volume table of alpha, so every scale costs eight loads per voxel no
+    // matter how big it is - same 32 bit limit on the box as the box blur
+    radii = glm::clamp(radii, glm::ivec3(0), glm::ivec3(127));
+    int reach = std::max(std::max(radii.x, radii.y), radii.z);
+    record_lighting([=]{ compute_ambient_occlusion(radii, weights); },
+                    [=](glm::ivec3 &lo, glm::ivec3 &hi){ lo = glm::max(lo - reach, glm::ivec3(0)); hi = glm::min(hi + reach, glm::ivec3(DIM-1)); });
+
+    build_summed_volume(2+tex_offset, 3, glm::ivec3(0), glm::ivec3(DIM-1));
+
+    // cells with nothing within reach of them aren't occluded at all, so only the bricks near something are run
+    LazyCShader &shader = ambient_occlusion_compute.variant({{"BRICK_LIST", "1"}});
+    glUseProgram(shader);
+
+    glUniform3iv(glGetUniformLocation(shader, "radii"), 1, glm::value_ptr(radii));
+    glUniform3fv(glGetUniformLocation(shader, "weights"), 1, glm::value_ptr(weights));
+
+    glUniform1i(glGetUniformLocation(shader, "sat"), 13);
+    glUniform1i(glGetUniformLocation(shader, "lighting"), 6);
+
+    dispatch_lighting_bricks(shader, reach / 8 + 1);
+
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+}
+
+        // fake GI
+void GLContainer::compute_fake_GI(float factor, float sky_intensity, float thresh, glm::vec3 sky_color)
+{
+    materialize_offset();
+    // this reads the lighting of the cells its rays hit, from before it ran, so it isn't restricted to a region -
+    // relighting anything after it has been applied relights the whole block
+    record_lighting([=]{ compute_fake_GI(factor, sky_intensity, thresh, sky_color); },
+                    [](glm::ivec3 &lo, glm::ivec3 &hi){ lo = glm::ivec3(0); hi = glm::ivec3(DIM-1); });
+
+    redraw_flag = true;
+
+    // From the same guy who did the Voxel Automata Terrain, Brent Werness:
+    //   "Totally faked the GI!  It just casts out 9 rays in upwards facing the lattice directions.
+    //    If it escapes it gets light from the sky, otherwise it gets some fraction of the light
+    //    from whatever cell it hits.  Run from top to bottom and you are set!"
+
+    // Rather than running from top to bottom one plane at a time, the whole block is iterated - each iteration
+    // lets light bounce one more cell down a chain of hits, and everything past that is scaled down by factor
+    // per bounce. So iterate till another bounce would be under 1/512 of the light that's there, up to
+    // log2(LIGHT_DIM) times for factors big enough that it doesn't converge quickly (those saturate anyway)
+    int max_iterations = int(std::log2(LIGHT_DIM));
+    int iterations = max_iterations;
+    if(9.0f * factor < 1.0f)
+        iterations = std::clamp(int(std::ceil(std::log(1.0f / 512.0f) / std::log(std::max(9.0f * factor, 1e-6f)))), 1, max_iterations);
+
+    int scratch[2] = {17, 18}; // textures 8 and 9, as packed rgb
+
+    for(int i = 0; i <= iterations; i++)
+    {
+        bool resolve = (i == iterations); // the last pass just writes the result to the lighting buffer
+
+        for(int d = 0; d < (resolve ? 1 : 9); d++)
+        {
+            LazyCShader &shader = fakeGI_compute.variant({{"PASS", resolve ? "2" : (d == 0 ? "0" : "1")}, {"SOURCE_IS_LIGHTING", i == 0 ? "1" : "0"}});
+            glUseProgram(shader);
+
+            glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+            glUniform1i(glGetUniformLocation(shader, "lighting"), 6);
+            glUniform1i(glGetUniformLocation(shader, "source"), scratch[(i + 1) % 2]);
+            glUniform1i(glGetUniformLocation(shader, "destination"), scratch[i % 2]);
+
+            glUniform1f(glGetUniformLocation(shader, "scale_factor"), factor);
+            glUniform1f(glGetUniformLocation(shader, "alpha_thresh"), thresh);
+            glUniform1f(glGetUniformLocation(shader, "sky_intensity"), sky_intensity);
+            glUniform3fv(glGetUniformLocation(shader, "sky_color"), 1, glm::value_ptr(sky_color));
+
+            glm::ivec2 direction = resolve ? glm::ivec2(0) : glm::ivec2(d % 3 - 1, d / 3 - 1);
+            glUniform2iv(glGetUniformLocation(shader, "direction"), 1, glm::value_ptr(direction));
+
+            // one thread per line of lighting cells - the diagonal ones can start outside of the block, so there's up to 2*LIGHT_DIM per side
+            glDispatchCompute( 2*LIGHT_DIM/8, 2*LIGHT_DIM/8, 1 );
+            glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+        }
+    }
+}
+
+        // cone traced GI
+void GLContainer::compute_cone_GI(int preset, float strength, float sky_intensity, glm::vec3 sky_color)
+{
+    materialize_offset();
+    // like fake GI, the cones read lighting from anywhere in the block - relighting after this is everything
+    record_lighting([=]{ compute_cone_GI(preset, strength, sky_intensity, sky_color); },
+                    [](glm::ivec3 &lo, glm::ivec3 &hi){ lo = glm::ivec3(0); hi = glm::ivec3(DIM-1); });
+
+    redraw_flag = true;
+
+    // presets, fastest first - cones per cell, distance between samples as a fraction of the cone's width, and
+    // how far the cones go as a fraction of the block
+    preset = std::clamp(preset, 0, 2);
+    const char *cones[3] = {"6", "16", "32"};
+    const float step_scale[3] = {1.0f, 0.5f, 0.33f};
+    const float reach[3] = {0.25f, 0.5f, 1.0f};
+
+    // build the radiance pyramid from the block and the lighting as they are now - the base level, then each
+    // level from the one below it
+    LazyCShader &base = gi_pyramid_compute.variant({{"LEVEL0", "1"}});
+    glUseProgram(base);
+    glBindImageTexture(19, textures[15], 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
+    glUniform1i(glGetUniformLocation(base, "destination"), 19);
+    glUniform1i(glGetUniformLocation(base, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(base, "lighting"), 6);
+    glDispatchCompute((GI_RES+7)/8, (GI_RES+7)/8, (GI_RES+7)/8);
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+
+    LazyCShader &downsample = gi_pyramid_compute.variant({{"LEVEL0", "0"}});
+    glUseProgram(downsample);
+    for(int level = 1; (GI_RES >> level) > 0; level++)
+    {
+        int res = GI_RES >> level;
+        glBindImageTexture(19, textures[15], level, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
+        glBindImageTexture(20, textures[15], level-1, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
+        glUniform1i(glGetUniformLocation(downsample, "destination"), 19);
+        glUniform1i(glGetUniformLocation(downsample, "source"), 20);
+        glDispatchCompute((res+7)/8, (res+7)/8, (res+7)/8);
+        glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+    }
+    glMemoryBarrier( GL_TEXTURE_FETCH_BARRIER_BIT );
+
+    // then trace the cones from every lighting cell
+    LazyCShader &shader = cone_GI_compute.variant({{"CONES", cones[preset]}});
+    glUseProgram(shader);
+
+    glUniform1i(glGetUniformLocation(shader, "lighting"), 6);
+    glUniform1i(glGetUniformLocation(shader, "pyramid"), 15);
+
+    glUniform1f(glGetUniformLocation(shader, "strength"), strength);
+    glUniform1f(glGetUniformLocation(shader, "step_scale"), step_scale[preset]);
+    glUniform1f(glGetUniformLocation(shader, "max_distance"), reach[preset] * DIM);
+    glUniform1f(glGetUniformLocation(shader, "sky_intensity"), sky_intensity);
+    glUniform3fv(glGetUniformLocation(shader, "sky_color"), 1, glm::value_ptr(sky_color));
+
+    dispatch_region(shader);
+
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+}
+
+        // mash (combine light into color buffer)
+        //   realized this morning that in some ways conceptually this really is a form of dynamic range compression
+void GLContainer::mash()
+{
+    glm::ivec3 lo, hi;
+    utility_box(lo, hi);
+
+    redraw_flag = true;
+    mark_dirty(glm::vec3(lo), glm::vec3(hi));
+
+    // only the bricks with something in them can change - everywhere else the color is zero, and stays zero - so
+    // just those are copied and edited in place, and the undo history only looks through them. A masked region
+    // of interest only needs the ones with some of the mask
+    build_brick_list(BRICK_OCCUPIED, 0, (roi_enabled && roi_masked) ? BRICK_MASKED : 0, 1, lo, hi);
+    begin_brick_edit();
+
+    LazyCShader &shader = mash_compute.variant({roi_define(), {"BRICK_LIST", "1"}});
+    glUseProgram(shader);
+
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "lighting"), 6);
+
+    dispatch_bricks(shader, lo, hi);
+
+    glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
+}
+
+
+        // undo history
+void GLContainer::commit_undo()
+{
+    if(!undo_pending)
+        return;
+    undo_pending = false;
+
+    // the recording before this one shares the buffer - it has to be out of it first
+    poll_undo(true);
+
+    // room for as many bricks as the budget could ever keep - a record bigger than that is dropped anyway, so its
+    // deltas don't have to be gathered. Nothing's in flight here, so it can be remade if the budget has changed
+    const size_t bricks = size_t(DIM/8) * (DIM/8) * (DIM/8);
+    const size_t brick_bytes = UNDO_BRICK_WORDS * sizeof(GLuint);
+    size_t capacity = std::max(size_t(1), std::min(bricks, undo_budget / brick_bytes));
+    if(!undo_record_buffer || capacity != undo_record_capacity)
+    {
+        if(!undo_record_buffer)
+            glGenBuffers(1, &undo_record_buffer);
+        undo_record_capacity = capacity;
+        undo_record_head = ((4 + bricks) * sizeof(GLuint) + 4095) & ~size_t(4095); // the deltas' offset has to be aligned
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, undo_record_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, undo_record_head + capacity * brick_bytes, NULL, GL_STREAM_READ);
+    }
+
+    // which bricks did the last operation change
+    GLuint count = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, undo_list_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+
+    LazyCShader &find = undo_from_list ? undo_compute.variant({{"PASS", "0"}, {"BRICK_LIST", "1"}}) : undo_compute.variant({{"PASS", "0"}});
+    glUseProgram(find);
+    glUniform1i(glGetUniformLocation(find, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(find, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(find, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(find, "previous_mask"), 5-tex_offset);
+
+    if(undo_from_list)
+    {
+        // only the bricks an in-place brick edit copied can differ - through its list, at binding 9
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, edit_list_buffer);
+        glDispatchComputeIndirect( sizeof(GLuint) ); // past the count
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, brick_list_buffer);
+    }
+    else
+    {
+        glUniform3iv(glGetUniformLocation(find, "brick_min"), 1, glm::value_ptr(undo_min / 8));
+
+        glm::ivec3 groups = (undo_max - undo_min) / 8 + glm::ivec3(1);
+        glDispatchCompute( groups.x, groups.y, groups.z );
+    }
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+
+    // the count never comes back to the host here - it's turned into the workgroups for the gather on the GPU
+    LazyCShader &size = undo_compute.variant({{"PASS", "3"}});
+    glUseProgram(size);
+    glUniform1ui(glGetUniformLocation(size, "limit"), GLuint(capacity));
+    glDispatchCompute( 1, 1, 1 );
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT );
+
+    // the list goes to the head of the record, and the deltas of every brick on it after that, in one dispatch
+    glBindBuffer(GL_COPY_READ_BUFFER, undo_list_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, undo_record_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (4 + bricks) * sizeof(GLuint));
+
+    LazyCShader &gather = undo_compute.variant({{"PASS", "1"}});
+    glUseProgram(gather);
+    glUniform1i(glGetUniformLocation(gather, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(gather, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(gather, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(gather, "previous_mask"), 5-tex_offset);
+    glUniform1ui(glGetUniformLocation(gather, "limit"), GLuint(capacity));
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 3, undo_record_buffer, undo_record_head, capacity * brick_bytes);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, undo_list_buffer);
+    glDispatchComputeIndirect( sizeof(GLuint) ); // past the count
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, brick_list_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, undo_payload_buffer);
+    glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+
+    undo_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool GLContainer::poll_undo(bool wait)
+{
+    if(undo_fence)
+    {
+        // not waiting is a timeout of zero, same as the statistics
+        GLenum status;
+        do
+            status = glClientWaitSync(undo_fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+        while(wait && status == GL_TIMEOUT_EXPIRED);
+
+        if(status == GL_TIMEOUT_EXPIRED)
+            return false;
+
+        glDeleteSync(undo_fence);
+        undo_fence = 0;
+        if(status == GL_WAIT_FAILED)
+            return false;
+
+        GLuint count = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, undo_record_buffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+        if(count == 0)
+            return false; // nothing changed, nothing to undo
+
+        // a new step means the steps that were undone can't be redone anymore - even if this one can't be kept
+        for(auto &old : redo_stack)
+            undo_bytes -= old.bytes();
+        redo_stack.clear();
+
+        // past the capacity the deltas weren't all gathered - the record would be over the budget by itself. The
+        // older steps are still good, the block just can't go back past this one
+        if(count > undo_record_capacity)
+        {
+            undo_skipped = "The last operation changed too much to fit in the budget, so it can't be undone.";
+            cout << undo_skipped << endl;
+            return false;
+        }
+
+        size_t brick_bytes = UNDO_BRICK_WORDS * sizeof(GLuint);
+        undo_mapped = reinterpret_cast<const uint8_t *>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, undo_record_head + count * brick_bytes, GL_MAP_READ_BIT));
+        if(!undo_mapped)
+            return false;
+
+        // the deltas are compressed a chunk per thread, on a thread of their own so the frames keep coming
+        undo_compressed = false;
+        undo_worker = std::thread([this, count, brick_bytes](){
+            undo_record &r = undo_incoming;
+            const GLuint *list = reinterpret_cast<const GLuint *>(undo_mapped) + 4; // past the count and workgroups
+            const uint8_t *deltas = undo_mapped + undo_record_head;
+            r.bricks.assign(list, list + count);
+
+            glm::ivec3 lo(DIM), hi(0);
+            for(auto b : r.bricks)
+            {
+                glm::ivec3 origin = 8 * glm::ivec3(b % (DIM/8), (b / (DIM/8)) % (DIM/8), b / ((DIM/8)*(DIM/8)));
+                lo = glm::min(lo, origin);
+                hi = glm::max(hi, origin + glm::ivec3(7));
+            }
+            for(int i = 0; i < 3; i++)
+            {
+                r.lo[i] = lo[i];
+                r.hi[i] = hi[i];
+            }
+
+            // chunks of UNDO_BATCH bricks, which is how they go back
+            r.chunks.resize((count + UNDO_BATCH - 1) / UNDO_BATCH);
+            parallel_for(int(r.chunks.size()), [&](int chunk){
+                size_t first = size_t(chunk) * UNDO_BATCH;
+                size_t batch = std::min(size_t(UNDO_BATCH), count - first);
+                r.chunks[chunk] = undo_compress(deltas + first * brick_bytes, batch * brick_bytes);
+            });
+            undo_compressed = true;
+        });
+    }
+
+    if(!undo_worker.joinable() || (!wait && !undo_compressed))
+        return false;
+
+    undo_worker.join();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, undo_record_buffer);
+    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    undo_mapped = nullptr;
+
+    undo_record r = std::move(undo_incoming);
+    undo_incoming = undo_record();
+
+    // a step over the budget by itself would push out the whole history - better to lose just this one
+    if(r.bytes() > undo_budget)
+    {
+        undo_skipped = "The last operation changed too much to fit in the budget, so it can't be undone.";
+        cout << undo_skipped << endl;
+        return false;
+    }
+    undo_skipped.clear();
+
+    undo_bytes += r.bytes();
+    undo_stack.push_back(std::move(r));
+
+    // past the budget, the oldest steps go
+    while(undo_bytes > undo_budget && undo_stack.size() > 1)
+    {
+        undo_bytes -= undo_stack.front().bytes();
+        undo_stack.pop_front();
+    }
+    return true;
+}
+
+void GLContainer::apply_undo_record(undo_record &r)
+{
+    // the brick list goes back up where the shader expects it, then the deltas, a batch at a time - only the bricks
+    // in the record are touched, so this costs about as much as the operation changed
+    block_changed();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, undo_list_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(GLuint), r.bricks.size() * sizeof(GLuint), &r.bricks[0]); // past the count and workgroups
+
+    LazyCShader &apply = undo_compute.variant({{"PASS", "2"}});
+    glUseProgram(apply);
+    glUniform1i(glGetUniformLocation(apply, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(apply, "current_mask"), 4+tex_offset);
+
+    std::vector<GLuint> deltas(UNDO_BATCH * UNDO_BRICK_WORDS);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, undo_payload_buffer);
+    for(size_t chunk = 0; chunk < r.chunks.size(); chunk++)
+    {
+        GLuint first = GLuint(chunk * UNDO_BATCH);
+        GLuint batch = std::min(GLuint(UNDO_BATCH), GLuint(r.bricks.size()) - first);
+        undo_decompress(r.chunks[chunk], reinterpret_cast<uint8_t *>(&deltas[0]), batch * UNDO_BRICK_WORDS * sizeof(GLuint));
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, batch * UNDO_BRICK_WORDS * sizeof(GLuint), &deltas[0]);
+
+        glUniform1ui(glGetUniformLocation(apply, "first"), first);
+        glDispatchCompute( batch, 1, 1 );
+        glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+    }
+
+    redraw_flag = true;
+    mark_dirty(glm::vec3(r.lo[0], r.lo[1], r.lo[2]), glm::vec3(r.hi[0], r.hi[1], r.hi[2]));
+}
+
+void GLContainer::undo()
+{
+    materialize_offset(); // the deltas are in the layout the block actually has
+    commit_undo();
+    poll_undo(true); // the step being undone may still be on its way in
+    if(undo_stack.empty())
+        return;
+
+    // the deltas are XORs, so applying one to the block after its operation takes it back to before
+    apply_undo_record(undo_stack.back());
+    redo_stack.push_back(std::move(undo_stack.back()));
+    undo_stack.pop_back();
+}
+
+void GLContainer::redo()
+{
+    materialize_offset();
+    commit_undo(); // if anything happened since the last undo, this clears the redo stack
+    poll_undo(true);
+    if(redo_stack.empty())
+        return;
+
+    apply_undo_record(redo_stack.back());
+    undo_stack.push_back(std::move(redo_stack.back()));
+    redo_stack.pop_back();
+}
+
+        // relighting after edits
+void GLContainer::mark_dirty(glm::vec3 min, glm::vec3 max)
+{
+    block_changed();
+
+    // a cell of slack, for shapes that are tested against cell centers
+    glm::ivec3 lo = glm::clamp(glm::ivec3(glm::floor(glm::min(min, max))) - glm::ivec3(1), glm::ivec3(0), glm::ivec3(DIM-1));
+    glm::ivec3 hi = glm::clamp(glm::ivec3(glm::ceil(glm::max(min, max))) + glm::ivec3(1), glm::ivec3(0), glm::ivec3(DIM-1));
+
+    dirty_min = dirty ? glm::min(dirty_min, lo) : lo;
+    dirty_max = dirty ? glm::max(dirty_max, hi) : hi;
+    dirty = true;
+
+    distance_dirty_min = distance_dirty ? glm::min(distance_dirty_min, lo) : lo;
+    distance_dirty_max = distance_dirty ? glm::max(distance_dirty_max, hi) : hi;
+    distance_dirty = true;
+
+    // what was drawn is somewhere in the box - an empty content box is min past max, so it just becomes this
+    content_min = glm::min(content_min, lo);
+    content_max = glm::max(content_max, hi);
+    content_exact = false;
+}
+
+void GLContainer::relight_dirty()
+{
+    if(!dirty)
+        return;
+    materialize_offset(); // the lighting operations need the block where it appears to be - this marks it all dirty
+    dirty = false;
+
+    // each operation grows the edited box into the lighting it changes for that operation - the union of those
+    // gets cleared back to where the history starts, and then everything is applied again, inside of it
+    glm::ivec3 lo = dirty_min, hi = dirty_max;
+    for(auto &op : lighting_history)
+    {
+        glm::ivec3 a = dirty_min, b = dirty_max;
+        op.affected(a, b);
+        lo = glm::min(lo, a);
+        hi = glm::max(hi, b);
+    }
+
+    // the boxes are in voxels, the region is in lighting cells
+    region_min = lo / LIGHT_SCALE;
+    region_max = hi / LIGHT_SCALE;
+    replaying = true;
+
+    for(auto &op : lighting_history)
+        op.apply();
+
+    replaying = false;
+    region_min = glm::ivec3(0);
+    region_max = glm::ivec3(LIGHT_DIM-1);
+}
+
+
+// ------------------------
+// ------------------------
+// statistics
+void GLContainer::block_changed()
+{
+    brick_flags_valid = false;
+    block_version++;
+}
+
+void GLContainer::compute_statistics(float alpha_threshold)
+{
+    // of the block as it's laid out
+    materialize_offset();
+
+    // anything still in flight is of an older block, or another threshold - this one replaces it
+    if(statistics_fence)
+        glDeleteSync(statistics_fence);
+
+    std::vector<GLint> start(8 + 4*256, 0);
+    for(int i = 0; i < 3; i++)
+    {
+        start[2 + i] = DIM;
+        start[5 + i] = -1;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statistics_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, start.size() * sizeof(GLint), &start[0]);
+
+    glUseProgram(statistics_compute);
+    glUniform1i(glGetUniformLocation(statistics_compute, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(statistics_compute, "current_mask"), 4+tex_offset);
+    glUniform1f(glGetUniformLocation(statistics_compute, "alpha_threshold"), alpha_threshold);
+    glDispatchCompute( DIM/8, DIM/8, DIM/8 ); // one workgroup per brick
+    glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+
+    statistics_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    statistics_version = block_version;
+    statistics_threshold = alpha_threshold;
+}
+
+bool GLContainer::poll_statistics(bool wait)
+{
+    if(!statistics_fence)
+        return false;
+
+    // not waiting is a timeout of zero - the commands get flushed at the end of the frame anyway
+    GLenum status;
+    do
+        status = glClientWaitSync(statistics_fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+    while(wait && status == GL_TIMEOUT_EXPIRED);
+
+    if(status == GL_TIMEOUT_EXPIRED)
+        return false;
+
+    glDeleteSync(statistics_fence);
+    statistics_fence = 0;
+    if(status == GL_WAIT_FAILED)
+        return false;
+
+    std::vector<GLint> result(8 + 4*256);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statistics_buffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, result.size() * sizeof(GLint), &result[0]);
+
+    stats.valid = true;
+    stats.version = statistics_version;
+    stats.threshold = statistics_threshold;
+    stats.occupied = unsigned(result[0]);
+    stats.masked = unsigned(result[1]);
+    stats.min = glm::ivec3(result[2], result[3], result[4]);
+    stats.max = glm::ivec3(result[5], result[6], result[7]);
+    for(int c = 0; c < 4; c++)
+        for(int b = 0; b < 256; b++)
+            stats.histogram[c][b] = unsigned(result[8 + 256*c + b]);
+
+    // at threshold zero, the box is everything the raycaster can see - nothing, if it's empty
+    if(statistics_current() && stats.threshold == 0.0f)
+    {
+        content_min = stats.min;
+        content_max = stats.max;
+        content_exact = true;
+    }
+    return true;
+}
+
+void GLContainer::update_content_box()
+{
+    // not while a virtual shift is pending, since the reduction would have to materialize it
+    if(tight_bounds && !content_exact && !statistics_pending() && block_offset == glm::ivec3(0))
+        compute_statistics(0.0f);
+}
+
+bool GLContainer::content_bounds(float alpha_threshold, glm::ivec3 &lo, glm::ivec3 &hi)
+{
+    materialize_offset(); // before checking if the statistics are current, since this changes the version
+
+    // something already in flight for this block and threshold is waited for, instead of started over
+    poll_statistics(statistics_pending() && statistics_version == block_version && statistics_threshold == alpha_threshold);
+    if(!statistics_current() || stats.threshold != alpha_threshold)
+    {
+        compute_statistics(alpha_threshold);
+        poll_statistics(true);
+    }
+
+    if(stats.occupied == 0)
+        return false;
+    lo = stats.min;
+    hi = stats.max;
+    return true;
+}
+
+// the same rotation as shaders/include/rotation.glsl, built column by column like it is there
+static glm::mat3 rotation_matrix(glm::vec3 axis, float angle)
+{
+    axis = glm::normalize(axis);
+    float s = std::sin(angle);
+    float c = std::cos(angle);
+    float oc = 1.0f - c;
+
+    return glm::mat3(oc * axis.x * axis.x + c,           oc * axis.x * axis.y - axis.z * s,  oc * axis.z * axis.x + axis.y * s,
+                     oc * axis.x * axis.y + axis.z * s,  oc * axis.y * axis.y + c,           oc * axis.y * axis.z - axis.x * s,
+                     oc * axis.z * axis.x - axis.y * s,  oc * axis.y * axis.z + axis.x * s,  oc * axis.z * axis.z + c);
+}
+
+void GLContainer::screen_rect(glm::ivec3 lo, glm::ivec3 hi, glm::ivec2 &min, glm::ivec2 &max)
+{
+    // the raycaster's camera is orthographic - a ray starts at (x, y, 2) in view space, rotated into the block's
+    // space by phi then theta, so each corner of the box goes back through the transpose of that to get its x, y
+    glm::mat3 rotation = rotation_matrix(glm::vec3(1,0,0), phi) * rotation_matrix(glm::vec3(0,1,0), theta);
+    glm::vec2 dimensions = glm::vec2(int(SSFACTOR*screen_width), int(SSFACTOR*screen_height)); // the render texture
+    float aspect_ratio = dimensions.y / dimensions.x;
+
+    glm::vec2 mins = glm::vec2(1e30f), maxs = glm::vec2(-1e30f);
+    for(int corner = 0; corner < 8; corner++)
+    {
+        glm::ivec3 v = glm::ivec3((corner & 1) ? hi.x + 1 : lo.x, (corner & 2) ? hi.y + 1 : lo.y, (corner & 4) ? hi.z + 1 : lo.z);
+        glm::vec3 view = (glm::vec3(v) * (2.0f / DIM) - glm::vec3(1)) * glm::transpose(rotation);
+
+        // render texture pixels from the bottom left, then screen pixels from the top left
+        glm::vec2 texel = glm::vec2((view.x / scale + 0.5f) * dimensions.x - clickndragx,
+                                    (view.y / (scale * aspect_ratio) + 0.5f) * dimensions.y - clickndragy);
+        glm::vec2 pixel = glm::vec2(texel.x / SSFACTOR, float(screen_height) - texel.y / SSFACTOR);
+        mins = glm::min(mins, pixel);
+        maxs = glm::max(maxs, pixel);
+    }
+
+    // a couple pixels of margin, for the filtering
+    glm::ivec2 last = glm::ivec2(screen_width, screen_height) - glm::ivec2(1);
+    min = glm::clamp(glm::ivec2(glm::floor(mins)) - glm::ivec2(2), glm::ivec2(0), last);
+    max = glm::clamp(glm::ivec2(glm::ceil(maxs)) + glm::ivec2(2), glm::ivec2(0), last);
+}
+
+
+// ------------------------
+// ------------------------
+// CPU-side utilities
+
+   // functions to generate new heightmaps
+void GLContainer::generate_heightmap_diamond_square()
+{
+    long unsigned int seed = std::chrono::system_clock::now().time_since_epoch().count();
+
+    std::default_random_engine engine{seed};
+    std::uniform_real_distribution<float> distribution{0, 1};
+
+    constexpr auto size =  DIM + 1;
+    constexpr auto edge = size - 1;
+
+    uint8_t map[size][size] = {{0}};
+    map[0][0] = map[edge][0] = map[0][edge] = map[edge][edge] = 128;
 
     heightfield::diamond_square_no_wrap(
         size,
@@ -1641,18 +3489,19 @@ void GLContainer::generate_perlin_noise(float xscale=0.014, float yscale=0.04, f
 void GLContainer::copy_loadbuffer(bool respect_mask)
 {
     redraw_flag = true;
+    mark_dirty();
     swap_blocks();
-    glUseProgram(copy_loadbuff_compute);
+    LazyCShader &shader = copy_loadbuff_compute.variant({{"RESPECT_MASK", respect_mask ? "1" : "0"}}); // flags are compiled in, not uniforms
+    glUseProgram(shader);
 
-    glUniform1i(glGetUniformLocation(copy_loadbuff_compute, "respect_mask"), respect_mask);
 
-    glUniform1i(glGetUniformLocation(copy_loadbuff_compute, "current"), 2+tex_offset);
-    glUniform1i(glGetUniformLocation(copy_loadbuff_compute, "current_mask"), 4+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current"), 2+tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "current_mask"), 4+tex_offset);
 
-    glUniform1i(glGetUniformLocation(copy_loadbuff_compute, "previous"), 3-tex_offset);
-    glUniform1i(glGetUniformLocation(copy_loadbuff_compute, "previous_mask"), 5-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous"), 3-tex_offset);
+    glUniform1i(glGetUniformLocation(shader, "previous_mask"), 5-tex_offset);
 
-    glUniform1i(glGetUniformLocation(copy_loadbuff_compute, "loadbuff"), 10);
+    glUniform1i(glGetUniformLocation(shader, "loadbuff"), 10);
 
     glDispatchCompute( DIM/8, DIM/8, DIM/8 );
     glMemoryBarrier( GL_SHADER_IMAGE_ACCESS_BARRIER_BIT );
@@ -1731,39 +3580,167 @@ void GLContainer::load(std::string filename, bool respect_mask)
 {
     redraw_flag = true;
 
-    std::vector<unsigned char> image_loaded_bytes;
+    std::vector<unsigned char> image_loaded_bytes, png;
     unsigned width, height;
 
-    unsigned error = lodepng::decode(image_loaded_bytes, width, height, filename.c_str());
+    lodepng::State state;
+    unsigned error = lodepng::load_file(png, filename);
+    if(!error)
+        error = lodepng::decode(image_loaded_bytes, width, height, state, png);
 
     //report any errors
-    if(error) std::cout << "decode error during load(\" "+ filename +" \") " << error << ": " << lodepng_error_text(error) << std::endl;
+    if(error)
+    {
+        std::cout << "decode error during load(\" "+ filename +" \") " << error << ": " << lodepng_error_text(error) << std::endl;
+        return;
+    }
+
+    // a save cropped to its content says where the box it has goes
+    glm::ivec3 lo = glm::ivec3(0), size = glm::ivec3(DIM);
+    for(size_t i = 0; i < state.info_png.text_num; i++)
+        if(std::string(state.info_png.text_keys[i]) == "voraldo_crop")
+            std::stringstream(state.info_png.text_strings[i]) >> lo.x >> lo.y >> lo.z >> size.x >> size.y >> size.z;
+
+    if(glm::any(glm::lessThan(lo, glm::ivec3(0))) || glm::any(glm::lessThan(size, glm::ivec3(1))) || glm::any(glm::greaterThan(lo + size, glm::ivec3(DIM)))
+        || width != unsigned(size.x) || height != unsigned(size.y*size.z))
+    {
+        std::cout << "load(\" "+ filename +" \") is not a block of this size" << std::endl;
+        return;
+    }
 
     //put that shit in the front buffer with glTexImage3D()
     glBindTexture(GL_TEXTURE_3D, textures[10]); // put it in the loadbuffer
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, DIM, DIM, DIM, 0,  GL_RGBA, GL_UNSIGNED_BYTE, &image_loaded_bytes[0]);
+    if(size == glm::ivec3(DIM))
+    {
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, DIM, DIM, DIM, 0,  GL_RGBA, GL_UNSIGNED_BYTE, &image_loaded_bytes[0]);
+    }
+    else
+    {
+        // empty around the box
+        glClearTexImage(textures[10], 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, lo.x, lo.y, lo.z, size.x, size.y, size.z, GL_RGBA, GL_UNSIGNED_BYTE, &image_loaded_bytes[0]);
+    }
 
     copy_loadbuffer(respect_mask);
 
     cout << "filename on load is: " << filename << std::endl << std::endl;
 }
 
+   // mesh import - set redraw_flag to true
+std::string GLContainer::load_mesh(std::string filename, float scale, bool solid, bool use_mesh_color, glm::vec4 color, bool respect_mask)
+{
+    redraw_flag = true;
+
+    auto tstart = std::chrono::high_resolution_clock::now();
+
+    // parses the file, fits it to the block and builds the BVH
+    mesh_voxelizer m(filename, scale);
+    if(!m.ok())
+    {
+        cout << "mesh import of \"" << filename << "\" failed: " << m.error << endl;
+        return m.error;
+    }
+
+    // voxelized a slab at a time and streamed into the loadbuffer, so the whole block never has to sit in memory CPU-side
+    const int slab = std::min(64, DIM);
+    std::vector<unsigned char> slab_bytes;
+
+    glBindTexture(GL_TEXTURE_3D, textures[10]);
+    for(int z = 0; z < DIM; z += slab)
+    {
+        m.voxelize_slab(z, slab, solid, use_mesh_color, color, slab_bytes);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, z, DIM, DIM, slab, GL_RGBA, GL_UNSIGNED_BYTE, &slab_bytes[0]);
+    }
+
+    copy_loadbuffer(respect_mask);
+
+    auto tend = std::chrono::high_resolution_clock::now();
+    std::string status = std::to_string(m.triangle_count()) + " triangles voxelized in " +
+        std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(tend - tstart).count()) + " ms";
+
+    cout << "mesh import of \"" << filename << "\": " << status << endl;
+    return status;
+}
+
+   // point cloud import - set redraw_flag to true
+std::string GLContainer::load_point_cloud(std::string filename, float scale, bool z_up, glm::vec4 color, bool respect_mask)
+{
+    redraw_flag = true;
+
+    auto tstart = std::chrono::high_resolution_clock::now();
+
+    // maps the file and makes the bounds pass
+    point_cloud_splatter p(filename, scale, z_up);
+    if(!p.ok())
+    {
+        cout << "point cloud import of \"" << filename << "\" failed: " << p.error << endl;
+        return p.error;
+    }
+
+    // each slab is one pass over the file - the accumulation buffer is 8 bytes a voxel, so this bounds memory
+    // use at 8*DIM*DIM*slab bytes (128MB at DIM 512), plus 4*DIM*DIM*16 for the bytes going to the GPU
+    const int slab = std::min(64, DIM), upload = std::min(16, slab);
+    std::vector<unsigned char> upload_bytes(4 * DIM * DIM * upload, 0);
+
+    glBindTexture(GL_TEXTURE_3D, textures[10]);
+    for(int z = 0; z < DIM; z += slab)
+    {
+        bool empty = (z + slab <= p.zmin || z > p.zmax);
+        if(!empty)
+            p.accumulate(z, slab);
+        else
+            std::fill(upload_bytes.begin(), upload_bytes.end(), 0);
+
+        for(int k = z; k < z + slab; k += upload)
+        {
+            if(!empty)
+                p.resolve(k, upload, color, upload_bytes);
+            glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, k, DIM, DIM, upload, GL_RGBA, GL_UNSIGNED_BYTE, &upload_bytes[0]);
+        }
+    }
+
+    copy_loadbuffer(respect_mask);
+
+    auto tend = std::chrono::high_resolution_clock::now();
+    std::string status = std::to_string(p.point_count()) + " points splatted in " +
+        std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(tend - tstart).count()) + " ms";
+
+    cout << "point cloud import of \"" << filename << "\": " << status << endl;
+    return status;
+}
+
    // save
 void GLContainer::save(std::string filename)
 {
-    // don't need to redraw
-    std::vector<unsigned char> image_bytes_to_save;
+    // don't need to redraw - but the file gets the block the way it looks
+    materialize_offset();
+    std::vector<unsigned char> image_bytes_to_save, png;
     unsigned width, height;
 
-    width = DIM;
-    height = DIM*DIM;
+    // cropped to the content, the slices are only as big as its box, and the box goes in a text chunk
+    glm::ivec3 lo = glm::ivec3(0), hi = glm::ivec3(DIM-1);
+    bool cropped = crop_saves && content_bounds(ANY_NONZERO, lo, hi);
+    glm::ivec3 size = hi - lo + glm::ivec3(1);
+
+    width = size.x;
+    height = size.y*size.z;
 
-    image_bytes_to_save.resize(4*DIM*DIM*DIM);
+    image_bytes_to_save.resize(4*size.x*size.y*size.z);
     filename = std::string("saves/") + filename;
 
-    glGetTextureImage( textures[2+tex_offset], 0, GL_RGBA, GL_UNSIGNED_BYTE, 4*DIM*DIM*DIM, &image_bytes_to_save[0]);
+    glGetTextureSubImage( textures[2+tex_offset], 0, lo.x, lo.y, lo.z, size.x, size.y, size.z, GL_RGBA, GL_UNSIGNED_BYTE, image_bytes_to_save.size(), &image_bytes_to_save[0]);
+
+    lodepng::State state;
+    if(cropped)
+    {
+        std::stringstream box;
+        box << lo.x << " " << lo.y << " " << lo.z << " " << size.x << " " << size.y << " " << size.z;
+        lodepng_add_text(&state.info_png, "voraldo_crop", box.str().c_str());
+    }
 
-    unsigned error = lodepng::encode(filename.c_str(), image_bytes_to_save, width, height);
+    unsigned error = lodepng::encode(png, image_bytes_to_save, width, height, state);
+    if(!error)
+        error = lodepng::save_file(png, filename);
     if(error) std::cout << "encode error during save(\" "+ filename +" \") " << error << ": " << lodepng_error_text(error) << std::endl;
 
     cout << "filename on save is: " << filename << std::endl << std::endl;
@@ -1773,5 +3750,23 @@ void GLContainer::save(std::string filename)
 void GLContainer::delete_textures()
 {
     // delete the textures
-   glDeleteTextures(13, &textures[0]); 
+   glDeleteTextures(17, &textures[0]); 
+   glDeleteBuffers(1, &light_list_buffer);
+   glDeleteBuffers(1, &components_buffer);
+   glDeleteBuffers(1, &undo_list_buffer);
+   glDeleteBuffers(1, &undo_payload_buffer);
+   if(undo_worker.joinable())
+       undo_worker.join(); // before the buffer it reads from goes
+   if(undo_record_buffer)
+       glDeleteBuffers(1, &undo_record_buffer);
+   if(undo_fence)
+       glDeleteSync(undo_fence);
+   glDeleteBuffers(1, &clipboard_index_buffer);
+   glDeleteBuffers(1, &clipboard_data_buffer);
+   glDeleteBuffers(1, &brick_flags_buffer);
+   glDeleteBuffers(1, &brick_list_buffer);
+   glDeleteBuffers(1, &edit_list_buffer);
+   glDeleteBuffers(1, &statistics_buffer);
+   if(statistics_fence)
+       glDeleteSync(statistics_fence);
 }
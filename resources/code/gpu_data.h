@@ -3,6 +3,39 @@
 
 #include "includes.h"
 
+// one entry in the light list - vec4s only, so the std430 layout matches struct light in light_list.glsl
+struct light_t
+{
+    glm::vec4 position;    // xyz is the location (point, cone), w is the type
+    glm::vec4 direction;   // xyz is the direction the light travels (cone, directional), w is the cone angle
+    glm::vec4 parameters;  // intensity, decay power, distance power, range (0 for no limit)
+    glm::vec4 shadow;      // x is the distance between shells in the light's tile - filled in by apply_light_list()
+    glm::vec4 color;       // rgb color of the light, w unused
+};
+
+#define POINT_LIGHT 0
+#define CONE_LIGHT 1
+#define DIRECTIONAL_LIGHT 2
+
+// brick classes, for brick lists - anything non-zero in the brick, any masked voxels, any unmasked voxels
+#define BRICK_OCCUPIED 1u
+#define BRICK_MASKED   2u
+#define BRICK_UNMASKED 4u
+#define BRICK_ROW 1024  // workgroups per row of an indirect dispatch over a brick list
+
+// what compute_statistics() finds - occupied is alpha above the threshold it was run with, or with ANY_NONZERO,
+// anything that isn't all zero, color or alpha
+#define ANY_NONZERO -1.0f
+struct volume_statistics
+{
+    bool valid = false;          // has anything come back yet
+    unsigned version = 0;        // which version of the block it's of
+    float threshold = 0.0f;
+    unsigned occupied = 0, masked = 0;
+    glm::ivec3 min, max;         // the tight box around the occupied voxels, inclusive - min > max when there aren't any
+    unsigned histogram[4][256];  // r, g, b and a of the occupied voxels
+};
+
 class GLContainer
 {
     public:
@@ -14,6 +47,10 @@ class GLContainer
         // initialization
         void init() { compile_shaders(); buffer_geometry(); load_textures(); }
 
+        // shader compilation status - programs are compiled lazily, or prewarmed in the background
+        int shaders_pending();              // how many registered compute shaders aren't ready yet
+        void prewarm_shaders(int count);    // start compiling up to count more shaders, only with parallel compile (call once per frame)
+
         // display function
         bool show_widget = true;
         void display() { display_block(); if(show_widget) display_orientation_widget(); }
@@ -25,9 +62,21 @@ class GLContainer
         // part of the quitting operation
         void delete_textures();
         
-        // manipulating the block
+        // manipulating the block - swapping also records the operation before it in the undo history
         void swap_blocks();
 
+        // undo history - every operation is recorded as the bricks it changed, undo and redo put them back
+        void undo();
+        void redo();
+        void commit_undo(); // starts recording the last operation, if that hasn't been started yet - called once a frame
+        bool poll_undo(bool wait = false); // takes a finished recording into the history - also called once a frame
+        bool undo_recording() { return undo_fence != 0 || undo_worker.joinable(); }
+        const std::string &undo_message() { return undo_skipped; } // why the last operation isn't in the history, if it isn't
+        int undo_steps() { return int(undo_stack.size()); }
+        int redo_steps() { return int(redo_stack.size()); }
+        size_t undo_memory() { return undo_bytes; }
+        size_t undo_budget = size_t(UNDO_BUDGET_MB) << 20; // bytes of host memory, the oldest steps go past this
+
 
 
 // Shapes
@@ -66,6 +115,13 @@ class GLContainer
 
 
 // GPU-side utilities
+        // region of interest - with it enabled, clear all, mask by color, box and gaussian blur, shift, and the
+        // lighting operations only change the box roi_min..roi_max (inclusive, in voxels), in place, and cost about
+        // what the box does instead of what the block does. roi_masked further restricts the utilities to the
+        // masked voxels in the box. Lighting is restricted to the lighting cells the box covers
+        bool roi_enabled = false, roi_masked = false;
+        glm::ivec3 roi_min = glm::ivec3(0), roi_max = glm::ivec3(DIM-1);
+
         // clear all
         void clear_all(bool respect_mask);
 
@@ -78,17 +134,52 @@ class GLContainer
         // mask by color
         void mask_by_color(bool r, bool g, bool b, bool a, bool l, glm::vec4 color, float l_val, float r_var, float g_var, float b_var, float a_var, float l_var);
 
+        // connected components - labels the voxels above the alpha threshold into a label volume (image unit 13, like
+        // the summed volume table), returns how many components there are. mask_component() also masks the one the
+        // seed voxel is in, a flood fill selection
+        int label_components(float alpha_threshold);
+        int mask_component(glm::ivec3 seed, float alpha_threshold);
+
+        // summed volume table (3d prefix sum) of one channel of a block, into image unit 13 - used by box blur and AO.
+        // Only the box lo..hi is summed, starting from its low corner
+        void build_summed_volume(int source, int channel, glm::ivec3 lo, glm::ivec3 hi);
+
         // box blur
         void box_blur(int radius, bool touch_alpha, bool respect_mask);
 
         // gaussian blur
         void gaussian_blur(int radius, bool touch_alpha, bool respect_mask);
 
+        // signed distance field of the voxels above an alpha threshold (negative inside), by jump flooding - kept in
+        // texture 16, and patched up in just the edited part of the block by update_distance_field()
+        void compute_distance_field(float alpha_threshold);
+        void update_distance_field();
+        bool auto_update_distance = false; // patch the distance field once a frame, whenever something has been edited
+
+        // morphology, built on the distance field - radius is in voxels, up to DISTANCE_RANGE
+        void dilate(int radius, float alpha_threshold, bool respect_mask);
+        void erode(int radius, float alpha_threshold, bool respect_mask);
+        void morphological_open(int radius, float alpha_threshold, bool respect_mask);  // erode, then dilate
+        void morphological_close(int radius, float alpha_threshold, bool respect_mask); // dilate, then erode
+
         // limiter - details tbd
         void limiter();
 
-        // shifting
+        // shifting - with virtual_shift on, a looping shift that carries the mask (mode 3) moves no data, it only
+        // adds to an offset the raycaster reads the block through. The first operation that needs the data where it
+        // appears to be (anything that edits or reads the block, lighting, undo, save) puts it there in one pass
         void shift(glm::ivec3 movement, bool loop, int mode);
+        void materialize_offset();
+        bool virtual_shift = true;
+        glm::ivec3 pending_offset() { return block_offset; }
+
+        // copy/paste - the clipboard keeps only the 8^3 bricks of the selection that have something in them. Copy
+        // takes the box lo..hi, or just its masked voxels. Paste puts the clipboard down with its low corner at
+        // offset, mirrored along its own axes and then turned by quarter turns about x, then y, then z
+        void copy(glm::ivec3 lo, glm::ivec3 hi, bool masked_only);
+        void paste(glm::ivec3 offset, glm::ivec3 quarter_turns, glm::bvec3 mirror, bool respect_mask, bool overwrite);
+        glm::ivec3 clipboard_size() { return clipboard_extent; }
+        int clipboard_bricks() { return clipboard_count; }
 
 
 
@@ -97,23 +188,48 @@ class GLContainer
         void lighting_clear(bool use_cache_level, float intensity = 0.0);
 
         // directional
-        void compute_new_directional_lighting(float theta, float phi, float initial_ray_intensity, float decay_power);
+        void compute_new_directional_lighting(float theta, float phi, float initial_ray_intensity, float decay_power, glm::vec3 color = glm::vec3(1.0));
 
         // point lighting
-        void compute_point_lighting(glm::vec3 location, float initial_intensity, float decay_power, float distance_power);
+        void compute_point_lighting(glm::vec3 location, float initial_intensity, float decay_power, float distance_power, glm::vec3 color = glm::vec3(1.0));
 
         // cone lighting
-        void compute_cone_lighting(glm::vec3 location, float theta, float phi, float cone_angle, float initial_intensity, float decay_power, float distance_power);
+        void compute_cone_lighting(glm::vec3 location, float theta, float phi, float cone_angle, float initial_intensity, float decay_power, float distance_power, glm::vec3 color = glm::vec3(1.0));
+
+        // transmittance out from a point or cone light, into the light cube (texture 13) - returns the shell spacing
+        float build_light_cube(glm::vec3 location, float decay_power, float theta, float phi, float cone_angle);
         
-        // ambient occlusion
+        // light list - lights are collected, then evaluated together in one pass by apply_light_list()
+        void add_point_light(glm::vec3 location, float initial_intensity, float decay_power, float distance_power, float range = 0.0, glm::vec3 color = glm::vec3(1.0));
+        void add_cone_light(glm::vec3 location, float theta, float phi, float cone_angle, float initial_intensity, float decay_power, float distance_power, float range = 0.0, glm::vec3 color = glm::vec3(1.0));
+        void add_directional_light(float theta, float phi, float initial_intensity, float decay_power, glm::vec3 color = glm::vec3(1.0));
+        void clear_light_list() { lights.clear(); }
+        void apply_light_list();
+        const std::vector<light_t> &light_list() { return lights; }
+
+        // ambient occlusion - the single radius version is the near scale alone
         void compute_ambient_occlusion(int radius);
+        void compute_ambient_occlusion(glm::ivec3 radii, glm::vec3 weights); // near, mid and far, blended by weight
 
         // fake GI
-        void compute_fake_GI(float factor, float sky_intensity, float thresh);
+        void compute_fake_GI(float factor, float sky_intensity, float thresh, glm::vec3 sky_color = glm::vec3(1.0));
+
+        // cone traced GI - preset 0 is fastest, 2 is best looking
+        void compute_cone_GI(int preset, float strength, float sky_intensity, glm::vec3 sky_color = glm::vec3(1.0));
 
         // mash (combine light into color buffer)
         void mash();
 
+        // relighting after edits - edits mark the box they changed, and this replays the lighting operations since
+        // the last clear, but only in the part of the block that the change can have had an effect on
+        void relight_dirty();
+        bool lighting_dirty() { return dirty; }
+        bool auto_relight = false; // relight once a frame, whenever something has been edited
+
+        // point and cone lights only light the cells near something, so they cost what the scene does instead of
+        // what the block does - what gets drawn into empty space later is lit by the next relight
+        bool sparse_lighting = true;
+
 
 // CPU-side utilities
         // functions to generate new heightmaps & buffer them to the GPU
@@ -134,9 +250,35 @@ class GLContainer
         // load
         void load(std::string filename, bool respect_mask);
 
-        // save
+        // mesh import - voxelizes an OBJ or STL file through the load buffer, returns a status message for the UI
+        std::string load_mesh(std::string filename, float scale, bool solid, bool use_mesh_color, glm::vec4 color, bool respect_mask);
+
+        // point cloud import - splats a PLY or XYZ file through the load buffer, returns a status message for the UI
+        std::string load_point_cloud(std::string filename, float scale, bool z_up, glm::vec4 color, bool respect_mask);
+
+        // save - with crop_saves on, only the box around the content is saved, and load puts it back where it was
         void save(std::string filename);
 
+        // statistics - compute_statistics() starts a reduction over the block, and poll_statistics() picks up the
+        // result once the GPU is done with it, without waiting for it unless asked to (it's called once a frame).
+        // content_bounds() waits, if the last statistics aren't of the block as it is now, at that threshold
+        void compute_statistics(float alpha_threshold);
+        bool poll_statistics(bool wait = false);
+        bool statistics_pending() { return statistics_fence != 0; }
+        bool statistics_current() { return stats.valid && stats.version == block_version; }
+        const volume_statistics &statistics() { return stats; }
+        bool content_bounds(float alpha_threshold, glm::ivec3 &lo, glm::ivec3 &hi);
+
+        // automatic cropping of saves and screenshots to the content - saves keep every voxel that isn't all zero,
+        // screenshots only need what's visible, alpha above crop_threshold
+        bool crop_saves = false, crop_screenshots = false;
+        float crop_threshold = 0.0f;
+
+        // the raycaster only marches through the box around the content - edits grow it, and with tight_bounds on,
+        // a statistics reduction brings it back in once things settle. Called once a frame
+        void update_content_box();
+        bool tight_bounds = true;
+
 
 
 
@@ -162,6 +304,124 @@ class GLContainer
         bool redraw_flag = true;
         int tex_offset = 0; //this is better than rebinding textures, it is either 0 or 1
 
+        // the light list, and the shader storage buffer it goes to the GPU in
+        std::vector<light_t> lights;
+        GLuint light_list_buffer;
+
+        // changed flag and root count for connected component labeling, a shader storage buffer at binding 1
+        GLuint components_buffer;
+
+        // brick lists - operations that only change voxels (or lighting cells) near something, or masked, or
+        // unmasked, run over a list of just those 8^3 bricks with an indirect dispatch. The classes of the bricks
+        // (binding 6) are kept till the block changes, the list and its workgroup counts are at binding 7
+        GLuint brick_flags_buffer, brick_list_buffer;
+        bool brick_flags_valid = false;
+
+        // anything that changes the block calls this - counts versions of it, for what's kept about it
+        unsigned block_version = 0;
+        void block_changed();
+
+        // the box around everything with any alpha, in voxels - min past max when the block is empty. It's exact
+        // after a reduction at threshold zero, and only ever bigger than it has to be after edits
+        glm::ivec3 content_min = glm::ivec3(0), content_max = glm::ivec3(DIM-1);
+        bool content_exact = false;
+
+        // statistics, at binding 8 - the fence is there while a reduction is in flight
+        GLuint statistics_buffer;
+        GLsync statistics_fence = 0;
+        unsigned statistics_version;
+        float statistics_threshold;
+        volume_statistics stats;
+
+        // where the box lo..hi lands in a screenshot, in pixels from the top left
+        void screen_rect(glm::ivec3 lo, glm::ivec3 hi, glm::ivec2 &min, glm::ivec2 &max);
+        void build_brick_list(GLuint near, int reach, GLuint self, int scale, glm::ivec3 lo, glm::ivec3 hi);
+        void dispatch_bricks(GLuint shader, glm::ivec3 lo, glm::ivec3 hi);
+        void dispatch_lighting_bricks(GLuint shader, int reach); // the lighting region, near anything occupied
+
+        // the clipboard - which brick of the selection is in which slot at binding 4, the slots at binding 5
+        GLuint clipboard_index_buffer, clipboard_data_buffer;
+        glm::ivec3 clipboard_extent = glm::ivec3(0);
+        int clipboard_count = 0;
+        void apply_lights(std::vector<light_t> &list);
+
+        // one recorded lighting operation - apply runs it again, restricted to the region below, and affected grows
+        // a box that was edited into the box of lighting the edit can change for this operation
+        struct lighting_op_t
+        {
+            std::function<void()> apply;
+            std::function<void(glm::ivec3 &, glm::ivec3 &)> affected;
+        };
+        std::vector<lighting_op_t> lighting_history; // everything since the last lighting clear, starting with it
+        bool replaying = false;                      // so ops aren't recorded again while they are replayed
+        void record_lighting(std::function<void()> apply, std::function<void(glm::ivec3 &, glm::ivec3 &)> affected);
+
+        // the virtual shift, 0..DIM-1 on each axis - the voxel stored at p shows up at (p + block_offset) % DIM
+        glm::ivec3 block_offset = glm::ivec3(0);
+        void shift_blocks(glm::ivec3 movement, bool loop, int mode);
+
+        // the box edited since the last relight
+        bool dirty = false;
+        glm::ivec3 dirty_min, dirty_max;
+
+        // undo history - an operation is pending from the swap that starts it till it's recorded, at the next swap
+        // or the end of the frame. The changed brick list and the deltas go through two shader storage buffers
+        bool undo_pending = false;
+        glm::ivec3 undo_min, undo_max; // the box the pending operation can have changed, in voxels
+        std::deque<undo_record> undo_stack, redo_stack;
+        size_t undo_bytes = 0;
+        std::string undo_skipped;
+        GLuint undo_list_buffer, undo_payload_buffer;
+        void apply_undo_record(undo_record &r);
+
+        // recording happens behind the frames that follow - the deltas of every changed brick are gathered into the
+        // record buffer on the GPU straight away, since the next operation writes over what they come from, then read
+        // back once the fence says they're there and compressed on the worker thread. One is in flight at a time
+        GLuint undo_record_buffer = 0;
+        size_t undo_record_capacity = 0; // in bricks - as many as the budget could keep, the list head comes first
+        size_t undo_record_head = 0;     // bytes, up to where the deltas start
+        GLsync undo_fence = 0;
+        std::thread undo_worker;
+        std::atomic<bool> undo_compressed{false};
+        const uint8_t *undo_mapped = nullptr;
+        undo_record undo_incoming;
+
+        // for operations that change only a box of the block - instead of swapping, the box is copied from the
+        // current block to the previous one, and the operation works on the current block in place. Outside of the
+        // box, the previous block is out of date, so only operations that start by swapping can use it
+        void begin_region_edit(glm::ivec3 lo, glm::ivec3 hi);
+
+        // the same for operations that only change the bricks of the list at binding 7 - just those are copied, and
+        // the undo history only looks through them, from a copy of the list at binding 9
+        void begin_brick_edit();
+        GLuint edit_list_buffer;
+        bool undo_from_list = false;
+
+        // the distance field - the threshold it was built at, the box edited since, and which image unit (13 or 22)
+        // the nearest surface voxels from the last jump flood ended up in
+        bool distance_valid = false, distance_dirty = false;
+        float distance_threshold;
+        glm::ivec3 distance_dirty_min, distance_dirty_max;
+        int distance_seeds = 13;
+        void jump_flood(glm::ivec3 lo, glm::ivec3 hi, glm::ivec3 write_lo, glm::ivec3 write_hi);
+        void morphology(bool erode, int radius, float alpha_threshold, bool respect_mask);
+        void mark_dirty(glm::vec3 min, glm::vec3 max);
+        void mark_dirty() { mark_dirty(glm::vec3(0), glm::vec3(DIM-1)); }
+
+        // the part of the lighting buffer lighting operations work on, inclusive, in lighting cells (LIGHT_SCALE
+        // voxels on a side) - all of it, except while relighting
+        glm::ivec3 region_min = glm::ivec3(0);
+        glm::ivec3 region_max = glm::ivec3(LIGHT_DIM-1);
+        void dispatch_region(GLuint shader); // sets the region uniforms, then dispatches 8x8x8 workgroups over it
+        void dispatch_region(GLuint shader, glm::ivec3 lo, glm::ivec3 hi); // same, over a box of the block
+        void lighting_region(glm::ivec3 &lo, glm::ivec3 &hi); // the region, inside of the region of interest
+
+        // region of interest helpers - the box a utility covers, setting up the blocks for it (a swap for the
+        // whole block, an in place edit that has read_lo..read_hi to read from otherwise), and the ROI_MASK define
+        void utility_box(glm::ivec3 &lo, glm::ivec3 &hi);
+        void begin_utility(glm::ivec3 read_lo, glm::ivec3 read_hi);
+        std::pair<std::string, std::string> roi_define();
+
         // display helper functions
         void display_block();
         void display_orientation_widget();
@@ -169,6 +429,7 @@ class GLContainer
 
         // init helper functions
         void compile_shaders();
+        void register_shader(LazyCShader &s, std::string path, std::vector<shader_defines> variants = {});
         void buffer_geometry();
         void load_textures();
 
@@ -181,21 +442,37 @@ class GLContainer
     //  1  - copy/paste buffer's render texture
     //  2  - main block front color buffer
     //  3  - main block back color buffer
-    //  4  - main block front mask buffer
-    //  5  - main block back mask buffer
-    //  6  - display lighting buffer
-    //  7  - lighting cache buffer
-    //  8  - copy/paste front buffer
-    //  9  - copy/paste back buffer
+    //  4  - main block front mask buffer (bit-packed, 32 voxels along x per r32ui texel)
+    //  5  - main block back mask buffer  (bit-packed, 32 voxels along x per r32ui texel)
+    //  6  - display lighting buffer (rgb, packed r11f_g11f_b10f, LIGHT_DIM on a side)
+    //  7  - lighting cache buffer  (rgb, packed r11f_g11f_b10f, LIGHT_DIM on a side)
+    //  8  - front scratch buffer (multi-pass operations, e.g. gaussian blur - the clipboard is sparse, in SSBOs)
+    //  9  - back scratch buffer  (multi-pass operations)
     //  10 - load buffer (used for load, Voxel Automata Terrain)
     //  11 - perlin noise
     //  12 - heightmap
-
-        GLuint textures[13];
+    //  13 - light cube (point and cone light transmittance, a cube map array)
+    //  14 - light list shadow atlas (transmittance for every light in the light list)
+    //  15 - cone traced GI radiance pyramid (six directional tiles along x, mipmapped)
+    //  16 - signed distance field (r16f, clamped to DISTANCE_RANGE)
+    //
+    // Image units match the texture numbers above, except for these:
+    //  13 - summed volume table / connected component labels - texture 8, bound as r32ui
+    //  14 - directional light transmittance / float scratch - texture 9, bound as r32f
+    //  15 - light cube (texture 13), for writing
+    //  16 - light list shadow atlas (texture 14), for writing
+    //  17 - rgb scratch - texture 8, bound as r11f_g11f_b10f
+    //  18 - rgb scratch - texture 9, bound as r11f_g11f_b10f
+    //  19 - radiance pyramid (texture 15), the level being built - rebound per level
+    //  20 - radiance pyramid (texture 15), the level below it
+    //  21 - signed distance field (texture 16)
+    //  22 - jump flood scratch - texture 9, bound as r32ui (texture 8 is on 13)
+
+        GLuint textures[17];
 
 
         // shows the texture containing the rendered block - workgroup is 32x32x1
-        GLuint display_compute_shader;   // raycast -> texture
+        LazyCShader display_compute_shader; // raycast -> texture
         GLuint display_shader;           // texture -> window
         GLuint display_vao;
         GLuint display_vbo;
@@ -207,37 +484,52 @@ class GLContainer
         GLuint orientation_widget_vbo;
 
 
-        // Compute Shader Handles
+        // Compute Shader Handles - these are LazyCShaders, so nothing gets compiled till it is needed
+        std::vector<LazyCShader *> compute_shaders; // all of the below, for prewarming / status queries
+
         // Shapes
-        GLuint aabb_compute;
-        GLuint cuboid_compute;
-        GLuint cylinder_compute;
-        GLuint ellipsoid_compute;
-        GLuint grid_compute;
-        GLuint heightmap_compute;
-        GLuint perlin_compute;
-        GLuint sphere_compute;
-        GLuint tube_compute;
-        GLuint triangle_compute;
+        LazyCShader aabb_compute;
+        LazyCShader cuboid_compute;
+        LazyCShader cylinder_compute;
+        LazyCShader ellipsoid_compute;
+        LazyCShader grid_compute;
+        LazyCShader heightmap_compute;
+        LazyCShader perlin_compute;
+        LazyCShader sphere_compute;
+        LazyCShader tube_compute;
+        LazyCShader triangle_compute;
 
         // GPU-side utilities
-        GLuint clear_all_compute;
-        GLuint unmask_all_compute;
-        GLuint invert_mask_compute;
-        GLuint mask_by_color_compute;
-        GLuint box_blur_compute;
-        GLuint gaussian_blur_compute; 
-        GLuint shift_compute;
-        GLuint copy_loadbuff_compute;
+        LazyCShader clear_all_compute;
+        LazyCShader unmask_all_compute;
+        LazyCShader invert_mask_compute;
+        LazyCShader mask_by_color_compute;
+        LazyCShader components_compute;
+        LazyCShader summed_volume_compute;
+        LazyCShader box_blur_compute;
+        LazyCShader gaussian_blur_compute; 
+        LazyCShader distance_field_compute;
+        LazyCShader morphology_compute;
+        LazyCShader shift_compute;
+        LazyCShader clipboard_compute;
+        LazyCShader copy_loadbuff_compute;
 
         // Lighting
-        GLuint lighting_clear_compute;
-        GLuint new_directional_lighting_compute;
-        GLuint point_lighting_compute;
-        GLuint cone_lighting_compute;
-        GLuint ambient_occlusion_compute;
-        GLuint fakeGI_compute;
-        GLuint mash_compute;
+        LazyCShader lighting_clear_compute;
+        LazyCShader new_directional_lighting_compute;
+        LazyCShader light_cube_compute;
+        LazyCShader point_lighting_compute;
+        LazyCShader cone_lighting_compute;
+        LazyCShader light_list_shadow_compute;
+        LazyCShader light_list_compute;
+        LazyCShader ambient_occlusion_compute;
+        LazyCShader fakeGI_compute;
+        LazyCShader gi_pyramid_compute;
+        LazyCShader cone_GI_compute;
+        LazyCShader mash_compute;
+        LazyCShader undo_compute;
+        LazyCShader brick_list_compute;
+        LazyCShader statistics_compute;
 };
 
 #endif
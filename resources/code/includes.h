@@ -13,6 +13,7 @@
 #include <sstream>
 #include <vector>
 #include <deque>
+#include <functional>
 #include <chrono>
 #include <ctime>
 #include <cstdint>
@@ -54,6 +55,60 @@ using std::endl;
 #include <SDL2/SDL_opengl.h>
 
 
+// configuration - defined ahead of the project headers below, since some of them (shader.h) use DIM
+#define TRIPLE_MONITOR // enable to span all three monitors
+
+// supersampling factor for main display shader
+// #define SSFACTOR 5.0   // tanks performance
+#define SSFACTOR 2.8  // this is for 8x multisampling
+// #define SSFACTOR 2.0  // this is for 4x multisampling
+// #define SSFACTOR 1.65
+// #define SSFACTOR 1.25  // small amount of multisampling
+// #define SSFACTOR 1.0  // no multisampling
+// #define SSFACTOR 0.4 // this is <1x multisampling
+
+// for the tile based rendering - needs to be a multiple of 32
+#define TILESIZE 64
+
+#define NUM_ROTATION_STEPS 1000
+
+// this sets how many texels are on an edge. Trying not to hardcode this anywhere, so that I can easily switch from 256, 512, 1024, etc
+// - keep it a multiple of 32, the masks pack 32 voxels along x into each uint
+#define DIM 512
+// #define DIM 256
+
+// the lighting buffer can be coarser than the block - 1, 2 or 4 voxels on a side per lighting cell. Light varies
+// slowly, so 2 is hard to tell apart from 1, and the lighting buffer and everything that writes it are 8x cheaper
+#define LIGHT_SCALE 2
+#define LIGHT_DIM (DIM/LIGHT_SCALE)
+
+// the point and cone lights' transmittance, by direction (faces are this many texels on a side) and by
+// distance from the light (this many shells, spread from the light out to the farthest corner of the block)
+#define LIGHT_CUBE_RES 128
+#define LIGHT_CUBE_SHELLS 256
+
+// the light list - how many lights it holds, and the resolution of each light's tile of the shadow atlas.
+// Coarser than the light cube above, since every light in the list needs its own tile at the same time
+#define LIGHT_LIST_MAX 16
+#define LIGHT_LIST_RES 64
+#define LIGHT_LIST_SHELLS 128
+
+// cone traced GI's radiance pyramid - this many texels on a side at its base level (DIM/GI_RES voxels each), with
+// six copies side by side, one per direction. Bounce light is low frequency, so this can be much coarser than
+// the lighting buffer
+#define GI_RES (DIM/8)
+
+// the signed distance field holds distances out to this many voxels either side of the surface - farther than that
+// reads as this far. Bounding it is what lets an edit be patched into the field without redoing the whole block
+#define DISTANCE_RANGE 64
+
+// undo history - how many changed bricks are compressed as one chunk (on one thread) and put back at a time, which
+// sizes the GPU-side staging buffer (UNDO_BATCH * 2112 bytes), and how much host memory the history can use by
+// default before the oldest steps are dropped - an operation over it by itself is left out of the history
+#define UNDO_BATCH 4096
+#define UNDO_BUDGET_MB 512
+
+
 //png loading library - very powerful
 #include "lodepng.h"
 
@@ -69,32 +124,25 @@ using std::endl;
 // voxel automata terrain
 #include "vat.h"
 
-// contains the OpenGL wrapper class
-#include "gpu_data.h"
+// thread pool helper for the CPU-side importers
+#include "parallel.h"
 
+// OBJ/STL mesh voxelizer
+#include "mesh.h"
 
-// pi definition
-constexpr double pi = 3.14159265358979323846;
+// PLY/XYZ point cloud splatting
+#include "pointcloud.h"
 
-#define TRIPLE_MONITOR // enable to span all three monitors
+// undo history, brick deltas and their compression
+#include "undo.h"
 
-// supersampling factor for main display shader
-// #define SSFACTOR 5.0   // tanks performance
-#define SSFACTOR 2.8  // this is for 8x multisampling
-// #define SSFACTOR 2.0  // this is for 4x multisampling
-// #define SSFACTOR 1.65
-// #define SSFACTOR 1.25  // small amount of multisampling
-// #define SSFACTOR 1.0  // no multisampling
-// #define SSFACTOR 0.4 // this is <1x multisampling
+// contains the OpenGL wrapper class
+#include "gpu_data.h"
 
-// for the tile based rendering - needs to be a multiple of 32
-#define TILESIZE 64
 
-#define NUM_ROTATION_STEPS 1000
+// pi definition
+constexpr double pi = 3.14159265358979323846;
 
-// this sets how many texels are on an edge. Trying not to hardcode this anywhere, so that I can easily switch from 256, 512, 1024, etc
-#define DIM 512
-// #define DIM 256
 
 
 
@@ -0,0 +1,622 @@
+//  ╔╦╗┌─┐┌─┐┬ ┬
+//  ║║║├┤ └─┐├─┤
+//  ╩ ╩└─┘└─┘┴ ┴
+#ifndef MESH_H
+#define MESH_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <limits>
+
+// voxelizes triangle meshes (OBJ or STL) into the RGBA8 layout of the load buffer, DIM on a side
+//   parsing, fitting the mesh to the block and building the BVH happen in the constructor - voxelize_slab()
+//   then fills DIM x DIM x depth texels at a time, so the result can be streamed to the GPU as it's produced.
+//   surface voxels are the ones whose cells overlap a triangle, solid mode also fills everything inside,
+//   by parity along rows in x. Colors come from vertex colors, material Kd and map_Kd PNG textures (OBJ),
+//   or the 15 bit facet colors some exporters write into binary STL.
+
+class mesh_voxelizer
+{
+    public:
+        // scale is how much of the block the longest side of the mesh spans, 1.0 is edge to edge
+        mesh_voxelizer(std::string filename, float scale)
+        {
+            std::string extension = filename.substr(std::min(filename.find_last_of('.'), filename.size()));
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+            if(extension == ".obj")
+                load_obj(filename);
+            else if(extension == ".stl")
+                load_stl(filename);
+            else
+                error = "unrecognized mesh format \"" + extension + "\", expected .obj or .stl";
+
+            if(error.empty() && positions.empty())
+                error = "no triangles in " + filename;
+
+            if(error.empty())
+            {
+                fit_to_block(scale);
+                build_bvh();
+            }
+        }
+
+        bool ok() { return error.empty(); }
+        size_t triangle_count() { return positions.size() / 3; }
+
+        std::string error;  // empty if everything loaded
+
+
+        // fills bytes with the texels in z = [z0, z0+depth), in the order glTexSubImage3D expects
+        void voxelize_slab(int z0, int depth, bool solid, bool use_mesh_color, glm::vec4 color, std::vector<unsigned char> &bytes)
+        {
+            bytes.assign(4 * DIM * DIM * depth, 0);
+
+            if(solid) // rows along x, filled between pairs of crossings
+            {
+                parallel_for(DIM * depth, [&](int row){
+                    int y = row % DIM, z = z0 + row / DIM;
+                    fill_row(y, z, z0, use_mesh_color, color, bytes);
+                });
+            }
+
+            // the surface pass goes on top, bricks of 8x8x8 - each one only sees the triangles that touch it
+            int bricks_x = DIM / 8, bricks_z = (depth + 7) / 8;
+            parallel_for(bricks_x * bricks_x * bricks_z, [&](int brick){
+                glm::ivec3 lo = 8 * glm::ivec3(brick % bricks_x, (brick / bricks_x) % bricks_x, brick / (bricks_x * bricks_x));
+                lo.z += z0;
+                glm::ivec3 hi = glm::min(lo + glm::ivec3(8), glm::ivec3(DIM, DIM, z0 + depth));
+                surface_brick(lo, hi, z0, use_mesh_color, color, bytes);
+            });
+        }
+
+    private:
+
+        // three entries per triangle - colors and uvs are left empty when the file doesn't have them
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> colors;
+        std::vector<glm::vec2> uvs;
+        std::vector<int> materials;     // one entry per triangle, index into mtl
+
+        struct material
+        {
+            glm::vec3 kd = glm::vec3(1.0);
+            std::vector<unsigned char> texels;  // RGBA8, from lodepng
+            unsigned width = 0, height = 0;
+        };
+        std::vector<material> mtl;
+
+        // the BVH - leaves hold count > 0 triangles starting at first, interior nodes have count == 0 and children at first, first+1
+        struct bvh_node
+        {
+            glm::vec3 lo, hi;
+            int first = 0;
+            int count = 0;
+        };
+        std::vector<bvh_node> nodes;
+        std::vector<int> order;  // triangle indices, permuted so each leaf's triangles are contiguous
+
+
+// ------------------------
+// parsing
+
+        void load_obj(std::string filename)
+        {
+            std::ifstream file(filename);
+            if(!file.is_open()) { error = "couldn't open " + filename; return; }
+
+            std::string directory = filename.substr(0, filename.find_last_of('/') + 1);
+
+            std::vector<glm::vec3> v, vc;
+            std::vector<glm::vec2> vt;
+            std::vector<std::string> material_names;
+            int current_material = -1;
+            bool any_vertex_colors = false;
+
+            // OBJ indices are 1-based, and negative ones count back from the most recent vertex
+            auto resolve = [](long i, size_t n){ return (i < 0) ? long(n) + i : i - 1; };
+
+            std::string line;
+            std::vector<std::pair<long, long>> face; // position, texcoord
+            while(std::getline(file, line))
+            {
+                const char *c = line.c_str();
+                while(*c == ' ' || *c == '\t') c++;
+
+                if(c[0] == 'v' && c[1] == ' ')
+                {
+                    char *e; glm::vec3 p, col(1.0);
+                    p.x = strtof(c + 2, &e); p.y = strtof(e, &e); p.z = strtof(e, &e);
+                    char *e2; float r = strtof(e, &e2);
+                    if(e2 != e) // "v x y z r g b" - the common vertex color extension
+                    {
+                        col.r = r; col.g = strtof(e2, &e2); col.b = strtof(e2, &e2);
+                        any_vertex_colors = true;
+                    }
+                    v.push_back(p); vc.push_back(col);
+                }
+                else if(c[0] == 'v' && c[1] == 't')
+                {
+                    char *e; glm::vec2 t;
+                    t.x = strtof(c + 2, &e); t.y = strtof(e, &e);
+                    vt.push_back(t);
+                }
+                else if(c[0] == 'f' && (c[1] == ' ' || c[1] == '\t'))
+                {
+                    face.clear();
+                    char *e = const_cast<char *>(c + 1);
+                    while(true)
+                    {
+                        char *start = e;
+                        long pi = strtol(start, &e, 10), ti = 0;
+                        if(e == start) break;
+                        if(*e == '/')
+                        {
+                            e++;
+                            if(*e != '/') ti = strtol(e, &e, 10);
+                            if(*e == '/') { e++; strtol(e, &e, 10); } // normal index, not needed
+                        }
+                        face.push_back({resolve(pi, v.size()), ti ? resolve(ti, vt.size()) : -1});
+                    }
+
+                    // polygons are triangulated as a fan
+                    for(size_t i = 1; i + 1 < face.size(); i++)
+                    {
+                        size_t corners[3] = {0, i, i + 1};
+                        bool valid = true;
+                        for(auto k : corners)
+                            valid &= (face[k].first >= 0 && face[k].first < long(v.size()));
+                        if(!valid) continue;
+
+                        for(auto k : corners)
+                        {
+                            positions.push_back(v[face[k].first]);
+                            colors.push_back(vc[face[k].first]);
+                            long t = face[k].second;
+                            uvs.push_back((t >= 0 && t < long(vt.size())) ? vt[t] : glm::vec2(0.0));
+                        }
+                        materials.push_back(current_material);
+                    }
+                }
+                else if(strncmp(c, "mtllib", 6) == 0)
+                {
+                    load_mtl(directory + trim(std::string(c + 6)), material_names);
+                }
+                else if(strncmp(c, "usemtl", 6) == 0)
+                {
+                    std::string name = trim(std::string(c + 6));
+                    auto it = std::find(material_names.begin(), material_names.end(), name);
+                    current_material = (it == material_names.end()) ? -1 : int(it - material_names.begin());
+                }
+            }
+
+            // don't carry per-vertex data around that doesn't say anything
+            if(!any_vertex_colors) colors.clear();
+            if(vt.empty()) uvs.clear();
+            if(mtl.empty()) materials.clear();
+        }
+
+        void load_mtl(std::string filename, std::vector<std::string> &names)
+        {
+            std::ifstream file(filename);
+            if(!file.is_open()) { cout << "couldn't open material library " << filename << endl; return; }
+
+            std::string directory = filename.substr(0, filename.find_last_of('/') + 1);
+            std::string line;
+            while(std::getline(file, line))
+            {
+                std::string l = trim(line);
+                if(l.compare(0, 6, "newmtl") == 0)
+                {
+                    names.push_back(trim(l.substr(6)));
+                    mtl.push_back(material());
+                }
+                else if(!mtl.empty() && l.compare(0, 3, "Kd ") == 0)
+                {
+                    char *e; const char *c = l.c_str() + 3;
+                    mtl.back().kd.r = strtof(c, &e); mtl.back().kd.g = strtof(e, &e); mtl.back().kd.b = strtof(e, &e);
+                }
+                else if(!mtl.empty() && l.compare(0, 6, "map_Kd") == 0)
+                {
+                    // options like -s or -o aren't supported, the filename is taken to be the last token
+                    std::string tex = trim(l.substr(l.find_last_of(" \t") + 1));
+                    unsigned err = lodepng::decode(mtl.back().texels, mtl.back().width, mtl.back().height, (directory + tex).c_str());
+                    if(err)
+                    {
+                        cout << "texture " << directory + tex << " not loaded (" << lodepng_error_text(err) << "), using Kd only" << endl;
+                        mtl.back().width = mtl.back().height = 0;
+                    }
+                }
+            }
+        }
+
+        void load_stl(std::string filename)
+        {
+            std::ifstream file(filename, std::ios::binary | std::ios::ate);
+            if(!file.is_open()) { error = "couldn't open " + filename; return; }
+
+            size_t size = file.tellg();
+            file.seekg(0);
+            std::vector<char> data(size);
+            file.read(data.data(), size);
+
+            // binary STL is an 80 byte header, a triangle count, and 50 bytes per triangle - ASCII files also
+            // start with "solid", so the size check is what tells them apart
+            uint32_t count = 0;
+            if(size >= 84)
+                memcpy(&count, &data[80], 4);
+
+            if(size >= 84 && size == 84 + 50 * size_t(count))
+            {
+                bool any_colors = false;
+                positions.reserve(3 * count);
+                colors.reserve(3 * count);
+                for(uint32_t i = 0; i < count; i++)
+                {
+                    const char *t = &data[84 + 50 * size_t(i)];
+                    float f[12];
+                    uint16_t attribute;
+                    memcpy(f, t, 48);
+                    memcpy(&attribute, t + 48, 2);
+
+                    // VisCAM/SolidView convention - bit 15 marks a valid 5:5:5 color
+                    glm::vec3 col(1.0);
+                    if(attribute & 0x8000)
+                    {
+                        col = glm::vec3(attribute & 31, (attribute >> 5) & 31, (attribute >> 10) & 31) / 31.0f;
+                        any_colors = true;
+                    }
+
+                    for(int k = 1; k < 4; k++)
+                    {
+                        positions.push_back(glm::vec3(f[3*k], f[3*k+1], f[3*k+2]));
+                        colors.push_back(col);
+                    }
+                }
+                if(!any_colors) colors.clear();
+            }
+            else
+            {
+                std::istringstream s(std::string(data.begin(), data.end()));
+                std::string word;
+                while(s >> word)
+                {
+                    if(word == "vertex")
+                    {
+                        glm::vec3 p;
+                        s >> p.x >> p.y >> p.z;
+                        positions.push_back(p);
+                    }
+                }
+                positions.resize(positions.size() - positions.size() % 3);
+            }
+        }
+
+        static std::string trim(std::string s)
+        {
+            size_t a = s.find_first_not_of(" \t\r\n"), b = s.find_last_not_of(" \t\r\n");
+            return (a == std::string::npos) ? std::string() : s.substr(a, b - a + 1);
+        }
+
+
+// ------------------------
+// setup
+
+        // centers the mesh in the block, scaled so the longest side spans scale * DIM voxels
+        void fit_to_block(float scale)
+        {
+            glm::vec3 lo(std::numeric_limits<float>::max()), hi(std::numeric_limits<float>::lowest());
+            for(auto &p : positions)
+            {
+                lo = glm::min(lo, p);
+                hi = glm::max(hi, p);
+            }
+
+            float extent = std::max(std::max(hi.x - lo.x, hi.y - lo.y), hi.z - lo.z);
+            float s = (extent > 0.0f) ? (scale * DIM / extent) : 1.0f;
+            glm::vec3 center = 0.5f * (lo + hi);
+
+            for(auto &p : positions)
+                p = (p - center) * s + glm::vec3(DIM / 2.0f);
+        }
+
+        void build_bvh()
+        {
+            int n = int(triangle_count());
+            order.resize(n);
+            std::vector<glm::vec3> centroids(n);
+            for(int i = 0; i < n; i++)
+            {
+                order[i] = i;
+                centroids[i] = (positions[3*i] + positions[3*i+1] + positions[3*i+2]) / 3.0f;
+            }
+
+            nodes.clear();
+            nodes.reserve(2 * (n / 4 + 1));
+            nodes.push_back(bvh_node());
+
+            // (node, first, count) - explicit stack, split at the median centroid along the longest axis
+            struct job { int node, first, count; };
+            std::vector<job> stack = {{0, 0, n}};
+            while(!stack.empty())
+            {
+                job j = stack.back();
+                stack.pop_back();
+
+                glm::vec3 lo(std::numeric_limits<float>::max()), hi(std::numeric_limits<float>::lowest());
+                glm::vec3 clo = lo, chi = hi;
+                for(int i = j.first; i < j.first + j.count; i++)
+                {
+                    int t = order[i];
+                    for(int k = 0; k < 3; k++)
+                    {
+                        lo = glm::min(lo, positions[3*t+k]);
+                        hi = glm::max(hi, positions[3*t+k]);
+                    }
+                    clo = glm::min(clo, centroids[t]);
+                    chi = glm::max(chi, centroids[t]);
+                }
+                nodes[j.node].lo = lo;
+                nodes[j.node].hi = hi;
+
+                glm::vec3 spread = chi - clo;
+                if(j.count <= 4 || (spread.x <= 0.0f && spread.y <= 0.0f && spread.z <= 0.0f))
+                {
+                    nodes[j.node].first = j.first;
+                    nodes[j.node].count = j.count;
+                    continue;
+                }
+
+                int axis = (spread.x > spread.y) ? ((spread.x > spread.z) ? 0 : 2) : ((spread.y > spread.z) ? 1 : 2);
+                int half = j.count / 2;
+                std::nth_element(order.begin() + j.first, order.begin() + j.first + half, order.begin() + j.first + j.count,
+                    [&](int a, int b){ return centroids[a][axis] < centroids[b][axis]; });
+
+                int children = int(nodes.size());
+                nodes.push_back(bvh_node());
+                nodes.push_back(bvh_node());
+                nodes[j.node].first = children;
+                nodes[j.node].count = 0;
+
+                stack.push_back({children, j.first, half});
+                stack.push_back({children + 1, j.first + half, j.count - half});
+            }
+        }
+
+
+// ------------------------
+// voxelization
+
+        // color of triangle t at barycentric coordinates b
+        glm::vec4 shade(int t, glm::vec3 b, bool use_mesh_color, glm::vec4 color)
+        {
+            if(!use_mesh_color || (colors.empty() && materials.empty()))
+                return color;
+
+            glm::vec3 c(1.0);
+            if(!colors.empty())
+                c = b.x * colors[3*t] + b.y * colors[3*t+1] + b.z * colors[3*t+2];
+
+            if(!materials.empty() && materials[t] >= 0)
+            {
+                material &m = mtl[materials[t]];
+                c *= m.kd;
+                if(m.width && !uvs.empty())
+                {
+                    glm::vec2 uv = b.x * uvs[3*t] + b.y * uvs[3*t+1] + b.z * uvs[3*t+2];
+                    uv -= glm::floor(uv); // repeat
+
+                    // OBJ texture coordinates start at the bottom left, PNG rows at the top
+                    unsigned x = std::min(unsigned(uv.x * m.width), m.width - 1);
+                    unsigned y = std::min(unsigned((1.0f - uv.y) * m.height), m.height - 1);
+                    unsigned char *texel = &m.texels[4 * (x + m.width * y)];
+                    c *= glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+                }
+            }
+            return glm::vec4(c, 1.0);
+        }
+
+        static void store(std::vector<unsigned char> &bytes, int index, glm::vec4 c)
+        {
+            c = glm::clamp(c, glm::vec4(0.0), glm::vec4(1.0));
+            for(int k = 0; k < 4; k++)
+                bytes[4 * index + k] = static_cast<unsigned char>(c[k] * 255);
+        }
+
+        // solid fill for one row along x - crossings are sorted, and the cells between each entry/exit pair are filled
+        void fill_row(int y, int z, int z0, bool use_mesh_color, glm::vec4 color, std::vector<unsigned char> &bytes)
+        {
+            // offset from the cell center by a little bit, so rows don't pass exactly through shared edges
+            float ry = y + 0.5f + 1.3e-4f, rz = z + 0.5f + 2.9e-4f;
+
+            struct crossing { float x; int t; glm::vec3 b; };
+            std::vector<crossing> hits;
+
+            int stack[64], sp = 0;
+            stack[sp++] = 0;
+            while(sp)
+            {
+                bvh_node &n = nodes[stack[--sp]];
+                if(ry < n.lo.y || ry > n.hi.y || rz < n.lo.z || rz > n.hi.z)
+                    continue;
+
+                if(n.count == 0)
+                {
+                    stack[sp++] = n.first;
+                    stack[sp++] = n.first + 1;
+                    continue;
+                }
+
+                for(int i = n.first; i < n.first + n.count; i++)
+                {
+                    int t = order[i];
+                    glm::vec3 a = positions[3*t], b = positions[3*t+1], c = positions[3*t+2];
+
+                    // 2d point in triangle, in the yz plane
+                    float d = (b.y - a.y) * (c.z - a.z) - (c.y - a.y) * (b.z - a.z);
+                    if(d == 0.0f) continue;
+                    float w1 = ((ry - a.y) * (c.z - a.z) - (c.y - a.y) * (rz - a.z)) / d;
+                    float w2 = ((b.y - a.y) * (rz - a.z) - (ry - a.y) * (b.z - a.z)) / d;
+                    float w0 = 1.0f - w1 - w2;
+                    if(w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+                    hits.push_back({w0 * a.x + w1 * b.x + w2 * c.x, t, glm::vec3(w0, w1, w2)});
+                }
+            }
+
+            std::sort(hits.begin(), hits.end(), [](const crossing &l, const crossing &r){ return l.x < r.x; });
+
+            int base = DIM * (y + DIM * (z - z0));
+            for(size_t i = 0; i + 1 < hits.size(); i += 2)
+            {
+                // interior cells take the color of the surface where the row entered
+                glm::vec4 c = shade(hits[i].t, hits[i].b, use_mesh_color, color);
+                int x0 = std::max(0, int(std::ceil(hits[i].x - 0.5f)));
+                int x1 = std::min(DIM - 1, int(std::floor(hits[i+1].x - 0.5f)));
+                for(int x = x0; x <= x1; x++)
+                    store(bytes, base + x, c);
+            }
+        }
+
+        // every cell in [lo, hi) that overlaps a triangle takes the color of the nearest point on the closest one
+        void surface_brick(glm::ivec3 lo, glm::ivec3 hi, int z0, bool use_mesh_color, glm::vec4 color, std::vector<unsigned char> &bytes)
+        {
+            glm::vec3 blo(lo), bhi(hi);
+            float best[512];
+            std::fill(best, best + 512, std::numeric_limits<float>::max());
+
+            int stack[64], sp = 0;
+            stack[sp++] = 0;
+            while(sp)
+            {
+                bvh_node &n = nodes[stack[--sp]];
+                if(glm::any(glm::lessThan(n.hi, blo)) || glm::any(glm::greaterThan(n.lo, bhi)))
+                    continue;
+
+                if(n.count == 0)
+                {
+                    stack[sp++] = n.first;
+                    stack[sp++] = n.first + 1;
+                    continue;
+                }
+
+                for(int i = n.first; i < n.first + n.count; i++)
+                {
+                    int t = order[i];
+                    glm::vec3 a = positions[3*t], b = positions[3*t+1], c = positions[3*t+2];
+
+                    // only the cells under the triangle's bounding box need testing
+                    glm::ivec3 clo = glm::max(lo, glm::ivec3(glm::floor(glm::min(glm::min(a, b), c))));
+                    glm::ivec3 chi = glm::min(hi - glm::ivec3(1), glm::ivec3(glm::floor(glm::max(glm::max(a, b), c))));
+
+                    for(int z = clo.z; z <= chi.z; z++)
+                    for(int y = clo.y; y <= chi.y; y++)
+                    for(int x = clo.x; x <= chi.x; x++)
+                    {
+                        glm::vec3 center = glm::vec3(x, y, z) + glm::vec3(0.5);
+                        if(!triangle_box_overlap(center, a, b, c))
+                            continue;
+
+                        glm::vec3 bary;
+                        float d = closest_point(center, a, b, c, bary);
+                        int local = (x - lo.x) + 8 * ((y - lo.y) + 8 * (z - lo.z));
+                        if(d < best[local])
+                        {
+                            best[local] = d;
+                            store(bytes, x + DIM * (y + DIM * (z - z0)), shade(t, bary, use_mesh_color, color));
+                        }
+                    }
+                }
+            }
+        }
+
+        // separating axis test between a triangle and the unit cell around center - Akenine-Möller
+        static bool triangle_box_overlap(glm::vec3 center, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+        {
+            const float h = 0.5f;
+            glm::vec3 v0 = a - center, v1 = b - center, v2 = c - center;
+            glm::vec3 e[3] = {v1 - v0, v2 - v1, v0 - v2};
+
+            // the nine edge cross products
+            for(int i = 0; i < 3; i++)
+            {
+                for(int k = 0; k < 3; k++)
+                {
+                    glm::vec3 axis(0.0);
+                    axis[(k + 1) % 3] = -e[i][(k + 2) % 3];
+                    axis[(k + 2) % 3] =  e[i][(k + 1) % 3];
+
+                    float p0 = glm::dot(axis, v0), p1 = glm::dot(axis, v1), p2 = glm::dot(axis, v2);
+                    float r = h * (std::abs(axis.x) + std::abs(axis.y) + std::abs(axis.z));
+                    if(std::min(p0, std::min(p1, p2)) > r || std::max(p0, std::max(p1, p2)) < -r)
+                        return false;
+                }
+            }
+
+            // the box face normals
+            for(int k = 0; k < 3; k++)
+                if(std::min(v0[k], std::min(v1[k], v2[k])) > h || std::max(v0[k], std::max(v1[k], v2[k])) < -h)
+                    return false;
+
+            // the triangle's plane
+            glm::vec3 normal = glm::cross(e[0], e[1]);
+            float r = h * (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+            return std::abs(glm::dot(normal, v0)) <= r;
+        }
+
+        // squared distance from p to triangle abc, with the barycentric coordinates of the closest point - Ericson
+        static float closest_point(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 &bary)
+        {
+            glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+            float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+            if(d1 <= 0.0f && d2 <= 0.0f) { bary = glm::vec3(1, 0, 0); return glm::dot(ap, ap); }
+
+            glm::vec3 bp = p - b;
+            float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+            if(d3 >= 0.0f && d4 <= d3) { bary = glm::vec3(0, 1, 0); return glm::dot(bp, bp); }
+
+            float vc = d1 * d4 - d3 * d2;
+            if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            {
+                float v = d1 / (d1 - d3);
+                bary = glm::vec3(1.0f - v, v, 0.0f);
+            }
+            else
+            {
+                glm::vec3 cp = p - c;
+                float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+                if(d6 >= 0.0f && d5 <= d6) { bary = glm::vec3(0, 0, 1); return glm::dot(cp, cp); }
+
+                float vb = d5 * d2 - d1 * d6;
+                float va = d3 * d6 - d5 * d4;
+                if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+                {
+                    float w = d2 / (d2 - d6);
+                    bary = glm::vec3(1.0f - w, 0.0f, w);
+                }
+                else if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+                {
+                    float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+                    bary = glm::vec3(0.0f, 1.0f - w, w);
+                }
+                else
+                {
+                    float denom = 1.0f / (va + vb + vc);
+                    float v = vb * denom, w = vc * denom;
+                    bary = glm::vec3(1.0f - v - w, v, w);
+                }
+            }
+
+            glm::vec3 q = bary.x * a + bary.y * b + bary.z * c;
+            return glm::dot(p - q, p - q);
+        }
+};
+
+#endif
@@ -0,0 +1,29 @@
+//  ╔═╗┌─┐┬─┐┌─┐┬  ┬  ┌─┐┬
+//  ╠═╝├─┤├┬┘├─┤│  │  ├┤ │
+//  ╩  ┴ ┴┴└─┴ ┴┴─┘┴─┘└─┘┴─┘
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// splits [0, count) across all hardware threads - work items are handed out one at a time from a shared
+// counter, so uneven items (bricks with lots of triangles, chunks of a file) still balance out.
+// used by the CPU-side importers (mesh.h, pointcloud.h)
+inline void parallel_for(int count, std::function<void(int)> f)
+{
+    std::atomic<int> next(0);
+    auto worker = [&](){ for(int i = next++; i < count; i = next++) f(i); };
+
+    std::vector<std::thread> threads;
+    unsigned n = std::max(1u, std::thread::hardware_concurrency());
+    for(unsigned i = 1; i < n; i++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for(auto &t : threads)
+        t.join();
+}
+
+#endif
@@ -0,0 +1,511 @@
+//  ╔═╗┌─┐┬┌┐┌┌┬┐  ╔═╗┬  ┌─┐┬ ┬┌┬┐
+//  ╠═╝│ │││││ │   ║  │  │ ││ │ ││
+//  ╩  └─┘┴┘└┘ ┴   ╚═╝┴─┘└─┘└─┘─┴┘
+#ifndef POINTCLOUD_H
+#define POINTCLOUD_H
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <limits>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// splats point clouds (PLY, ascii or binary little endian, and XYZ text) into the RGBA8 layout of the load buffer
+//   the file is memory mapped and cut into chunks that worker threads pull from, nothing is copied out of it.
+//   the block is built a z-slab at a time: accumulate() makes one pass over the file and bins every point that
+//   lands in the slab, resolve() turns that into averaged colors - so memory use depends on the slab depth,
+//   not on the number of points. Each voxel is a single 64-bit word, 16 bits each of red, green and blue sums
+//   plus a 16 bit count, updated with compare and swap. Once a sum would overflow the voxel stops taking
+//   samples, by then (256+ points) the average has settled anyway.
+
+class point_cloud_splatter
+{
+    public:
+        // scale is how much of the block the longest side of the cloud spans, z_up rotates scans with z as the vertical
+        point_cloud_splatter(std::string filename, float scale, bool z_up) : up_is_z(z_up)
+        {
+            fd = open(filename.c_str(), O_RDONLY);
+            struct stat st;
+            if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+            {
+                error = "couldn't open " + filename;
+                return;
+            }
+
+            size = st.st_size;
+            void *m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(m == MAP_FAILED)
+            {
+                error = "couldn't map " + filename;
+                return;
+            }
+            data = static_cast<const char *>(m);
+            madvise(m, size, MADV_SEQUENTIAL);
+
+            std::string extension = filename.substr(std::min(filename.find_last_of('.'), filename.size()));
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+            if(extension == ".ply")
+                parse_ply_header();
+            else if(extension == ".xyz" || extension == ".txt" || extension == ".pts")
+                parse_xyz_header();
+            else
+                error = "unrecognized point cloud format \"" + extension + "\", expected .ply or .xyz";
+
+            if(error.empty())
+            {
+                make_chunks();
+                fit_to_block(scale);
+                if(count == 0)
+                    error = "no points in " + filename;
+            }
+        }
+
+        ~point_cloud_splatter()
+        {
+            if(data)
+                munmap(const_cast<char *>(data), size);
+            if(fd >= 0)
+                close(fd);
+        }
+
+        bool ok() { return error.empty(); }
+        size_t point_count() { return count; }
+        bool has_color() { return color_columns; }
+
+        std::string error;  // empty if everything loaded
+
+        // z range of the block that actually has points in it, so empty slabs can skip the pass over the file
+        int zmin = 0, zmax = DIM - 1;
+
+
+        // bins every point in z = [z0, z0+depth) - one pass over the whole file
+        void accumulate(int z0, int depth)
+        {
+            slab_z0 = z0;
+            slab_depth = depth;
+
+            size_t n = size_t(DIM) * DIM * depth;
+            if(accum_size < n)
+            {
+                accum.reset(new std::atomic<uint64_t>[n]);
+                accum_size = n;
+            }
+            parallel_for(DIM * depth, [&](int row){
+                for(size_t i = size_t(row) * DIM; i < size_t(row + 1) * DIM; i++)
+                    accum[i].store(0, std::memory_order_relaxed);
+            });
+
+            parallel_for(int(chunks.size()), [&](int c){
+                for_each_point(c, [&](glm::vec3 p, glm::vec3 rgb){
+                    glm::ivec3 v = glm::ivec3(glm::floor(to_block(p)));
+                    if(glm::any(glm::lessThan(v, glm::ivec3(0))) || v.x >= DIM || v.y >= DIM || v.z < z0 || v.z >= z0 + depth)
+                        return;
+                    add(accum[v.x + DIM * (v.y + size_t(DIM) * (v.z - z0))], glm::clamp(rgb, glm::vec3(0.0), glm::vec3(255.0)));
+                });
+            });
+        }
+
+        // averaged colors for slices [z, z+slices) of the slab last accumulated - color is used where the file has none
+        void resolve(int z, int slices, glm::vec4 color, std::vector<unsigned char> &bytes)
+        {
+            bytes.assign(4 * DIM * DIM * size_t(slices), 0);
+            size_t base = size_t(DIM) * DIM * (z - slab_z0);
+
+            parallel_for(DIM * slices, [&](int row){
+                for(size_t i = size_t(row) * DIM; i < size_t(row + 1) * DIM; i++)
+                {
+                    uint64_t word = accum[base + i].load(std::memory_order_relaxed);
+                    uint64_t samples = word >> 48;
+                    if(samples == 0)
+                        continue;
+
+                    if(color_columns)
+                    {
+                        bytes[4*i+0] = static_cast<unsigned char>((word & 0xFFFF) / samples);
+                        bytes[4*i+1] = static_cast<unsigned char>(((word >> 16) & 0xFFFF) / samples);
+                        bytes[4*i+2] = static_cast<unsigned char>(((word >> 32) & 0xFFFF) / samples);
+                    }
+                    else
+                    {
+                        bytes[4*i+0] = static_cast<unsigned char>(color.r * 255);
+                        bytes[4*i+1] = static_cast<unsigned char>(color.g * 255);
+                        bytes[4*i+2] = static_cast<unsigned char>(color.b * 255);
+                    }
+                    bytes[4*i+3] = static_cast<unsigned char>(color.a * 255);
+                }
+            });
+        }
+
+    private:
+
+        // the mapped file
+        int fd = -1;
+        const char *data = nullptr;
+        size_t size = 0;
+
+        enum { XYZ, PLY_ASCII, PLY_BINARY } format = XYZ;
+        size_t body_begin = 0, body_end = 0;   // byte range holding the points
+        size_t count = 0;
+        bool up_is_z = false;
+
+        // where x, y, z, r, g, b live in a point - a byte offset for binary PLY, a column index for text
+        int field[6] = {-1, -1, -1, -1, -1, -1};
+        char field_type[6] = {'f', 'f', 'f', 'B', 'B', 'B'};  // binary PLY types, see read_binary()
+        float color_scale = 1.0f;   // brings the file's colors to [0, 255]
+        bool color_columns = false;
+        size_t stride = 0;          // bytes per point, binary PLY
+        int columns = 0;            // values per point, ascii PLY
+
+        std::vector<std::pair<size_t, size_t>> chunks;
+
+        // mapping from file coordinates to voxel coordinates
+        glm::vec3 center = glm::vec3(0.0);
+        float s = 1.0f;
+
+        // the accumulation buffer for the current slab
+        std::unique_ptr<std::atomic<uint64_t>[]> accum;
+        size_t accum_size = 0;
+        int slab_z0 = 0, slab_depth = 0;
+
+
+// ------------------------
+// headers
+
+        // reads one line out of the mapped file starting at pos, and moves pos past it
+        std::string next_line(size_t &pos)
+        {
+            size_t end = pos;
+            while(end < size && data[end] != '\n') end++;
+            std::string l(data + pos, end - pos);
+            if(!l.empty() && l.back() == '\r') l.pop_back();
+            pos = std::min(end + 1, size);
+            return l;
+        }
+
+        void parse_ply_header()
+        {
+            size_t pos = 0;
+            if(next_line(pos) != "ply") { error = "missing ply magic number"; return; }
+
+            std::string element;
+            bool vertex_seen = false;
+            size_t offset = 0;
+            int column = 0;
+
+            while(pos < size)
+            {
+                std::string l = next_line(pos);
+                std::istringstream words(l);
+                std::string keyword;
+                words >> keyword;
+
+                if(keyword == "format")
+                {
+                    std::string f;
+                    words >> f;
+                    if(f == "ascii") format = PLY_ASCII;
+                    else if(f == "binary_little_endian") format = PLY_BINARY;
+                    else { error = "unsupported ply format " + f; return; }
+                }
+                else if(keyword == "element")
+                {
+                    size_t n;
+                    words >> element >> n;
+                    if(element == "vertex")
+                        count = n;
+                    else if(!vertex_seen)
+                    {
+                        error = "ply files with elements ahead of the vertices aren't supported";
+                        return;
+                    }
+                    vertex_seen |= (element == "vertex");
+                }
+                else if(keyword == "property" && element == "vertex")
+                {
+                    std::string type, name;
+                    words >> type >> name;
+                    if(type == "list") { error = "list properties on ply vertices aren't supported"; return; }
+
+                    char code; size_t bytes;
+                    if(!ply_type(type, code, bytes)) { error = "unknown ply type " + type; return; }
+
+                    int which = -1;
+                    if(name == "x") which = 0;
+                    else if(name == "y") which = 1;
+                    else if(name == "z") which = 2;
+                    else if(name == "red"   || name == "r" || name == "diffuse_red")   which = 3;
+                    else if(name == "green" || name == "g" || name == "diffuse_green") which = 4;
+                    else if(name == "blue"  || name == "b" || name == "diffuse_blue")  which = 5;
+
+                    if(which >= 0)
+                    {
+                        field[which] = (format == PLY_BINARY) ? int(offset) : column;
+                        field_type[which] = code;
+                        if(which >= 3) // 8 bit colors as they are, 16 bit ones scaled down, floats scaled up
+                            color_scale = (code == 'B') ? 1.0f : (code == 'H') ? 1.0f / 257.0f : (code == 'f' || code == 'd') ? 255.0f : 1.0f;
+                    }
+                    offset += bytes;
+                    column++;
+                }
+                else if(keyword == "end_header")
+                {
+                    break;
+                }
+            }
+
+            if(field[0] < 0 || field[1] < 0 || field[2] < 0) { error = "ply vertices need x, y and z"; return; }
+            color_columns = (field[3] >= 0 && field[4] >= 0 && field[5] >= 0);
+            stride = offset;
+            columns = column;
+            body_begin = pos;
+
+            if(format == PLY_BINARY)
+            {
+                body_end = std::min(size, body_begin + count * stride);
+                count = (body_end - body_begin) / stride;
+            }
+            else
+            {
+                // the vertex lines end wherever the count'th newline is, anything after that is faces etc
+                body_end = body_begin;
+                for(size_t i = 0; i < count && body_end < size; i++)
+                {
+                    const void *nl = memchr(data + body_end, '\n', size - body_end);
+                    body_end = nl ? (static_cast<const char *>(nl) - data) + 1 : size;
+                }
+            }
+        }
+
+        void parse_xyz_header()
+        {
+            format = XYZ;
+            body_begin = 0;
+            body_end = size;
+
+            // the first line with numbers on it says how many columns there are - x y z, x y z r g b, or
+            // x y z intensity r g b as in .pts files
+            size_t pos = 0;
+            while(pos < size)
+            {
+                std::string l = next_line(pos);
+                std::istringstream values(l);
+                std::vector<float> v;
+                float f;
+                while(values >> f)
+                    v.push_back(f);
+                if(v.size() < 3)
+                    continue;
+
+                columns = int(v.size());
+                field[0] = 0; field[1] = 1; field[2] = 2;
+                if(columns >= 6)
+                {
+                    int first = (columns >= 7) ? 4 : 3;
+                    field[3] = first; field[4] = first + 1; field[5] = first + 2;
+                    color_columns = true;
+                }
+                break;
+            }
+            if(columns < 3)
+                error = "no points found in the xyz file";
+
+            // colors are either 0-255 or 0-1, figured out during the bounds pass
+        }
+
+        static bool ply_type(std::string t, char &code, size_t &bytes)
+        {
+            if(t == "char"   || t == "int8")    { code = 'b'; bytes = 1; return true; }
+            if(t == "uchar"  || t == "uint8")   { code = 'B'; bytes = 1; return true; }
+            if(t == "short"  || t == "int16")   { code = 'h'; bytes = 2; return true; }
+            if(t == "ushort" || t == "uint16")  { code = 'H'; bytes = 2; return true; }
+            if(t == "int"    || t == "int32")   { code = 'i'; bytes = 4; return true; }
+            if(t == "uint"   || t == "uint32")  { code = 'I'; bytes = 4; return true; }
+            if(t == "float"  || t == "float32") { code = 'f'; bytes = 4; return true; }
+            if(t == "double" || t == "float64") { code = 'd'; bytes = 8; return true; }
+            return false;
+        }
+
+        static double read_binary(const char *p, char code)
+        {
+            switch(code)
+            {
+                case 'b': { int8_t v;   memcpy(&v, p, 1); return v; }
+                case 'B': { uint8_t v;  memcpy(&v, p, 1); return v; }
+                case 'h': { int16_t v;  memcpy(&v, p, 2); return v; }
+                case 'H': { uint16_t v; memcpy(&v, p, 2); return v; }
+                case 'i': { int32_t v;  memcpy(&v, p, 4); return v; }
+                case 'I': { uint32_t v; memcpy(&v, p, 4); return v; }
+                case 'f': { float v;    memcpy(&v, p, 4); return v; }
+                case 'd': { double v;   memcpy(&v, p, 8); return v; }
+                default: return 0.0;
+            }
+        }
+
+
+// ------------------------
+// traversal
+
+        // cuts the body into ~8MB pieces - on line boundaries for text, on point boundaries for binary
+        void make_chunks()
+        {
+            const size_t target = size_t(8) << 20;
+            chunks.clear();
+
+            if(format == PLY_BINARY)
+            {
+                size_t per_chunk = std::max(size_t(1), target / stride) * stride;
+                for(size_t b = body_begin; b < body_end; b += per_chunk)
+                    chunks.push_back({b, std::min(body_end, b + per_chunk)});
+                return;
+            }
+
+            size_t b = body_begin;
+            while(b < body_end)
+            {
+                size_t e = std::min(body_end, b + target);
+                const void *nl = (e < body_end) ? memchr(data + e, '\n', body_end - e) : nullptr;
+                e = nl ? (static_cast<const char *>(nl) - data) + 1 : body_end;
+                chunks.push_back({b, e});
+                b = e;
+            }
+        }
+
+        // calls f(position, color in [0, 255]) for every point in chunk c
+        template<typename F> void for_each_point(int c, F f)
+        {
+            const char *p = data + chunks[c].first, *end = data + chunks[c].second;
+
+            if(format == PLY_BINARY)
+            {
+                for(; p + stride <= end; p += stride)
+                {
+                    glm::vec3 pos(read_binary(p + field[0], field_type[0]), read_binary(p + field[1], field_type[1]), read_binary(p + field[2], field_type[2]));
+                    glm::vec3 rgb(255.0f);
+                    if(color_columns)
+                        rgb = color_scale * glm::vec3(read_binary(p + field[3], field_type[3]), read_binary(p + field[4], field_type[4]), read_binary(p + field[5], field_type[5]));
+                    f(orient(pos), rgb);
+                }
+                return;
+            }
+
+            // text - one point per line. The mapping isn't NUL terminated, so each line is parsed out of a terminated
+            // copy - strtof could run off the end of the file otherwise. Past the first 1023 characters is ignored
+            float v[16];
+            char line[1024];
+            while(p < end)
+            {
+                const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+                if(!eol) eol = end;
+
+                size_t length = std::min(size_t(eol - p), sizeof(line) - 1);
+                memcpy(line, p, length);
+                line[length] = '\0';
+
+                int n = 0;
+                const char *q = line;
+                while(n < 16)
+                {
+                    char *e;
+                    float x = strtof(q, &e);
+                    if(e == q) break;
+                    v[n++] = x;
+                    q = e;
+                }
+                p = eol + 1;
+
+                if(n < 3 || n < columns) // comments, blank lines, anything short
+                    continue;
+
+                glm::vec3 rgb(255.0f);
+                if(color_columns)
+                    rgb = color_scale * glm::vec3(v[field[3]], v[field[4]], v[field[5]]);
+                f(orient(glm::vec3(v[field[0]], v[field[1]], v[field[2]])), rgb);
+            }
+        }
+
+        // scans put z up, the block puts y up
+        glm::vec3 orient(glm::vec3 p)
+        {
+            return up_is_z ? glm::vec3(p.x, p.z, -p.y) : p;
+        }
+
+        glm::vec3 to_block(glm::vec3 p)
+        {
+            return (p - center) * s + glm::vec3(DIM / 2.0f);
+        }
+
+        // one parallel pass for the bounds (and the point count / color range for text formats), then
+        // centers the cloud in the block with the longest side spanning scale * DIM voxels
+        void fit_to_block(float scale)
+        {
+            struct partial { glm::vec3 lo, hi; size_t n = 0; float max_color = 0.0f; };
+            std::vector<partial> partials(chunks.size());
+
+            parallel_for(int(chunks.size()), [&](int c){
+                partial r;
+                r.lo = glm::vec3(std::numeric_limits<float>::max());
+                r.hi = glm::vec3(std::numeric_limits<float>::lowest());
+                for_each_point(c, [&](glm::vec3 p, glm::vec3 rgb){
+                    r.lo = glm::min(r.lo, p);
+                    r.hi = glm::max(r.hi, p);
+                    r.max_color = std::max(r.max_color, std::max(rgb.r, std::max(rgb.g, rgb.b)));
+                    r.n++;
+                });
+                partials[c] = r;
+            });
+
+            glm::vec3 lo(std::numeric_limits<float>::max()), hi(std::numeric_limits<float>::lowest());
+            float max_color = 0.0f;
+            count = 0;
+            for(auto &r : partials)
+            {
+                if(!r.n) continue;
+                lo = glm::min(lo, r.lo);
+                hi = glm::max(hi, r.hi);
+                max_color = std::max(max_color, r.max_color);
+                count += r.n;
+            }
+            if(!count)
+                return;
+
+            // text colors in [0, 1] get scaled up
+            if(format == XYZ && color_columns && max_color <= 1.0f)
+                color_scale = 255.0f;
+
+            float extent = std::max(std::max(hi.x - lo.x, hi.y - lo.y), hi.z - lo.z);
+            s = (extent > 0.0f) ? (scale * DIM / extent) : 1.0f;
+            center = 0.5f * (lo + hi);
+
+            zmin = std::max(0, int(std::floor(to_block(lo).z)));
+            zmax = std::min(DIM - 1, int(std::floor(to_block(hi).z)));
+        }
+
+        static void add(std::atomic<uint64_t> &voxel, glm::vec3 rgb)
+        {
+            uint64_t r = uint64_t(rgb.r), g = uint64_t(rgb.g), b = uint64_t(rgb.b);
+            uint64_t increment = r | (g << 16) | (b << 32) | (uint64_t(1) << 48);
+
+            uint64_t old = voxel.load(std::memory_order_relaxed);
+            do
+            {
+                // saturated - the voxel keeps the average it has
+                if((old >> 48) == 0xFFFF || (old & 0xFFFF) + r > 0xFFFF || ((old >> 16) & 0xFFFF) + g > 0xFFFF || ((old >> 32) & 0xFFFF) + b > 0xFFFF)
+                    return;
+            }
+            while(!voxel.compare_exchange_weak(old, old + increment, std::memory_order_relaxed));
+        }
+};
+
+#endif
@@ -17,6 +17,10 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <map>
+#include <memory>
+#include <set>
+#include <functional>
 
 using std::cin;
 using std::cout;
@@ -25,6 +29,129 @@ using std::cerr;
 using std::flush;
 using std::endl;
 
+// list of NAME, VALUE pairs that get injected as #defines when a shader is preprocessed
+typedef std::vector<std::pair<std::string, std::string>> shader_defines;
+
+// reads a shader source file and runs the small preprocessor that GLSL doesn't have:
+//   - #include "file" is replaced with the contents of file, relative to the including file - each file once
+//   - DIM, LIGHT_SCALE and anything in defines are injected as #defines, directly after the #version line
+// #line directives carry a source string number for each file, so a compile error reads as 'number(line)' -
+// files gets the path for each number, 0 being the top level file, for print_shader_files() to show alongside.
+// Includes inside /* */ comments are skipped, but this doesn't know about #if - an include in a section that's
+// compiled out still gets pulled in (harmlessly, since it lands inside the same section), and counts as included
+inline std::string preprocess_shader( std::string path, const shader_defines &defines = {}, std::vector<std::string> *files = nullptr )
+{
+    std::set<std::string> included;
+    std::vector<std::string> numbered;
+    std::stringstream out;
+
+    // recursive lambda, depth-limited in case of an include cycle that slips past the include-once check
+    std::function<void(std::string, int)> process = [&]( std::string p, int depth )
+    {
+        if( depth > 16 || !included.insert(p).second )
+            return;
+
+        std::ifstream File( p );
+        if( !File.is_open( ) )
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << p << std::endl;
+            return;
+        }
+
+        int number = int( numbered.size( ) );
+        numbered.push_back( p );
+
+        std::string directory = p.substr( 0, p.find_last_of( '/' ) + 1 );
+        std::string line;
+        int line_number = 0;
+        bool in_comment = false; // inside a /* */ block, as of the start of this line
+
+        while( std::getline( File, line ) )
+        {
+            line_number++;
+            std::string trimmed = line.substr( std::min( line.find_first_not_of( " \t" ), line.size( ) ) );
+            bool commented = in_comment;
+
+            // carry the comment state on to the next line - a // ends the line, unless it's inside a block
+            for( size_t i = 0; i + 1 < line.size( ); i++ )
+            {
+                if( !in_comment && line[i] == '/' && line[i + 1] == '/' )
+                    break;
+                if( !in_comment && line[i] == '/' && line[i + 1] == '*' )
+                    in_comment = true, i++;
+                else if( in_comment && line[i] == '*' && line[i + 1] == '/' )
+                    in_comment = false, i++;
+            }
+
+            if( !commented && trimmed.rfind( "#include", 0 ) == 0 )
+            {
+                size_t open = trimmed.find( '"' ), close = trimmed.find( '"', open + 1 );
+                if( open == std::string::npos || close == std::string::npos )
+                {
+                    std::cout << "ERROR::SHADER::BAD_INCLUDE " << p << ":" << line_number << std::endl;
+                    continue;
+                }
+                out << "#line 1 " << numbered.size( ) << "\n";
+                process( directory + trimmed.substr( open + 1, close - open - 1 ), depth + 1 );
+                out << "#line " << line_number + 1 << " " << number << "\n";
+            }
+            else if( depth == 0 && trimmed.rfind( "#version", 0 ) == 0 )
+            {
+                out << line << "\n";
+
+                bool dim_given = false, light_scale_given = false;
+                for( auto &d : defines )
+                {
+                    out << "#define " << d.first << " " << d.second << "\n";
+                    dim_given |= ( d.first == "DIM" );
+                    light_scale_given |= ( d.first == "LIGHT_SCALE" );
+                }
+                if( !dim_given )
+                    out << "#define DIM " << DIM << "\n";
+                if( !light_scale_given )
+                    out << "#define LIGHT_SCALE " << LIGHT_SCALE << "\n";
+
+                out << "#line " << line_number + 1 << " " << number << "\n";
+            }
+            else
+            {
+                out << line << "\n";
+            }
+        }
+    };
+
+    process( path, 0 );
+    if( files )
+        *files = numbered;
+    return out.str( );
+}
+
+// the source string numbers in a compile error, and the files they are
+inline void print_shader_files( const std::vector<std::string> &files )
+{
+    for( size_t i = 0; i < files.size( ); i++ )
+        std::cout << "  " << i << ": " << files[i] << std::endl;
+}
+
+// every combination of the listed values, e.g. {{"DRAW",{"0","1"}},{"MASK",{"0","1"}}} gives four sets of defines
+inline std::vector<shader_defines> shader_define_combinations( std::vector<std::pair<std::string, std::vector<std::string>>> options )
+{
+    std::vector<shader_defines> result = { shader_defines( ) };
+    for( auto &o : options )
+    {
+        std::vector<shader_defines> next;
+        for( auto &partial : result )
+            for( auto &value : o.second )
+            {
+                next.push_back( partial );
+                next.back( ).push_back( { o.first, value } );
+            }
+        result = next;
+    }
+    return result;
+}
+
+
 class Shader
 {
   public:
@@ -34,33 +161,10 @@ class Shader
     {
 
         // 1. Retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensures ifstream objects can throw exceptions:
-        vShaderFile.exceptions ( std::ifstream::badbit );
-        fShaderFile.exceptions ( std::ifstream::badbit );
-        try
-        {
-            // Open files
-            vShaderFile.open( vertexPath );
-            fShaderFile.open( fragmentPath );
-            std::stringstream vShaderStream, fShaderStream;
-            // Read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf( );
-            fShaderStream << fShaderFile.rdbuf( );
-            // close file handlers
-            vShaderFile.close( );
-            fShaderFile.close( );
-            // Convert stream into string
-            vertexCode = vShaderStream.str( );
-            fragmentCode = fShaderStream.str( );
-        }
-        catch ( std::ifstream::failure &e )
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
+        //    (this goes through the preprocessor, so #include works here too)
+        std::vector<std::string> vertexFiles, fragmentFiles;
+        std::string vertexCode = preprocess_shader( vertexPath, {}, &vertexFiles );
+        std::string fragmentCode = preprocess_shader( fragmentPath, {}, &fragmentFiles );
 
 
         const GLchar *vShaderCode = vertexCode.c_str( );
@@ -82,6 +186,7 @@ class Shader
         {
             glGetShaderInfoLog( vertex, 512, NULL, infoLog );
             std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+            print_shader_files( vertexFiles );
         }
 
 
@@ -97,6 +202,7 @@ class Shader
         {
             glGetShaderInfoLog( fragment, 512, NULL, infoLog );
             std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+            print_shader_files( fragmentFiles );
         }
 
 
@@ -138,26 +244,8 @@ class CShader //very similar to above, but for compute shader instead of vertex/
     {
 
         // 1. Retrieve the compute shader source code from Path
-        std::string Code;
-        std::ifstream File;
-        // ensures ifstream objects can throw exceptions:
-        File.exceptions ( std::ifstream::badbit );
-        try
-        {
-            // Open files
-            File.open( Path );
-            std::stringstream ShaderStream;
-            // Read file's buffer contents into streams
-            ShaderStream << File.rdbuf( );
-            // close file handlers
-            File.close( );
-            // Convert stream into string
-            Code = ShaderStream.str( );
-        }
-        catch ( std::ifstream::failure &e )
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
+        std::vector<std::string> files;
+        std::string Code = preprocess_shader( Path, {}, &files );
 
         const GLchar *cstrCode = Code.c_str( );
         // 2. Compile shaders
@@ -176,6 +264,7 @@ class CShader //very similar to above, but for compute shader instead of vertex/
         {
             glGetShaderInfoLog( shader, 512, NULL, infoLog );
             std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+            print_shader_files( files );
         }
 
         // Shader Program
@@ -201,4 +290,148 @@ class CShader //very similar to above, but for compute shader instead of vertex/
     }
 };
 
+
+// checks (once) whether the driver can compile shaders on its own threads - if it can, glCompileShader
+// and glLinkProgram return immediately, and GL_COMPLETION_STATUS can be polled without stalling
+inline bool parallel_shader_compile_available()
+{
+    static int available = -1;
+    if(available == -1)
+    {
+        available = 0;
+#ifdef GL_KHR_parallel_shader_compile
+        if(GLEW_KHR_parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // let the driver pick the thread count
+            available = 1;
+        }
+#endif
+#ifdef GL_ARB_parallel_shader_compile
+        if(!available && GLEW_ARB_parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+            available = 1;
+        }
+#endif
+    }
+    return available == 1;
+}
+
+
+class LazyCShader //compute shader that is registered up front, but only compiled when it's prewarmed or first used
+{
+  public:
+    LazyCShader( ) {}
+    LazyCShader( std::string p, shader_defines d = {} ) : path( p ), defines( d ) {}
+
+    // specialized copy of this shader, compiled with extra #defines - variants are cached by their defines,
+    // so asking for the same combination again gives back the same (already compiled) program
+    LazyCShader &variant( const shader_defines &d )
+    {
+        std::unique_ptr<LazyCShader> &v = variants[define_key( d )];
+        if( !v )
+            v = std::make_unique<LazyCShader>( path, d );
+        return *v;
+    }
+
+    // kick off the compile and link, without waiting on the result
+    void prewarm( )
+    {
+        if( started )
+            return;
+        started = true;
+
+        // 1. Retrieve the compute shader source code from path, with includes resolved and defines injected
+        std::string Code = preprocess_shader( path, defines, &files );
+
+        const GLchar *cstrCode = Code.c_str( );
+
+        // 2. Compile and link - no status queries here, those would force the driver to finish
+        shader = glCreateShader( GL_COMPUTE_SHADER );
+        glShaderSource( shader, 1, &cstrCode, NULL );
+        glCompileShader( shader );
+
+        Program = glCreateProgram( );
+        glAttachShader( Program, shader );
+        glLinkProgram( Program );
+    }
+
+    // has the driver finished with this one? - only non-blocking with parallel compile available
+    bool ready( )
+    {
+        if( checked || ready_cached )
+            return true;
+        if( !started )
+            return false;
+        if( !parallel_shader_compile_available( ) )
+            return ready_cached = true; // compile already happened synchronously in prewarm()
+
+        // once it's done it stays done, so the status is only asked for till then
+        GLint done = GL_FALSE;
+        glGetProgramiv( Program, GL_COMPLETION_STATUS_KHR, &done );
+        ready_cached = ( done == GL_TRUE );
+        return ready_cached;
+    }
+
+    bool started_compile( ) { return started; }
+
+    // finishes the compile (blocking if it's still in flight) and reports errors once
+    GLuint program( )
+    {
+        if( checked )
+            return Program;
+
+        prewarm( );
+        checked = true;
+
+        GLint success;
+        GLchar infoLog[512];
+
+        // Print compile errors if any
+        glGetShaderiv( shader, GL_COMPILE_STATUS, &success );
+        if ( !success )
+        {
+            glGetShaderInfoLog( shader, 512, NULL, infoLog );
+            std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED " << path << " " << define_key( defines ) << "\n" << infoLog << std::endl;
+            print_shader_files( files );
+        }
+
+        // Print linking errors if any
+        glGetProgramiv( Program, GL_LINK_STATUS, &success );
+        if ( !success )
+        {
+            glGetProgramInfoLog( Program, 512, NULL, infoLog );
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED " << path << " " << define_key( defines ) << "\n" << infoLog << std::endl;
+        }
+
+        // no longer necessary once the program is linked
+        glDeleteShader( shader );
+
+        return Program;
+    }
+
+    // this lets the handle be used anywhere a GLuint program is expected - glUseProgram(), glGetUniformLocation(), etc
+    operator GLuint( ) { return program( ); }
+
+  private:
+    static std::string define_key( shader_defines d )
+    {
+        std::sort( d.begin( ), d.end( ) ); // same set of defines in any order is the same variant
+        std::string key;
+        for( auto &x : d )
+            key += x.first + "=" + x.second + ";";
+        return key;
+    }
+
+    std::string path;
+    shader_defines defines;
+    std::vector<std::string> files; // what the source string numbers in its errors are
+    std::map<std::string, std::unique_ptr<LazyCShader>> variants;
+    GLuint shader = 0;
+    GLuint Program = 0;
+    bool started = false;   // compile + link have been issued
+    bool checked = false;   // status has been queried, program is usable
+    bool ready_cached = false; // the driver said it was done compiling
+};
+
 #endif
@@ -3,39 +3,54 @@
 //note that this only effects what the parameters to glDispatchCompute are - by using gl_GlobalInvocationID, you don't need to worry what any of those numbers are
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
 
-uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D lighting;        //values held in the lighting buffer
+uniform layout(r11f_g11f_b10f) image3D lighting;        //values held in the lighting buffer
+uniform layout(r32ui) uimage3D sat;         //summed volume table of the block's alpha, in 0-255 units
 
-uniform int radius; //how big a neighborhood should be considered for neighborhood occupancy?
+// occupancy is measured at three scales at once - near, mid and far - and blended with these weights, so small
+// crevices and large enclosed spaces can both darken without paying for the big neighborhood per voxel
+uniform ivec3 radii;
+uniform vec3 weights;
 
-void main()
+#include "include/region.glsl"
+#include "include/light_scale.glsl"
+
+// the table, with everything before the start of an axis reading as zero
+uint table(ivec3 p)
 {
-    vec4 prev = imageLoad(lighting, ivec3(gl_GlobalInvocationID.xyz));    //existing color value (what is the color?)
+  return any(lessThan(p, ivec3(0))) ? 0u : imageLoad(sat, p).r;
+}
 
-    float alpha_sum = 0.0f;
-    float total_weight = 0.0;
-    float current_weight = 0.0;
+// average alpha in the box of the given radius around p, clipped to the block - eight loads regardless of radius
+float occupancy(ivec3 p, int radius)
+{
+  ivec3 lo = max(p - ivec3(radius), ivec3(0)) - ivec3(1);
+  ivec3 hi = min(p + ivec3(radius), ivec3(DIM - 1));
+  ivec3 extent = hi - lo;
 
-    float max_dist = distance(vec3(0), vec3(radius)); // largest distance between the center cell and the other cells
+  uint sum = table(hi)
+           - table(ivec3(lo.x, hi.y, hi.z)) - table(ivec3(hi.x, lo.y, hi.z)) - table(ivec3(hi.x, hi.y, lo.z))
+           + table(ivec3(lo.x, lo.y, hi.z)) + table(ivec3(lo.x, hi.y, lo.z)) + table(ivec3(hi.x, lo.y, lo.z))
+           - table(lo);
 
-    for(int x = -radius; x <= radius; x++)
-        for(int y = -radius; y <= radius; y++)
-            for(int z = -radius; z <= radius; z++)
-            {
-                current_weight = 1-(distance(vec3(0), vec3(x, y, z)));
-                total_weight+=current_weight;
-                alpha_sum += imageLoad(current, ivec3(gl_GlobalInvocationID.xyz)+ivec3(x,y,z)).a*current_weight;
-            }
+  return float(sum) / (255.0 * float(extent.x * extent.y * extent.z));
+}
 
-    //sum up alpha values across the cells being considered
-    //compute a ratio of that alpha sum over the number of cells considered
-    //scale the rgb components of pcol by this ratio
+void main()
+{
+    ivec3 p = region_position();
+    if(!in_region(p))
+        return;
 
-    //a high ratio of occuppancy means this cell should be darkened
-    //therefore, we are multiplying the existing lighting value by one minus this ratio
+    vec4 prev = imageLoad(lighting, p);    //existing lighting value
 
-    float new = prev.r * (1 - alpha_sum/total_weight);
+    //a high ratio of occupancy means this cell should be darkened
+    //therefore, we are multiplying the existing lighting value by one minus the weighted occupancy
+    ivec3 v = p * LIGHT_SCALE + ivec3(LIGHT_SCALE / 2); // the voxel at the center of this lighting cell
+    vec3 occ = vec3(occupancy(v, radii.x), occupancy(v, radii.y), occupancy(v, radii.z));
+    float total_weight = weights.x + weights.y + weights.z;
+    float occlusion = (total_weight > 0.0) ? dot(occ, weights) / total_weight : 0.0;
 
-    imageStore(lighting, ivec3(gl_GlobalInvocationID.xyz), vec4(new));
-}
+    vec3 new = prev.rgb * (1 - occlusion);
 
+    imageStore(lighting, p, vec4(new, 1.0));
+}
@@ -1,63 +1,77 @@
 #version 430
 
-//note that this only effects what the parameters to glDispatchCompute are - by using gl_GlobalInvocationID, you don't need to worry what any of those numbers are
+// box blur, one channel at a time - box_blur() builds the summed volume table for a channel, then this reads the
+// sum over each voxel's box out of it with eight loads, so the cost doesn't depend on the radius
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
 
 uniform layout(rgba8) image3D previous;       //now-current values of the block
-uniform layout(r8) image3D previous_mask;  //now-current values of the mask
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
 
 uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D current_mask;   //values of the mask after the update
+uniform layout(r32ui) uimage3D current_mask;  //values of the mask after the update
+
+uniform layout(r32ui) uimage3D sat;         //summed volume table for this channel, in 0-255 units
 
 uniform int radius;
-uniform bool respect_mask;
-uniform bool touch_alpha;
+#ifndef CHANNEL
+#define CHANNEL 0       //injected per variant - 0-3 are color channels, 4 is the mask
+#endif
+#ifndef RESPECT_MASK
+#define RESPECT_MASK 1  //injected per variant - should the blur leave masked cells alone?
+#endif
+
+#include "include/mask.glsl"
+#include "include/roi.glsl"
+
+uniform ivec3 table_min;  //where the table starts - the region of interest, less the radius
 
-vec4 mask_true = vec4(1.0,0.0,0.0,0.0);
-vec4 mask_false = vec4(0.0,0.0,0.0,0.0);
+// the table, with everything before its start reading as zero
+uint table(ivec3 p)
+{
+  return any(lessThan(p, table_min)) ? 0u : imageLoad(sat, p).r;
+}
 
 void main()
 {
-  bool pmask = (imageLoad(previous_mask, ivec3(gl_GlobalInvocationID.xyz)).r > 0.5);  //existing mask value (previous_mask = 0?)
-  vec4 pcol = imageLoad(previous, ivec3(gl_GlobalInvocationID.xyz));                 //existing color value (what is the previous color?)
-
-  if(pmask && respect_mask)
-  {
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_true);
-    imageStore(current, ivec3(gl_GlobalInvocationID.xyz), pcol);
-  }
-  else
-  {
-    int num = 0;
-    vec4 csum = vec4(0,0,0,0);
-    float msum = 0.0;
-
-    for(int x = (-1 * radius); x <= radius; x++)
-    {
-      for(int y = (-1 * radius); y <= radius; y++)
-      {
-        for(int z = (-1 * radius); z <= radius; z++)
-        {
-          csum += imageLoad(previous, ivec3(gl_GlobalInvocationID.xyz) + ivec3(x,y,z));
-          msum += (imageLoad(previous_mask, ivec3(gl_GlobalInvocationID.xyz) + ivec3(x,y,z)).r > 0.5) ? 1.0 : 0.0;
-          num++;
-        }
-      }
-    }
-
-    //divide csum and msum by num
-    csum /= num;
-    msum /= num;
-
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), (msum > 0.5) ? mask_true : mask_false);
-
-    if(touch_alpha)
-    { //alpha will change to the average of the neighboring cells
-      imageStore(current, ivec3(gl_GlobalInvocationID.xyz), csum);
-    }
-    else
-    { //don't touch alpha, get the value from pcol
-      imageStore(current, ivec3(gl_GlobalInvocationID.xyz), vec4(csum.rgb, pcol.a));
-    }
-  }
+  ivec3 p = region_position();
+  if(!in_roi(p))
+    return;
+
+  bool pmask = MASK_READ(previous_mask, p);  //existing mask value (previous_mask = 0?)
+
+  // the box is clipped to the block, and only the cells inside it count toward the average
+  ivec3 lo = max(p - ivec3(radius), ivec3(0)) - ivec3(1);
+  ivec3 hi = min(p + ivec3(radius), ivec3(DIM - 1));
+  ivec3 extent = hi - lo;
+
+  // inclusion-exclusion over the corners of the box
+  uint sum = table(hi)
+           - table(ivec3(lo.x, hi.y, hi.z)) - table(ivec3(hi.x, lo.y, hi.z)) - table(ivec3(hi.x, hi.y, lo.z))
+           + table(ivec3(lo.x, lo.y, hi.z)) + table(ivec3(lo.x, hi.y, lo.z)) + table(ivec3(hi.x, lo.y, lo.z))
+           - table(lo);
+
+  float average = float(sum) / (255.0 * float(extent.x * extent.y * extent.z));
+
+#if CHANNEL == 4
+  bool masked = (average > 0.5);
+#if RESPECT_MASK
+  masked = masked || pmask; //masked cells stay masked
+#endif
+  MASK_WRITE(current_mask, p, masked);
+#else
+  // the first channel starts from the existing color, the rest build on what the earlier passes wrote - so a
+  // channel that is skipped (alpha, when alpha isn't touched) keeps its existing value
+#if CHANNEL == 0
+  vec4 result = imageLoad(previous, p);
+#else
+  vec4 result = imageLoad(current, p);
+#endif
+
+#if RESPECT_MASK
+  if(!pmask) //masked cells keep their color
+#endif
+    result[CHANNEL] = average;
+
+  imageStore(current, p, result);
+#endif
 }
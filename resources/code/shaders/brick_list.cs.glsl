@@ -0,0 +1,147 @@
+#version 430
+
+// brick lists, for indirect dispatch - the first pass sorts the 8^3 bricks of the block into classes (anything
+// non-zero in it, any masked voxels, any unmasked voxels), the second grows the classes out by some number of
+// bricks one axis at a time, and the third lists the bricks (8^3 voxels, or 8^3 lighting cells) of a box that
+// have the classes an operation needs, near them and on them. The fourth pass turns the count into workgroups
+// for glDispatchComputeIndirect - those can't go past 65535 on an axis, so the list is read BRICK_ROW at a time.
+// The last one copies the listed bricks from the current block to the previous one, for editing them in place
+
+// this is injected by the shader preprocessor
+#ifndef PASS
+#define PASS 0  // 0 classifies, 1 dilates along AXIS, 2 lists, 3 writes the workgroup counts, 4 copies
+#endif
+#ifndef AXIS
+#define AXIS 0
+#endif
+
+#if PASS == 3
+layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+#else
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //one brick, or 8^3 of them
+#endif
+
+// BRICK_* in gpu_data.h
+#define BRICK_OCCUPIED 1u
+#define BRICK_MASKED   2u
+#define BRICK_UNMASKED 4u
+
+#define BRICK_ROW 1024u   //BRICK_ROW in gpu_data.h
+#define BRICKS (DIM / 8)
+
+layout(std430, binding = 6) buffer brick_flags
+{
+  uint flags[];   //three arrays of BRICKS^3 - the classes, then two for dilating them
+};
+
+layout(std430, binding = 7) buffer brick_list
+{
+  uint count;
+  uint groups[3];   //what glDispatchComputeIndirect reads
+  uint bricks[];    //packed ten bits to an axis, in units of bricks
+};
+
+#if PASS == 0 || PASS == 4
+uniform layout(rgba8) image3D current;
+uniform layout(r32ui) uimage3D current_mask;
+
+#include "include/mask.glsl"
+#endif
+
+#if PASS == 0
+shared uint classes;
+#endif
+
+#if PASS == 4
+uniform layout(rgba8) image3D previous;
+uniform layout(r32ui) uimage3D previous_mask;
+#endif
+
+#if PASS == 1
+uniform uint source;        //offsets into flags
+uniform uint destination;
+uniform int reach;          //in bricks
+#endif
+
+#if PASS == 2
+uniform uint near;          //a brick is listed if it has any of these classes within reach of it,
+uniform uint self;          //and all of these itself
+uniform uint near_offset;   //where the dilated classes are in flags
+uniform int scale;          //1 lists bricks of voxels, LIGHT_SCALE bricks of lighting cells
+uniform ivec3 box_min;      //only bricks that overlap this box, in voxels or lighting cells
+uniform ivec3 box_max;
+#endif
+
+uint flag_index(ivec3 b)
+{
+  return uint(b.x + BRICKS * (b.y + BRICKS * b.z));
+}
+
+void main()
+{
+#if PASS == 0
+  ivec3 brick = ivec3(gl_WorkGroupID.xyz);
+  ivec3 p = 8 * brick + ivec3(gl_LocalInvocationID.xyz);
+  if(gl_LocalInvocationIndex == 0u)
+    classes = 0u;
+  barrier();
+
+  uint c = MASK_READ(current_mask, p) ? BRICK_MASKED : BRICK_UNMASKED;
+  if(packUnorm4x8(imageLoad(current, p)) != 0u)
+    c |= BRICK_OCCUPIED;
+  atomicOr(classes, c);
+  barrier();
+
+  if(gl_LocalInvocationIndex == 0u)
+    flags[flag_index(brick)] = classes;
+#elif PASS == 1
+  ivec3 b = ivec3(gl_GlobalInvocationID.xyz);
+  if(any(greaterThanEqual(b, ivec3(BRICKS))))
+    return;
+  uint c = 0u;
+  for(int i = -reach; i <= reach; i++)
+  {
+    ivec3 n = b;
+    n[AXIS] += i;
+    if(n[AXIS] >= 0 && n[AXIS] < BRICKS)
+      c |= flags[source + flag_index(n)];
+  }
+  flags[destination + flag_index(b)] = c;
+#elif PASS == 2
+  ivec3 b = ivec3(gl_GlobalInvocationID.xyz);
+  if(any(greaterThanEqual(b, ivec3(BRICKS / scale))))
+    return;
+  if(any(greaterThan(8 * b, box_max)) || any(lessThan(8 * b + ivec3(7), box_min)))
+    return;
+
+  // a brick of lighting cells covers scale^3 bricks of voxels
+  uint n = 0u, s = 0u;
+  for(int x = 0; x < scale; x++)
+  for(int y = 0; y < scale; y++)
+  for(int z = 0; z < scale; z++)
+  {
+    uint i = flag_index(scale * b + ivec3(x, y, z));
+    n |= flags[near_offset + i];
+    s |= flags[i];
+  }
+
+  if((n & near) != 0u && (s & self) == self)
+    bricks[atomicAdd(count, 1u)] = uint(b.x) | (uint(b.y) << 10) | (uint(b.z) << 20);
+#elif PASS == 3
+  groups[0] = min(count, BRICK_ROW);
+  groups[1] = (count + BRICK_ROW - 1u) / BRICK_ROW;
+  groups[2] = 1u;
+#else
+  uint i = gl_WorkGroupID.x + gl_WorkGroupID.y * BRICK_ROW;
+  if(i >= count)
+    return; // past the end of the list, on the last row
+  uint b = bricks[i];
+  ivec3 p = 8 * ivec3(b & 1023u, (b >> 10) & 1023u, b >> 20) + ivec3(gl_LocalInvocationID.xyz);
+  imageStore(previous, p, imageLoad(current, p));
+
+  // whole mask words, which reach into the bricks on either side along x - those aren't edited, so the bits of
+  // theirs that come along are the same in both blocks afterwards anyway
+  if(gl_LocalInvocationID.x == 0u)
+    imageStore(previous_mask, MASK_WORD(p), imageLoad(current_mask, MASK_WORD(p)));
+#endif
+}
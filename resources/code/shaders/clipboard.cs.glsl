@@ -0,0 +1,128 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //one brick of the selection, or 8^3 of the destination
+
+// copy/paste through a sparse clipboard - the selection is cut into 8^3 bricks starting at its low corner, and only
+// the bricks with something in them are kept. The first pass gives each occupied brick a slot, the second copies
+// those bricks into their slots, and the third pastes: every voxel of the destination box goes back through the
+// paste's transform to find the voxel of the clipboard that lands on it
+
+// these are injected by the shader preprocessor
+#ifndef PASS
+#define PASS 0          // 0 lists the occupied bricks, 1 gathers them, 2 pastes
+#endif
+#ifndef MASKED_ONLY
+#define MASKED_ONLY 0   //copy only the masked voxels of the selection?
+#endif
+#ifndef RESPECT_MASK
+#define RESPECT_MASK 1  //should masked cells be left alone by a paste?
+#endif
+#ifndef OVERWRITE
+#define OVERWRITE 0     //should the empty voxels of the clipboard clear what they land on?
+#endif
+
+uniform layout(rgba8) image3D current;        //the block - a paste changes it in place
+uniform layout(r32ui) uimage3D current_mask;
+
+#include "include/mask.glsl"
+
+#define NONE 0xFFFFFFFFu
+
+layout(std430, binding = 4) buffer clipboard_index
+{
+  uint count;     //how many bricks are stored
+  uint index[];   //the slot each brick of the selection is stored in, NONE if it's empty
+};
+
+layout(std430, binding = 5) buffer clipboard_data
+{
+  uint data[];    //512 packed colors per slot, x fastest
+};
+
+uniform ivec3 size;   //the clipboard, in voxels
+
+uint brick_index(ivec3 brick)
+{
+  ivec3 bricks = (size + 7) / 8;
+  return uint(brick.x + bricks.x * (brick.y + bricks.y * brick.z));
+}
+
+uint voxel_index(ivec3 q)
+{
+  ivec3 l = q % 8;
+  return uint(l.x + 8 * (l.y + 8 * l.z));
+}
+
+#if PASS != 2
+uniform ivec3 selection_min;  //where the clipboard's low corner is in the block
+
+shared bool occupied;
+
+// the voxel at q in the clipboard - empty past the edge of the selection, or outside the mask
+vec4 selected(ivec3 q)
+{
+  if(any(greaterThanEqual(q, size)))
+    return vec4(0);
+
+  ivec3 p = selection_min + q;
+#if MASKED_ONLY
+  if(!MASK_READ(current_mask, p))
+    return vec4(0);
+#endif
+  return imageLoad(current, p);
+}
+#else
+#include "include/region.glsl"
+
+uniform ivec3 origin;     //where the clipboard's origin lands in the block
+uniform ivec3 axes[3];    //columns of the inverse of the paste's rotation and mirroring, block to clipboard
+#endif
+
+void main()
+{
+#if PASS != 2
+  ivec3 brick = ivec3(gl_WorkGroupID.xyz);
+  ivec3 q = 8 * brick + ivec3(gl_LocalInvocationID.xyz);
+
+#if PASS == 0
+  if(gl_LocalInvocationIndex == 0u)
+    occupied = false;
+  barrier();
+
+  if(selected(q).a > 0.0)
+    occupied = true;
+  barrier();
+
+  if(gl_LocalInvocationIndex == 0u)
+    index[brick_index(brick)] = occupied ? atomicAdd(count, 1u) : NONE;
+#else
+  uint slot = index[brick_index(brick)];
+  if(slot != NONE)
+    data[slot * 512u + voxel_index(q)] = packUnorm4x8(selected(q));
+#endif
+
+#else
+  ivec3 p = region_position();
+  if(!in_region(p))
+    return;
+
+  ivec3 v = p - origin;
+  ivec3 q = v.x * axes[0] + v.y * axes[1] + v.z * axes[2];
+  if(any(lessThan(q, ivec3(0))) || any(greaterThanEqual(q, size)))
+    return;
+
+  uint slot = index[brick_index(q / 8)];
+  vec4 color = (slot == NONE) ? vec4(0) : unpackUnorm4x8(data[slot * 512u + voxel_index(q)]);
+
+#if !OVERWRITE
+  if(color.a == 0.0)  //empty space in the clipboard leaves the block as it was
+    return;
+#endif
+#if RESPECT_MASK
+  if(MASK_READ(current_mask, p))
+    return;
+#endif
+
+  imageStore(current, p, color);
+#endif
+}
@@ -0,0 +1,127 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
+
+// connected components of the voxels above an alpha threshold, as a forest of labels - every solid voxel holds
+// the label of another voxel in its component (labels are the voxel's index plus one, 0 is empty space), and
+// the one at the root of each tree holds its own. label_components() initializes every solid voxel as its own
+// root, then alternates hooking (the larger of two touching roots is pointed at the smaller) and compressing
+// (every voxel is pointed straight at its root) until nothing changes - trees merge pairwise and get flattened
+// every pass, so it takes a handful of passes, roughly logarithmic in the size of the biggest component.
+// After that, each component is labeled with the index of its first voxel, and mask_component() masks one of them.
+// Every pass is dispatched over the region - with a region of interest, components only connect inside of it
+
+// this is injected by the shader preprocessor
+#ifndef PASS
+#define PASS 0  // 0 initializes, 1 hooks, 2 compresses, 3 masks the component under the seed
+#endif
+
+uniform layout(r32ui) coherent uimage3D labels;   //the front copy/paste buffer, seen as r32ui like the summed volume table
+
+#include "include/region.glsl"
+
+// how far hooking and compressing got - changed says another pass is needed, roots counts components
+layout(std430, binding = 1) buffer components_status
+{
+  uint changed;
+  uint roots;
+};
+
+#if PASS == 0
+uniform layout(rgba8) image3D current;        //the block
+uniform float alpha_threshold;
+#endif
+
+#if PASS == 3
+uniform layout(rgba8) image3D previous;       //now-current values of the block
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
+
+uniform layout(rgba8) image3D current;        //values of the block after the update
+uniform layout(r32ui) uimage3D current_mask;  //values of the mask after the update
+
+uniform ivec3 seed;
+
+#include "include/mask.glsl"
+#endif
+
+uint label_of(ivec3 p)
+{
+  return uint(p.x + DIM * (p.y + DIM * p.z)) + 1u;
+}
+
+ivec3 voxel_of(uint label)
+{
+  uint i = label - 1u;
+  return ivec3(i % DIM, (i / DIM) % DIM, i / (DIM * DIM));
+}
+
+uint label_at(ivec3 p)
+{
+  return imageLoad(labels, p).r;
+}
+
+// follow the labels up to the root - they only ever point at smaller labels, so this always ends, even with other
+// threads hooking and compressing at the same time
+uint root(uint label)
+{
+  uint next = label_at(voxel_of(label));
+  while(next != label)
+  {
+    label = next;
+    next = label_at(voxel_of(label));
+  }
+  return label;
+}
+
+void main()
+{
+  ivec3 p = region_position();
+  if(!in_region(p))
+    return;
+
+#if PASS == 0
+  imageStore(labels, p, uvec4((imageLoad(current, p).a > alpha_threshold) ? label_of(p) : 0u));
+#elif PASS == 1
+  uint own = label_at(p);
+  if(own == 0u)
+    return;
+
+  // the neighbor behind each face - anything already on the same label is in the same tree
+  const ivec3 faces[6] = ivec3[6](ivec3(1,0,0), ivec3(-1,0,0), ivec3(0,1,0), ivec3(0,-1,0), ivec3(0,0,1), ivec3(0,0,-1));
+  for(int i = 0; i < 6; i++)
+  {
+    ivec3 n = p + faces[i];
+    if(!in_region(n))
+      continue; // past the edge of the block, or of the region - the labels out there aren't this labeling's
+
+    uint other = label_at(n);
+    if(other == 0u || other == own)
+      continue;
+
+    uint a = root(own), b = root(other);
+    if(a != b)
+    {
+      imageAtomicMin(labels, voxel_of(max(a, b)), min(a, b));
+      changed = 1u;
+    }
+  }
+#elif PASS == 2
+  uint own = label_at(p);
+  if(own == 0u)
+    return;
+
+  uint r = root(own);
+  if(r != own)
+    imageStore(labels, p, uvec4(r));
+  if(r == label_of(p))
+    atomicAdd(roots, 1u);
+#else
+  // the labels are compressed, so the seed's label is its component's root - an empty seed selects nothing, and
+  // so does one outside of the region
+  uint target = in_region(seed) ? label_at(seed) : 0u;
+  bool pmask = MASK_READ(previous_mask, p);
+
+  imageStore(current, p, imageLoad(previous, p)); //color can't change as a result of this operation
+  MASK_WRITE(current_mask, p, pmask || (target != 0u && label_at(p) == target));
+#endif
+}
@@ -0,0 +1,125 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in; //3d workgroup
+
+uniform layout(r11f_g11f_b10f) image3D lighting;
+uniform sampler3D pyramid;  //radiance and opacity by direction, built by gi_pyramid.cs.glsl
+
+uniform float strength;     //how much of the light the cones gather is added
+uniform float step_scale;   //distance between samples along a cone, as a fraction of its width there
+uniform float max_distance; //how far the cones go, in voxels
+uniform float sky_intensity; //what a cone gets for whatever of it leaves the block
+uniform vec3 sky_color;
+
+// voxel cone traced GI - each lighting cell gathers the light around it through a handful of cones. A cone is
+// marched front to back through the radiance pyramid, reading coarser levels as it gets wider, so a few dozen
+// filtered samples stand in for the thousands of rays it covers, and it stops once it's all but opaque.
+// Cells on a surface (where the opacity changes) cast a hemisphere of cones away from it, cosine weighted -
+// cells in open air or inside of something cast them in every direction
+
+// this is injected by the shader preprocessor
+#ifndef CONES
+#define CONES 16  // how many cones each cell traces
+#endif
+
+#include "include/region.glsl"
+#include "include/light_scale.glsl"
+
+#define PI 3.14159265
+
+// sample a tile of the pyramid at a position in voxels - clamped half a texel inside the tile on x, so filtering
+// doesn't pull in the tile next to it
+vec4 tile_sample(int tile, vec3 uvw, float level)
+{
+    float texels = float(textureSize(pyramid, int(ceil(level))).y);
+    uvw.x = clamp(uvw.x, 0.5 / texels, 1.0 - 0.5 / texels);
+    return textureLod(pyramid, vec3((float(tile) + uvw.x) / 6.0, uvw.yz), level);
+}
+
+// what a cone going along dir sees at pos - the three tiles facing it, weighted by how much it goes their way
+vec4 pyramid_sample(vec3 pos, vec3 dir, float level)
+{
+    vec3 uvw = (pos + vec3(0.5)) / float(DIM);
+    vec3 w = dir * dir;
+    return w.x * tile_sample(dir.x > 0.0 ? 0 : 1, uvw, level)
+         + w.y * tile_sample(dir.y > 0.0 ? 2 : 3, uvw, level)
+         + w.z * tile_sample(dir.z > 0.0 ? 4 : 5, uvw, level);
+}
+
+float opacity(vec3 pos)
+{
+    return tile_sample(0, (pos + vec3(0.5)) / float(DIM), 0.0).a;
+}
+
+// the light a cone gathers, starting a base texel out so the cell doesn't see itself
+vec3 trace(vec3 origin, vec3 dir, float aperture, float texel)
+{
+    vec4 gathered = vec4(0);
+    float t = texel;
+    while(t < max_distance && gathered.a < 0.95)
+    {
+        vec3 pos = origin + t * dir;
+        if(any(lessThan(pos, vec3(-0.5))) || any(greaterThan(pos, vec3(DIM - 0.5))))
+        {
+            gathered.rgb += (1.0 - gathered.a) * sky_intensity * sky_color;
+            break;
+        }
+
+        float diameter = max(texel, 2.0 * aperture * t);
+        vec4 s = pyramid_sample(pos, dir, log2(diameter / texel));
+
+        // the samples overlap by 1 / step_scale, so each one's opacity is taken over just the step it stands for
+        float a = 1.0 - pow(max(1.0 - s.a, 0.0), step_scale);
+        s.rgb *= (s.a > 0.0) ? a / s.a : 0.0;
+
+        gathered += (1.0 - gathered.a) * vec4(s.rgb, a);
+        t += step_scale * diameter;
+    }
+    return gathered.rgb;
+}
+
+// cone i of CONES, spread evenly over the +z hemisphere or the whole sphere on a fibonacci spiral
+vec3 cone_direction(int i, bool hemisphere)
+{
+    float z = hemisphere ? 1.0 - (float(i) + 0.5) / float(CONES) : 1.0 - 2.0 * (float(i) + 0.5) / float(CONES);
+    float r = sqrt(max(0.0, 1.0 - z * z));
+    float phi = float(i) * 2.39996323; // golden angle
+    return vec3(r * cos(phi), r * sin(phi), z);
+}
+
+void main()
+{
+    ivec3 p = region_position();
+    if(!in_region(p))
+        return;
+
+    vec3 pos = cell_center(p);
+    float texel = float(DIM) / float(textureSize(pyramid, 0).y); // voxels on a side of a base level texel
+
+    // the surface normal points down the opacity gradient
+    vec3 gradient = vec3(opacity(pos + vec3(texel, 0, 0)) - opacity(pos - vec3(texel, 0, 0)),
+                         opacity(pos + vec3(0, texel, 0)) - opacity(pos - vec3(0, texel, 0)),
+                         opacity(pos + vec3(0, 0, texel)) - opacity(pos - vec3(0, 0, texel)));
+    bool surface = length(gradient) > 0.05;
+    vec3 n = surface ? -normalize(gradient) : vec3(0, 0, 1);
+
+    vec3 t = normalize(cross(n, abs(n.x) < 0.9 ? vec3(1, 0, 0) : vec3(0, 1, 0)));
+    mat3 basis = mat3(t, cross(n, t), n);
+
+    // each cone gets an even share of the solid angle - its half angle is the one that covers that much
+    float solid_angle = (surface ? 2.0 : 4.0) * PI / float(CONES);
+    float aperture = tan(acos(1.0 - solid_angle / (2.0 * PI)));
+
+    vec3 sum = vec3(0);
+    float total = 0.0;
+    for(int i = 0; i < CONES; i++)
+    {
+        vec3 d = cone_direction(i, surface);
+        float w = surface ? d.z : 1.0;
+        sum += w * trace(pos, basis * d, aperture, texel);
+        total += w;
+    }
+
+    vec3 prev_light = imageLoad(lighting, p).rgb; // the lighting value that was in the cell, before this operation
+    imageStore(lighting, p, vec4(prev_light + strength * sum / total, 1.0));
+}
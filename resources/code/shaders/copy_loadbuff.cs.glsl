@@ -4,33 +4,36 @@
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
 
 uniform layout(rgba8) image3D previous;       //now-current values of the block
-uniform layout(r8) image3D previous_mask;  //now-current values of the mask
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
 
 uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D current_mask;   //values of the mask after the update
+uniform layout(r32ui) uimage3D current_mask;  //values of the mask after the update
 
 uniform layout(rgba8) image3D loadbuff;   // the loadbuffer, generally containg data from the CPU
 
-uniform bool respect_mask;         //when clearing, should you touch the masked cells?
+#ifndef RESPECT_MASK
+#define RESPECT_MASK 1  //injected per variant - when clearing, should you touch the masked cells?
+#endif
 //true means you will not touch the masked cells, false means you will indeed clear all
 
-vec4 mask_true = vec4(1.0,0.0,0.0,0.0);
-vec4 mask_false = vec4(0.0,0.0,0.0,0.0);
+#include "include/mask.glsl"
 
 void main()
 {
-	bool pmask = (imageLoad(previous_mask, ivec3(gl_GlobalInvocationID.xyz)).r > 0.5);  //existing mask value (previous_mask = 0?)
+	bool pmask = MASK_READ(previous_mask, ivec3(gl_GlobalInvocationID.xyz));  //existing mask value (previous_mask = 0?)
 	vec4 pcol = imageLoad(previous, ivec3(gl_GlobalInvocationID.xyz));                 //existing color value (what is the previous color?)
 	vec4 lbcontent = imageLoad(loadbuff, ivec3(gl_GlobalInvocationID.xyz));
 
-	if(pmask && respect_mask) //the cell was masked
+#if RESPECT_MASK
+	if(pmask) //the cell was masked
 	{
 		imageStore(current, ivec3(gl_GlobalInvocationID.xyz), pcol);  //color takes on previous color
-		imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_true);  //mask is set true
+		MASK_SET(current_mask, ivec3(gl_GlobalInvocationID.xyz));  //mask is set true
 	}
 	else
+#endif
 	{
 		imageStore(current, ivec3(gl_GlobalInvocationID.xyz), lbcontent);
-		imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), pmask?vec4(1):vec4(0));
+		MASK_WRITE(current_mask, ivec3(gl_GlobalInvocationID.xyz), pmask);
 	}
 }
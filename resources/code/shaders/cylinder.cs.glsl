@@ -4,10 +4,10 @@
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
 
 uniform layout(rgba8) image3D previous;       //now-current values of the block
-uniform layout(r8) image3D previous_mask;  //now-current values of the mask
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
 
 uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D current_mask;   //values of the mask after the update
+uniform layout(r32ui) uimage3D current_mask;  //values of the mask after the update
 
 uniform vec3 tvec;            //location of center of top
 uniform vec3 bvec;            //location of center of bottom
@@ -15,8 +15,13 @@ uniform float radius;         //how thick is this cylinder?
 
 uniform vec4 color;           //what color should it be drawn with?
 
-uniform bool draw;      //should this shape be drawn?
-uniform bool mask;      //this this shape be masked?
+// DRAW and MASK are injected by the shader preprocessor, one variant per combination
+#ifndef DRAW
+#define DRAW 1  //should this shape be drawn?
+#endif
+#ifndef MASK
+#define MASK 0  //this this shape be masked?
+#endif
 
 
 bool planetest(vec3 plane_point, vec3 plane_normal, vec3 test_point)
@@ -73,34 +78,35 @@ bool in_shape()
   return false;
 }
 
-vec4 mask_true = vec4(1.0,0.0,0.0,0.0);
-vec4 mask_false = vec4(0.0,0.0,0.0,0.0);
+#include "include/mask.glsl"
 
 void main()
 {
-  bool pmask = (imageLoad(previous_mask, ivec3(gl_GlobalInvocationID.xyz)).r > 0.5);  //existing mask value (previous_mask = 0?)
+  bool pmask = MASK_READ(previous_mask, ivec3(gl_GlobalInvocationID.xyz));  //existing mask value (previous_mask = 0?)
   vec4 pcol = imageLoad(previous, ivec3(gl_GlobalInvocationID.xyz));                 //existing color value (what is the previous color?)
 
   if(pmask) //the cell was masked
   {
     imageStore(current, ivec3(gl_GlobalInvocationID.xyz), pcol);  //color takes on previous color
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_true);  //mask is set true
+    MASK_SET(current_mask, ivec3(gl_GlobalInvocationID.xyz));  //mask is set true
   }
   else if(!in_shape())  //the cell was not masked, but is outside the shape
   {
     imageStore(current, ivec3(gl_GlobalInvocationID.xyz), pcol);  //color takes previous color
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_false); //mask is set false
+    MASK_CLEAR(current_mask, ivec3(gl_GlobalInvocationID.xyz)); //mask is set false
   }
   else  //the cell was not masked, and is inside the shape
   {
-    if(mask)  //uniform value telling whether or not to mask
-      imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_true);
-    else
-      imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_false);
+#if MASK  //compiled in, not a uniform
+      MASK_SET(current_mask, ivec3(gl_GlobalInvocationID.xyz));
+#else
+      MASK_CLEAR(current_mask, ivec3(gl_GlobalInvocationID.xyz));
+#endif
 
-    if(draw)  //uniform value telling whether or not to draw
+#if DRAW  //compiled in, not a uniform
       imageStore(current, ivec3(gl_GlobalInvocationID.xyz), color); //uniform color
-    else
+#else
       imageStore(current, ivec3(gl_GlobalInvocationID.xyz), pcol);  //previous color
+#endif
   }
 }
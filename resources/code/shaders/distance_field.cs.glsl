@@ -0,0 +1,115 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
+
+// signed distance to the surface of the voxels above an alpha threshold, by jump flooding. The surface is the
+// solid voxels with an empty face neighbor - each of those seeds itself, then every pass looks at its 26
+// neighbors step voxels away (halving step each pass, from half the box down to 1) and keeps whichever of
+// their nearest seeds is nearest to it. After log2 of the box's size passes, every voxel knows the nearest
+// surface voxel, to within a voxel or so, and the last pass turns that into the distance field - negative
+// inside, positive outside, zero halfway between a surface voxel and the empty voxel next to it
+
+// this is injected by the shader preprocessor
+#ifndef PASS
+#define PASS 0  // 0 seeds, 1 jumps, 2 writes the distance field
+#endif
+
+#define NONE 0xFFFFFFFFu
+
+// everything happens inside of the region - the whole block, or an edited box plus enough around it that the
+// distances written back are the same as they would be for the whole block
+#include "include/region.glsl"
+
+#if PASS == 1
+uniform layout(r32ui) uimage3D source;        //nearest seed so far, packed
+#endif
+uniform layout(r32ui) uimage3D destination;
+
+#if PASS != 1
+uniform layout(rgba8) image3D current;        //the block
+uniform float alpha_threshold;
+#endif
+
+#if PASS == 1
+uniform int step_size;
+#endif
+
+#if PASS == 2
+uniform layout(r16f) image3D distance_field;
+uniform float range;          //distances are clamped to this, in voxels
+uniform ivec3 write_min;      //the part of the region that has all the seeds it needs, which gets written back
+uniform ivec3 write_max;
+#endif
+
+// seed positions are packed ten bits to an axis
+uint pack_seed(ivec3 p)
+{
+  return uint(p.x) | (uint(p.y) << 10) | (uint(p.z) << 20);
+}
+
+ivec3 unpack_seed(uint s)
+{
+  return ivec3(s & 1023u, (s >> 10) & 1023u, (s >> 20) & 1023u);
+}
+
+#if PASS != 1
+bool solid(ivec3 p)
+{
+  return imageLoad(current, p).a > alpha_threshold;
+}
+#endif
+
+void main()
+{
+  ivec3 p = region_position();
+  if(!in_region(p))
+    return;
+
+#if PASS == 0
+  // a surface voxel - the outside of the block doesn't count as empty, so solid against the edges isn't a surface
+  bool surface = false;
+  if(solid(p))
+  {
+    const ivec3 faces[6] = ivec3[6](ivec3(1,0,0), ivec3(-1,0,0), ivec3(0,1,0), ivec3(0,-1,0), ivec3(0,0,1), ivec3(0,0,-1));
+    for(int i = 0; i < 6; i++)
+    {
+      ivec3 n = p + faces[i];
+      if(all(greaterThanEqual(n, ivec3(0))) && all(lessThan(n, ivec3(DIM))) && !solid(n))
+        surface = true;
+    }
+  }
+  imageStore(destination, p, uvec4(surface ? pack_seed(p) : NONE));
+#elif PASS == 1
+  uint best = imageLoad(source, p).r;
+  float best_distance = (best == NONE) ? 1e30 : distance(vec3(p), vec3(unpack_seed(best)));
+
+  for(int x = -1; x <= 1; x++)
+  for(int y = -1; y <= 1; y++)
+  for(int z = -1; z <= 1; z++)
+  {
+    ivec3 q = p + step_size * ivec3(x, y, z);
+    if((x == 0 && y == 0 && z == 0) || !in_region(q))
+      continue;
+
+    uint s = imageLoad(source, q).r;
+    if(s == NONE)
+      continue;
+
+    float d = distance(vec3(p), vec3(unpack_seed(s)));
+    if(d < best_distance)
+    {
+      best = s;
+      best_distance = d;
+    }
+  }
+  imageStore(destination, p, uvec4(best));
+#else
+  if(any(lessThan(p, write_min)) || any(greaterThan(p, write_max)))
+    return;
+
+  uint s = imageLoad(destination, p).r;
+  float d = (s == NONE) ? range : distance(vec3(p), vec3(unpack_seed(s)));
+  float signed_distance = solid(p) ? -(d + 0.5) : (d - 0.5);
+  imageStore(distance_field, p, vec4(clamp(signed_distance, -range, range)));
+#endif
+}
@@ -1,67 +1,101 @@
 #version 430
 
-//note that this only effects what the parameters to glDispatchCompute are - by using gl_GlobalInvocationID, you don't need to worry what any of those numbers are
-layout(local_size_x = 8, local_size_y = 1, local_size_z = 8) in;    //specifies the workgroup size
+// one thread per line through the block, along one of the 9 upward lattice directions
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;    //specifies the workgroup size
 
 uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D lighting;        //values held in the lighting buffer
+uniform layout(r11f_g11f_b10f) image3D lighting;        //values held in the lighting buffer
 
+uniform layout(r11f_g11f_b10f) image3D source;        //lighting from the last iteration
+uniform layout(r11f_g11f_b10f) image3D destination;   //lighting for this iteration, built up one direction at a time
 
-uniform int y_index;   // what plane are we in
+uniform ivec2 direction;    // x and z steps of the lattice direction this pass handles - y always steps up by one
 uniform float scale_factor; // how much should you scale the hit cell's lighting by
 uniform float alpha_thresh; // what is the minimum threshold considered a 'hit' when tracing the GI rays
 uniform float sky_intensity; // if the ray escapes, how much light should it get?
+uniform vec3 sky_color;      // ...and what color is it?
 
-  // This has a sequential dependence, handled by how the shader is invoked - we don't need to worry about it in the shader
   // Context, from the same guy who did the Voxel Automata Terrain, Brent Werness:
   //   "Totally faked the GI!  It just casts out 9 rays in upwards facing the lattice directions.
   //    If it escapes it gets light from the sky, otherwise it gets some fraction of the light
   //    from whatever cell it hits.  Run from top to bottom and you are set!"
+  //
+  // Instead of running from top to bottom one plane at a time, compute_fake_GI() iterates the whole block at
+  // once: each iteration takes the lighting of the hit cells from the last one, so after n iterations light
+  // has bounced down chains n cells long - the contributions past that are scaled by scale_factor^n, so only a
+  // handful of iterations are needed. Each pass walks lines from the top down, carrying what a ray going up
+  // that line would see - the light of the nearest opaque cell above, or the sky if there isn't one - so the
+  // nearest hit along every line comes from one scan, rather than every cell searching for it on its own
+
+// these are injected by the shader preprocessor
+#ifndef PASS
+#define PASS 0  // 0 starts this iteration from the existing lighting, 1 adds another direction, 2 writes the result out
+#endif
+#ifndef SOURCE_IS_LIGHTING
+#define SOURCE_IS_LIGHTING 0  // the first iteration reads the hit cells' light straight from the lighting buffer
+#endif
+
+#include "include/light_scale.glsl"
+
+// the lines run through lighting cells - a cell is opaque if any voxel in it is, so thin walls still block
+bool opaque(ivec3 p)
+{
+  float alpha = 0.0;
+  for(int x = 0; x < LIGHT_SCALE; x++)
+  for(int y = 0; y < LIGHT_SCALE; y++)
+  for(int z = 0; z < LIGHT_SCALE; z++)
+    alpha = max(alpha, imageLoad(current, p * LIGHT_SCALE + ivec3(x, y, z)).a);
+  return alpha >= alpha_thresh;
+}
+
+vec3 hit_light(ivec3 p)
+{
+#if SOURCE_IS_LIGHTING
+  return imageLoad(lighting, p).rgb;
+#else
+  return imageLoad(source, p).rgb;
+#endif
+}
+
+// range of y that the line through offset o (where it would cross y = 0) spends inside the block, along one axis
+ivec2 y_range(int o, int d)
+{
+  if(d == 0)
+    return (o >= 0 && o < LIGHT_DIM) ? ivec2(0, LIGHT_DIM - 1) : ivec2(0, -1);
+  if(d > 0)
+    return ivec2(max(0, -o), min(LIGHT_DIM - 1, LIGHT_DIM - 1 - o));
+  return ivec2(max(0, o - (LIGHT_DIM - 1)), min(LIGHT_DIM - 1, o));
+}
 
 void main()
 {
-    ivec3 my_loc = ivec3(gl_GlobalInvocationID.x, y_index, gl_GlobalInvocationID.z);
-    ivec3 check_loc = ivec3(0);
+  // lines are numbered by where they cross y = 0, which can be outside of the block for the diagonal ones
+  ivec2 o = ivec2(gl_GlobalInvocationID.xy) - ivec2(LIGHT_DIM - 1) * max(direction, ivec2(0));
 
-    vec4 prev_light_val = imageLoad(lighting, my_loc);    //existing light value (how much light, stored in r)
-    vec4 prev_color_val = imageLoad(current, my_loc);    //existing color value (what is the color?)
+  ivec2 rx = y_range(o.x, direction.x);
+  ivec2 rz = y_range(o.y, direction.y);
+  int y_lo = max(rx.x, rz.x);
+  int y_hi = min(rx.y, rz.y);
 
-    float new_light_val = prev_light_val.r;
+  // a ray going up from the top of the line leaves the volume, whether that is through the top or a side
+  vec3 carry = sky_intensity * sky_color;
 
-    ivec3 imsize = imageSize(lighting);
+  for(int y = y_hi; y >= y_lo; y--)
+  {
+    ivec3 p = ivec3(o.x + direction.x * y, y, o.y + direction.y * y);
 
-    if(prev_color_val.a >= alpha_thresh) // this cell is opaque enough to participate
+    if(opaque(p)) // this cell is opaque enough to participate
     {
-        for(int dx = -1; dx <= 1; dx++)
-        {
-            for(int dz = -1; dz <= 1; dz++)
-            {
-                check_loc = ivec3(my_loc.x + dx, my_loc.y + 1, my_loc.z + dz);
-                bool hit = false;
-
-                while(check_loc.x >= 0 && check_loc.x < imsize.x && check_loc.z >= 0 && check_loc.z < imsize.z && check_loc.y < imsize.y)
-                {
-                    if(imageLoad(current, check_loc).a >= alpha_thresh)
-                    {
-                        // take some portion (determined by scale_factor) of the light from that location
-                        new_light_val = new_light_val + imageLoad(lighting, check_loc).r * scale_factor;
-
-                        hit = true;
-                        break;
-                    }
-                    check_loc.x += dx;
-                    check_loc.y += 1;
-                    check_loc.z += dz;
-                }
-
-                if(!hit)  // ray escaped the volume, use sky_intensity instead
-                {
-                    // take the light from the sky
-                    new_light_val = prev_light_val.r + sky_intensity; // should this take scale_factor as well?
-                }
-            }
-        }
-
-        imageStore(lighting, my_loc, vec4(new_light_val));
+#if PASS == 0
+      imageStore(destination, p, vec4(imageLoad(lighting, p).rgb + carry, 1.0));
+#elif PASS == 1
+      imageStore(destination, p, vec4(imageLoad(destination, p).rgb + carry, 1.0));
+#else
+      imageStore(lighting, p, vec4(hit_light(p), 1.0));
+#endif
+
+      // this is the cell the rays from below will hit - take some portion (determined by scale_factor) of its light
+      carry = scale_factor * hit_light(p);
     }
+  }
 }
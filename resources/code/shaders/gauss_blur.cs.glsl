@@ -1,65 +1,151 @@
 #version 430
 
-//note that this only effects what the parameters to glDispatchCompute are - by using gl_GlobalInvocationID, you don't need to worry what any of those numbers are
-layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
+// one axis of the separable gaussian blur - gaussian_blur() runs this three times over the mask (x, y, z), then
+// three times over color. Each workgroup loads rows of 64 texels along AXIS into shared memory, along with an
+// apron of radius texels on either side, so the taps are shared memory reads instead of imageLoads and the
+// cost per voxel grows linearly with radius instead of cubically. Each pass covers the box region_min..region_max,
+// which is the whole block unless there's a region of interest - then the x and y passes cover it grown by radius
+// across the axes still to come, since those passes read that far
+layout(local_size_x = 64, local_size_y = 4, local_size_z = 1) in;    //specifies the workgroup size
 
-uniform layout(rgba8) image3D previous;       //now-current values of the block
-uniform layout(r8) image3D previous_mask;  //now-current values of the mask
+// these are injected by the shader preprocessor
+#ifndef AXIS
+#define AXIS 0          //which axis this pass blurs along - the z pass is the last one, and writes the result
+#endif
+#ifndef MASK_PASS
+#define MASK_PASS 0     //blurring the mask (bit-packed in and out, through the scratch buffers) instead of color
+#endif
+#ifndef RESPECT_MASK
+#define RESPECT_MASK 1  //injected per variant - should the blur leave masked cells alone?
+#endif
+#ifndef TOUCH_ALPHA
+#define TOUCH_ALPHA 1   //injected per variant - should the blur change alpha too?
+#endif
+
+#define MAX_RADIUS 32
+#define ROW 64
+
+// the first mask pass reads the mask itself, the last one writes it - everything in between is rgba8 scratch
+#if MASK_PASS && AXIS == 0
+uniform layout(r32ui) uimage3D source;
+#else
+uniform layout(rgba8) image3D source;
+#endif
 
-uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D current_mask;   //values of the mask after the update
+#if MASK_PASS && AXIS == 2
+uniform layout(r32ui) uimage3D destination;
+#else
+uniform layout(rgba8) image3D destination;
+#endif
+
+#if AXIS == 2
+uniform layout(rgba8) image3D previous;       //now-current values of the block
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
+#endif
 
 uniform int radius;
-uniform bool respect_mask;
-uniform bool touch_alpha;
+uniform float weights[MAX_RADIUS + 1];  //weights[i] applies to the taps i texels away, normalized in the shader
 
-vec4 mask_true = vec4(1.0,0.0,0.0,0.0);
-vec4 mask_false = vec4(0.0,0.0,0.0,0.0);
+shared vec4 row[4][ROW + 2 * MAX_RADIUS];
+shared float inside[4][ROW + 2 * MAX_RADIUS];  //taps outside the block don't count, instead of counting as zero
+
+#include "include/mask.glsl"
+#if AXIS == 2
+#include "include/roi.glsl"
+#else
+#include "include/region.glsl"
+#endif
+
+// (position along the blur axis, position across it) -> position in the block
+ivec3 volume_position(int along, ivec2 across)
+{
+#if AXIS == 0
+  return ivec3(along, across.x, across.y);
+#elif AXIS == 1
+  return ivec3(across.x, along, across.y);
+#else
+  return ivec3(across.x, across.y, along);
+#endif
+}
+
+// the other way - the two positions across the blur axis
+ivec2 across_of(ivec3 p)
+{
+#if AXIS == 0
+  return p.yz;
+#elif AXIS == 1
+  return p.xz;
+#else
+  return p.xy;
+#endif
+}
+
+vec4 load(ivec3 p)
+{
+#if MASK_PASS && AXIS == 0
+  return MASK_READ(source, p) ? vec4(1.0, 0.0, 0.0, 0.0) : vec4(0.0);
+#else
+  return imageLoad(source, p);
+#endif
+}
 
 void main()
 {
-  bool pmask = (imageLoad(previous_mask, ivec3(gl_GlobalInvocationID.xyz)).r > 0.5);  //existing mask value (previous_mask = 0?)
-  vec4 pcol = imageLoad(previous, ivec3(gl_GlobalInvocationID.xyz));                 //existing color value (what is the previous color?)
+  int along = region_min[AXIS] + int(gl_GlobalInvocationID.x);
+  ivec2 across = across_of(region_min) + ivec2(gl_GlobalInvocationID.yz);
+  int r = int(gl_LocalInvocationID.y);
+  int size = DIM; // not imageSize(source) - a packed mask is narrower along x
 
-  if(pmask && respect_mask)
+  // fill this row, apron included
+  int first = region_min[AXIS] + int(gl_WorkGroupID.x) * ROW - radius;
+  for(int i = int(gl_LocalInvocationID.x); i < ROW + 2 * radius; i += ROW)
   {
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_true);
-    imageStore(current, ivec3(gl_GlobalInvocationID.xyz), pcol);
+    int a = first + i;
+    bool in_block = (a >= 0 && a < size);
+    row[r][i] = in_block ? load(volume_position(a, across)) : vec4(0);
+    inside[r][i] = in_block ? 1.0 : 0.0;
   }
-  else
+
+  barrier();
+
+  int center = int(gl_LocalInvocationID.x) + radius;
+  vec4 sum = vec4(0);
+  float total = 0.0;
+  for(int i = -radius; i <= radius; i++)
   {
-    float num = 0.0;
-    float numT = 0.0;
-
-    float weight;
-    float max_dist = distance(vec3(0), vec3(radius));
-
-    vec4 csum = vec4(0,0,0,0);
-    float msum = 0.0;
-
-    for(int x = (-1 * radius); x <= radius; x++)
-      for(int y = (-1 * radius); y <= radius; y++)
-        for(int z = (-1 * radius); z <= radius; z++)
-        {
-          weight = 1-(distance(vec3(0), vec3(x, y, z)));
-          csum += weight*imageLoad(previous, ivec3(gl_GlobalInvocationID.xyz) + ivec3(x,y,z));
-          msum += weight*((imageLoad(previous_mask, ivec3(gl_GlobalInvocationID.xyz) + ivec3(x,y,z)).r > 0.5) ? 1.0 : 0.0);
-          num  += weight;
-        }
-
-    //divide csum and msum by num
-    csum /= num;
-    msum /= num;
-
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), (msum > 0.5) ? mask_true : mask_false);
-
-    if(touch_alpha)
-    { //alpha will change to the average of the neighboring cells
-      imageStore(current, ivec3(gl_GlobalInvocationID.xyz), csum);
-    }
-    else
-    { //don't touch alpha, get the value from pcol
-      imageStore(current, ivec3(gl_GlobalInvocationID.xyz), vec4(csum.rgb, pcol.a));
-    }
+    float w = weights[abs(i)] * inside[r][center + i];
+    sum += w * row[r][center + i];
+    total += w;
   }
+  sum /= total;
+
+  ivec3 p = volume_position(along, across);
+#if AXIS == 2
+  if(!in_roi(p))
+    return;
+#else
+  if(!in_region(p))
+    return;
+#endif
+
+#if AXIS != 2
+  imageStore(destination, p, sum);
+#elif MASK_PASS
+  // cells end up masked where more than half of the weighted neighborhood was masked
+  bool masked = (sum.r > 0.5);
+#if RESPECT_MASK
+  masked = masked || MASK_READ(previous_mask, p);
+#endif
+  MASK_WRITE(destination, p, masked);
+#else
+  vec4 pcol = imageLoad(previous, p);
+#if RESPECT_MASK
+  if(MASK_READ(previous_mask, p)) //masked cells keep their color
+    sum = pcol;
+#endif
+#if !TOUCH_ALPHA //don't touch alpha, get the value from pcol
+  sum.a = pcol.a;
+#endif
+  imageStore(destination, p, sum);
+#endif
 }
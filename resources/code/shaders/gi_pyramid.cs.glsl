@@ -0,0 +1,79 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in; //3d workgroup
+
+// the radiance pyramid cone traced GI samples - premultiplied light leaving each texel (rgb) and its opacity (a),
+// with six tiles side by side along x, one for each direction a cone can be traveling through it (+x, -x, +y,
+// -y, +z, -z). compute_cone_GI() runs this once for the base level, then once per level of the mip chain
+
+// this is injected by the shader preprocessor
+#ifndef LEVEL0
+#define LEVEL0 0  // 1 fills the base level from the block and lighting, 0 builds a level from the one below it
+#endif
+
+uniform layout(rgba16f) image3D destination; //the level being built, all six tiles
+
+#if LEVEL0
+uniform layout(rgba8) image3D current;
+uniform layout(r11f_g11f_b10f) image3D lighting;
+#include "include/light_scale.glsl"
+#else
+uniform layout(rgba16f) image3D source;      //the level below, twice the size
+#endif
+
+void main()
+{
+    ivec3 size = imageSize(destination);
+    int res = size.y; // texels on a side of one tile
+    ivec3 q = ivec3(gl_GlobalInvocationID.xyz);
+    if(any(greaterThanEqual(q, ivec3(res))))
+        return;
+
+#if LEVEL0
+    // average over the voxels this texel covers - light leaving a voxel is its color, lit, times how much of the
+    // texel it fills. The base level is the same from every direction, so it goes in all six tiles
+    int cell = DIM / res;
+    vec4 sum = vec4(0);
+    for(int x = 0; x < cell; x++)
+    for(int y = 0; y < cell; y++)
+    for(int z = 0; z < cell; z++)
+    {
+        ivec3 v = q * cell + ivec3(x, y, z);
+        vec4 color = imageLoad(current, v);
+        vec3 light = imageLoad(lighting, v / LIGHT_SCALE).rgb;
+        sum += vec4(color.rgb * light * color.a, color.a);
+    }
+    sum /= float(cell * cell * cell);
+
+    for(int tile = 0; tile < 6; tile++)
+        imageStore(destination, q + ivec3(tile * res, 0, 0), sum);
+#else
+    // each tile combines its 2x2x2 children the way a cone going its direction sees them - the two along its axis
+    // are composited front to back, then the four pairs across it are averaged. So a wall facing the cone hides
+    // what's behind it at every level, rather than being averaged with it
+    for(int tile = 0; tile < 6; tile++)
+    {
+        int axis = tile / 2;
+        bool forward = (tile % 2) == 0;
+
+        ivec3 along = ivec3(0); along[axis] = 1;
+        ivec3 front_offset = forward ? ivec3(0) : along;
+        ivec3 back_offset = forward ? along : ivec3(0);
+
+        vec4 sum = vec4(0);
+        for(int i = 0; i < 4; i++)
+        {
+            ivec3 across = ivec3(0);
+            across[(axis + 1) % 3] = i % 2;
+            across[(axis + 2) % 3] = i / 2;
+
+            ivec3 child = 2 * q + across + ivec3(2 * res * tile, 0, 0);
+            vec4 front = imageLoad(source, child + front_offset);
+            vec4 back = imageLoad(source, child + back_offset);
+            sum += front + (1.0 - front.a) * back;
+        }
+
+        imageStore(destination, q + ivec3(tile * res, 0, 0), sum / 4.0);
+    }
+#endif
+}
@@ -0,0 +1,51 @@
+// cube map face math - the face selection table from the GL spec, and its inverse. Faces are numbered
+// +x, -x, +y, -y, +z, -z, the same as GL_TEXTURE_CUBE_MAP_POSITIVE_X and on
+
+// direction through the center of texel (x, y) of a cube face, res texels on a side
+vec3 cube_direction(ivec2 texel, int face, int res)
+{
+  vec2 st = 2.0 * (vec2(texel) + vec2(0.5)) / float(res) - vec2(1.0);
+
+  vec3 dir;
+  switch(face)
+  {
+    case 0:  dir = vec3( 1.0,  -st.y, -st.x); break; // +x
+    case 1:  dir = vec3(-1.0,  -st.y,  st.x); break; // -x
+    case 2:  dir = vec3( st.x,  1.0,   st.y); break; // +y
+    case 3:  dir = vec3( st.x, -1.0,  -st.y); break; // -y
+    case 4:  dir = vec3( st.x, -st.y,  1.0 ); break; // +z
+    default: dir = vec3(-st.x, -st.y, -1.0 ); break; // -z
+  }
+  return normalize(dir);
+}
+
+// which face a direction falls on, and where on that face (0-1 across, st)
+int cube_face(vec3 dir, out vec2 st)
+{
+  vec3 a = abs(dir);
+  int face;
+  vec2 sc;
+  float ma;
+
+  if(a.x >= a.y && a.x >= a.z)
+  {
+    face = (dir.x > 0.0) ? 0 : 1;
+    sc = vec2((dir.x > 0.0) ? -dir.z : dir.z, -dir.y);
+    ma = a.x;
+  }
+  else if(a.y >= a.z)
+  {
+    face = (dir.y > 0.0) ? 2 : 3;
+    sc = vec2(dir.x, (dir.y > 0.0) ? dir.z : -dir.z);
+    ma = a.y;
+  }
+  else
+  {
+    face = (dir.z > 0.0) ? 4 : 5;
+    sc = vec2((dir.z > 0.0) ? dir.x : -dir.x, -dir.y);
+    ma = a.z;
+  }
+
+  st = 0.5 * (sc / ma + vec2(1.0));
+  return face;
+}
@@ -0,0 +1,58 @@
+// ray-box intersection against the [-1,1] cube that holds the block, or a box inside of it - the including shader
+// defines MIN_DISTANCE and MAX_DISTANCE before including this, and reads the result out of tmin and tmax
+
+double tmin, tmax; //global scope, set in hit() to tell min and max parameters
+
+bool hit_box(vec3 org, vec3 dir, vec3 min, vec3 max)
+{
+  // hit() code adapted from:
+  //
+  //    Amy Williams, Steve Barrus, R. Keith Morley, and Peter Shirley
+  //    "An Efficient and Robust Ray-Box Intersection Algorithm"
+  //    Journal of graphics tools, 10(1):49-54, 2005
+
+  //an empty box - min past max - has nothing to hit
+  if(any(greaterThan(min, max)))
+    return false;
+
+  int sign[3];
+
+  vec3 inv_direction = vec3(1/dir.x, 1/dir.y, 1/dir.z);
+
+  sign[0] = (inv_direction[0] < 0)?1:0;
+  sign[1] = (inv_direction[1] < 0)?1:0;
+  sign[2] = (inv_direction[2] < 0)?1:0;
+
+  vec3 bbox[2] = {min,max};
+
+  tmin = (bbox[sign[0]][0] - org[0]) * inv_direction[0];
+  tmax = (bbox[1-sign[0]][0] - org[0]) * inv_direction[0];
+
+  double tymin = (bbox[sign[1]][1] - org[1]) * inv_direction[1];
+  double tymax = (bbox[1-sign[1]][1] - org[1]) * inv_direction[1];
+
+  if ( (tmin > tymax) || (tymin > tmax) )
+    return false;
+  if (tymin > tmin)
+    tmin = tymin;
+  if (tymax < tmax)
+    tmax = tymax;
+
+  double tzmin = (bbox[sign[2]][2] - org[2]) * inv_direction[2];
+  double tzmax = (bbox[1-sign[2]][2] - org[2]) * inv_direction[2];
+
+  if ( (tmin > tzmax) || (tzmin > tmax) )
+    return false;
+  if (tzmin > tmin)
+    tmin = tzmin;
+  if (tzmax < tmax)
+    tmax = tzmax;
+  return ( (tmin < MAX_DISTANCE) && (tmax > MIN_DISTANCE) );
+
+  return true;
+}
+
+bool hit(vec3 org, vec3 dir)
+{
+  return hit_box(org, dir, vec3(-1,-1,-1), vec3(1,1,1));
+}
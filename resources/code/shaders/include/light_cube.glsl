@@ -0,0 +1,24 @@
+// light cube - transmittance from a point light, stored by direction (a cube map) and by distance from the
+// light (one cube per shell, in a cube map array). light_cube.cs.glsl fills it in by marching one ray per
+// texel outward from the light, then the point and cone lights look each voxel up with a single fetch
+
+uniform int shells;           //how many distance shells there are
+uniform float shell_spacing;  //distance between shells, in voxels - shell 0 is at the light
+
+#include "cube.glsl"
+
+// transmittance from the light out to offset v (in voxels), interpolated between shells - the lookup is
+// pulled back toward the light by a cell, so cells don't shadow themselves (the old marcher skipped the
+// cell it was lighting, too)
+float light_cube_transmittance(samplerCubeArray cube, vec3 v)
+{
+  float d = length(v) - 1.0;
+  if(d <= 0.0)
+    return 1.0;
+
+  float shell = min(d / shell_spacing, float(shells - 1));
+  float below = floor(shell);
+  float above = min(below + 1.0, float(shells - 1));
+
+  return mix(texture(cube, vec4(v, below)).r, texture(cube, vec4(v, above)).r, shell - below);
+}
@@ -0,0 +1,74 @@
+// light list - point, cone and directional lights in a shader storage buffer, all evaluated together.
+// light_list_shadow.cs.glsl works out every light's transmittance at once into its own tile of the shadow
+// atlas, then light_list.cs.glsl adds up all the lights that reach each brick in a single pass.
+// LIGHT_LIST_MAX, LIGHT_LIST_RES and LIGHT_LIST_SHELLS are injected from includes.h
+
+#define POINT_LIGHT 0
+#define CONE_LIGHT 1
+#define DIRECTIONAL_LIGHT 2
+
+// matches light_t in gpu_data.h
+struct light
+{
+  vec4 position;    //xyz is the location (point, cone), w is the type
+  vec4 direction;   //xyz is the direction the light travels (cone, directional), w is the cone angle
+  vec4 parameters;  //intensity, decay power, distance power, range (0 for no limit)
+  vec4 shadow;      //x is the distance between shells in the light's tile, in voxels
+  vec4 color;       //rgb color of the light, w unused
+};
+
+layout(std430, binding = 0) buffer light_list
+{
+  light lights[];
+};
+
+uniform int num_lights;
+
+#include "cube.glsl"
+
+// each light's tile in the atlas is 3 x 2 cube faces of LIGHT_LIST_RES texels, by LIGHT_LIST_SHELLS deep.
+// Cube lights (point and cone) use all six faces, with depth being distance from the light. Directional
+// lights use the first 2 x 2 as an orthographic grid across the light, with depth being distance along it
+#define TILE_WIDTH (3 * LIGHT_LIST_RES)
+#define TILE_HEIGHT (2 * LIGHT_LIST_RES)
+
+// center and bounding radius of the block - directional lights cover this sphere
+const vec3 block_center = vec3(DIM / 2.0);
+const float block_radius = DIM * 0.8660254; // sqrt(3)/2
+
+// two vectors across a directional light, so that (u, v, dir) is an orthonormal basis
+void light_basis(vec3 dir, out vec3 u, out vec3 v)
+{
+  u = normalize(cross(dir, (abs(dir.y) < 0.99) ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+  v = cross(dir, u);
+}
+
+// where voxel p lands in light i's tile, in texels of the atlas - the depth is pulled back toward the light
+// by a cell, so cells don't shadow themselves. Cube lights need p to be at least a cell away from the light
+vec3 tile_position(int i, vec3 p)
+{
+  light l = lights[i];
+  vec2 across;
+  float depth;
+
+  if(int(l.position.w) == DIRECTIONAL_LIGHT)
+  {
+    vec3 u, v;
+    light_basis(l.direction.xyz, u, v);
+    vec3 q = p - block_center;
+    across = clamp((0.5 * vec2(dot(q, u), dot(q, v)) / block_radius + vec2(0.5)) * TILE_HEIGHT, vec2(0.5), vec2(TILE_HEIGHT - 0.5));
+    depth = dot(q, l.direction.xyz) + block_radius - 1.0;
+  }
+  else
+  {
+    vec2 st;
+    vec3 q = p - l.position.xyz;
+    int face = cube_face(q, st);
+    // clamped inside the face, so filtering doesn't pull from the face next to it in the tile
+    across = vec2(face % 3, face / 3) * LIGHT_LIST_RES + clamp(st * LIGHT_LIST_RES, vec2(0.5), vec2(LIGHT_LIST_RES - 0.5));
+    depth = length(q) - 1.0;
+  }
+
+  float shell = clamp(depth / l.shadow.x + 0.5, 0.5, LIGHT_LIST_SHELLS - 0.5);
+  return vec3(across + vec2(0, i * TILE_HEIGHT), shell);
+}
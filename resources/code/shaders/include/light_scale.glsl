@@ -0,0 +1,9 @@
+// the lighting buffer is LIGHT_SCALE times coarser than the block along each axis (LIGHT_SCALE is injected by the
+// shader preprocessor, like DIM) - each lighting cell stands for a LIGHT_SCALE^3 brick of voxels, lit at its center
+#define LIGHT_DIM (DIM / LIGHT_SCALE)
+
+// position of the center of lighting cell c, in voxels
+vec3 cell_center(ivec3 c)
+{
+  return (vec3(c) + vec3(0.5)) * float(LIGHT_SCALE) - vec3(0.5);
+}
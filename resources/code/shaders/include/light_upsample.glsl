@@ -0,0 +1,46 @@
+// lighting at voxel p, read back from the (possibly coarser) lighting buffer - trilinear between the eight
+// nearest lighting cells, except that each cell only counts as much as the way from p to it is clear, checked
+// halfway there. So a voxel next to a thin wall doesn't pick up light from the cell on the other side of it.
+// The block being looked through has to be declared as an image named LIGHT_GUIDE ahead of the include, or
+// LIGHT_GUIDE_AT(p) defined to read it some other way
+
+#include "light_scale.glsl"
+
+#ifndef LIGHT_GUIDE
+#define LIGHT_GUIDE current
+#endif
+#ifndef LIGHT_GUIDE_AT
+#define LIGHT_GUIDE_AT(p) imageLoad(LIGHT_GUIDE, p)
+#endif
+
+vec3 light_at(ivec3 p)
+{
+#if LIGHT_SCALE == 1
+  return imageLoad(lighting, p).rgb;
+#else
+  vec3 c = (vec3(p) + vec3(0.5)) / float(LIGHT_SCALE) - vec3(0.5); // p, in lighting cells
+  ivec3 base = ivec3(floor(c));
+  vec3 f = c - vec3(base);
+
+  vec3 sum = vec3(0.0), plain = vec3(0.0);
+  float total = 0.0;
+  for(int i = 0; i < 8; i++)
+  {
+    ivec3 o = ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+    ivec3 cell = clamp(base + o, ivec3(0), ivec3(LIGHT_DIM - 1));
+    vec3 w3 = mix(vec3(1.0) - f, f, vec3(o));
+    float w = w3.x * w3.y * w3.z;
+
+    ivec3 halfway = ivec3(round(0.5 * (vec3(p) + cell_center(cell))));
+    float clear = (halfway == p) ? 1.0 : 1.0 - LIGHT_GUIDE_AT(halfway).a;
+
+    vec3 l = imageLoad(lighting, cell).rgb;
+    sum += w * clear * l;
+    total += w * clear;
+    plain += w * l;
+  }
+
+  // boxed in on every side - nothing to go on, so fall back to plain trilinear
+  return (total > 0.001) ? sum / total : plain;
+#endif
+}
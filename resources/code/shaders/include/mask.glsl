@@ -0,0 +1,12 @@
+// the masks are bit-packed - 32 voxels along x share one uint, so a mask image is DIM/32 x DIM x DIM r32ui. A
+// voxel reads its bit out of the word, and writes set or clear it atomically, since the voxels that share a word
+// are written by different threads. Everything that can work on a whole word at once (invert, unmask) should
+
+#define MASK_WORD(p) ivec3((p).x >> 5, (p).y, (p).z)
+#define MASK_BIT(p) (1u << uint((p).x & 31))
+
+#define MASK_READ(image, p) ((imageLoad(image, MASK_WORD(p)).r & MASK_BIT(p)) != 0u)
+
+#define MASK_SET(image, p) imageAtomicOr(image, MASK_WORD(p), MASK_BIT(p))
+#define MASK_CLEAR(image, p) imageAtomicAnd(image, MASK_WORD(p), ~MASK_BIT(p))
+#define MASK_WRITE(image, p, value) ((value) ? MASK_SET(image, p) : MASK_CLEAR(image, p))
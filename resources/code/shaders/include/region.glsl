@@ -0,0 +1,40 @@
+// the part of the block a lighting operation is restricted to, inclusive - the whole block normally, or just
+// what needs relighting after an edit. Dispatches start at region_min and are rounded up to whole workgroups,
+// so anything past region_max is skipped
+uniform ivec3 region_min;
+uniform ivec3 region_max;
+
+// this is injected by the shader preprocessor
+#ifndef BRICK_LIST
+#define BRICK_LIST 0  //dispatched indirectly, one 8x8x8 workgroup per brick of the list brick_list.cs.glsl made?
+#endif
+
+#if BRICK_LIST
+#define BRICK_ROW 1024u   //BRICK_ROW in gpu_data.h
+
+layout(std430, binding = 7) readonly buffer brick_list
+{
+  uint brick_count;
+  uint brick_groups[3];
+  uint bricks[];
+};
+
+ivec3 region_position()
+{
+  uint i = gl_WorkGroupID.x + gl_WorkGroupID.y * BRICK_ROW;
+  if(i >= brick_count)
+    return ivec3(-1); // past the end of the list, on the last row - outside of any region
+  uint b = bricks[i];
+  return 8 * ivec3(b & 1023u, (b >> 10) & 1023u, b >> 20) + ivec3(gl_LocalInvocationID.xyz);
+}
+#else
+ivec3 region_position()
+{
+  return region_min + ivec3(gl_GlobalInvocationID.xyz);
+}
+#endif
+
+bool in_region(ivec3 p)
+{
+  return all(greaterThanEqual(p, region_min)) && all(lessThanEqual(p, region_max));
+}
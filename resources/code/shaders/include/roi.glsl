@@ -0,0 +1,18 @@
+// the region of interest of a utility operation - it's dispatched over the box region_min..region_max, in voxels,
+// which is the whole block unless a region of interest is set. With ROI_MASK, only the masked voxels in the box
+// are changed. previous_mask and mask.glsl have to be declared ahead of the include
+
+#include "region.glsl"
+
+#ifndef ROI_MASK
+#define ROI_MASK 0  //injected per variant - change only the masked voxels in the box?
+#endif
+
+bool in_roi(ivec3 p)
+{
+#if ROI_MASK
+  return in_region(p) && MASK_READ(previous_mask, p);
+#else
+  return in_region(p);
+#endif
+}
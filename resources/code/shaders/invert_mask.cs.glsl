@@ -4,27 +4,29 @@
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
 
 uniform layout(rgba8) image3D previous;       //now-current values of the block
-uniform layout(r8) image3D previous_mask;  //now-current values of the mask
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
 
 uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D current_mask;   //values of the mask after the update
+uniform layout(r32ui) uimage3D current_mask;  //values of the mask after the update
 
-vec4 mask_true = vec4(1.0,0.0,0.0,0.0);
-vec4 mask_false = vec4(0.0,0.0,0.0,0.0);
+#include "include/mask.glsl"
+#include "include/roi.glsl"
 
 void main()
 {
-  bool pmask = (imageLoad(previous_mask, ivec3(gl_GlobalInvocationID.xyz)).r > 0.5);  //existing mask value (previous_mask = 0?)
-  vec4 pcol = imageLoad(previous, ivec3(gl_GlobalInvocationID.xyz));                 //existing color value (what is the previous color?)
+  ivec3 p = region_position();
+  if(!in_region(p))
+    return;
+  imageStore(current, p, imageLoad(previous, p));  //color can't change as a result of this operation
 
-  if(pmask)
+  // the mask is done a word at a time - the first voxel of each word flips all 32 of its bits - except for the
+  // words the region of interest cuts through, or all of them when it's masked only, which go a voxel at a time
+  ivec3 word = ivec3(p.x & ~31, p.y, p.z);
+  if(ROI_MASK == 0 && in_region(word) && in_region(word + ivec3(31, 0, 0)))
   {
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_false);
-    imageStore(current, ivec3(gl_GlobalInvocationID.xyz), pcol);
-  }
-  else
-  {
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_true);
-    imageStore(current, ivec3(gl_GlobalInvocationID.xyz), pcol);
+    if((p.x & 31) == 0)
+      imageStore(current_mask, MASK_WORD(p), ~imageLoad(previous_mask, MASK_WORD(p)));
   }
+  else if(in_roi(p))
+    MASK_WRITE(current_mask, p, !MASK_READ(previous_mask, p));
 }
@@ -2,17 +2,23 @@
 
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in; //workgroup dimensions
 
-uniform layout(r8) image3D lighting;
-uniform layout(r8) image3D lighting_cache;
+uniform layout(r11f_g11f_b10f) image3D lighting;
+uniform layout(r11f_g11f_b10f) image3D lighting_cache;
 
 uniform float intensity;
 uniform bool use_cache;
 
+#include "include/region.glsl"
+
 void main()
 {
+	ivec3 p = region_position();
+	if(!in_region(p))
+		return;
+
 	if(use_cache)
-		imageStore(lighting, ivec3(gl_GlobalInvocationID.xyz), imageLoad(lighting_cache, ivec3(gl_GlobalInvocationID.xyz)));
+		imageStore(lighting, p, imageLoad(lighting_cache, p));
 	else
-   	imageStore(lighting, ivec3(gl_GlobalInvocationID.xyz), vec4(intensity));
+   	imageStore(lighting, p, vec4(vec3(intensity), 1.0));
 }
 
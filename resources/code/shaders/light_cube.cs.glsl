@@ -0,0 +1,76 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in; //one ray per texel, z picks the face
+
+uniform layout(rgba8) image3D current;
+uniform layout(r16f) imageCubeArray light_cube_image;  //layer-face 6 * shell + face
+
+uniform vec3 light_position;
+uniform float decay_power;
+uniform int cube_res;
+
+// cone lights only need the directions inside the cone - everything else is left fully lit, since the
+// cone test in the gather zeroes it anyway. A cone angle of pi or more covers every direction
+uniform float utheta;
+uniform float uphi;
+uniform float cone_angle;
+
+// marches from the light outward, writing the transmittance it has so far each time it crosses a shell,
+// so every ray from the light is traced once instead of once per voxel it reaches
+
+#include "include/rotation.glsl"
+
+#define MIN_DISTANCE 0.0
+#define MAX_DISTANCE 10000.0
+
+#include "include/hit.glsl"
+#include "include/light_cube.glsl"
+
+// the old per-voxel marcher took steps of this size in the [-1,1] space of the block - attenuation is
+// scaled to match it, so the same decay settings give the same look
+#define STEP 0.003
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    int face = int(gl_GlobalInvocationID.z);
+    vec3 dir = cube_direction(texel, face, cube_res);
+
+    // same axis as the cone gather - pointing the way the old directional light did
+    vec3 axis = vec3(0, 0, -1) * rotationMatrix(vec3(1,0,0), uphi) * rotationMatrix(vec3(0,1,0), utheta);
+    float margin = 4.0 / float(cube_res); // a couple texels, so the filtered lookup at the edge of the cone is right
+    bool needed = (abs(cone_angle) >= 3.14159) || (dot(dir, normalize(axis)) >= cos(abs(cone_angle) + margin));
+
+    // where this ray is inside the block, in voxels from the light
+    vec3 org = (vec3(2*light_position) - vec3(DIM)) / float(DIM);
+    bool inside = needed && hit(org, dir);
+    float enter = float(max(tmin, 0.0lf)) * DIM / 2.0;
+    float leave = float(tmax) * DIM / 2.0;
+
+    float step_length = STEP * DIM / 2.0;
+    float current_intensity = 1.0;
+
+    for(int i = 0; i < shells; i++)
+    {
+        imageStore(light_cube_image, ivec3(texel, 6 * i + face), vec4(current_intensity));
+
+        // the part of the segment out to the next shell that is inside the block
+        float start = max(i * shell_spacing, enter);
+        float end = min((i + 1) * shell_spacing, leave);
+
+        if(inside && end > start && current_intensity > 0.0)
+        {
+            int n = int(ceil((end - start) / step_length));
+            float len = (end - start) / float(n);
+
+            for(int j = 0; j < n; j++)
+            {
+                vec3 sample_location = light_position + dir * (start + (float(j) + 0.5) * len);
+
+                // decrement intensity with the value of alpha_sample, over the length of this step
+                float alpha_sample = imageLoad(current, ivec3(sample_location)).a;
+                current_intensity *= pow(1 - pow(alpha_sample, decay_power), len / step_length);
+            }
+        }
+    }
+}
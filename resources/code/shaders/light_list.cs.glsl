@@ -0,0 +1,95 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in; //one workgroup per 8x8x8 brick
+
+uniform layout(r11f_g11f_b10f) image3D lighting;
+uniform sampler3D shadow_atlas;  //every light's transmittance, built by light_list_shadow.cs.glsl
+
+// adds up every light in the list in one pass - the brick first works out which lights can reach it at
+// all, then each voxel only loops over those, and reads and writes the lighting buffer once
+
+#include "include/light_list.glsl"
+#include "include/region.glsl"
+#include "include/light_scale.glsl"
+
+shared int brick_lights[LIGHT_LIST_MAX];
+shared int brick_count;
+
+// can light l reach anything in the brick between lo and hi?
+bool reaches_brick(light l, vec3 lo, vec3 hi)
+{
+  if(l.parameters.x <= 0.0)
+    return false;
+
+  if(int(l.position.w) == DIRECTIONAL_LIGHT)
+    return true;
+
+  // out of range
+  vec3 nearest = clamp(l.position.xyz, lo, hi);
+  if(l.parameters.w > 0.0 && distance(nearest, l.position.xyz) > l.parameters.w)
+    return false;
+
+  // entirely outside of the cone - test the brick's bounding sphere against it
+  if(int(l.position.w) == CONE_LIGHT)
+  {
+    vec3 center = 0.5 * (lo + hi);
+    float radius = 0.5 * distance(lo, hi);
+    vec3 v = center - l.position.xyz;
+    float len = length(v);
+    if(len > radius && acos(clamp(dot(v / len, l.direction.xyz), -1.0, 1.0)) - asin(radius / len) > abs(l.direction.w))
+      return false;
+  }
+
+  return true;
+}
+
+// light i's contribution at voxel p
+vec3 contribution(int i, vec3 p)
+{
+  light l = lights[i];
+  vec3 intensity = l.parameters.x * l.color.rgb;
+
+  if(int(l.position.w) == DIRECTIONAL_LIGHT)
+    return intensity * texture(shadow_atlas, tile_position(i, p) / vec3(TILE_WIDTH, TILE_HEIGHT * LIGHT_LIST_MAX, LIGHT_LIST_SHELLS)).r;
+
+  vec3 v = p - l.position.xyz;
+  float len = length(v);
+
+  if(l.parameters.w > 0.0 && len > l.parameters.w)
+    return vec3(0.0);
+
+  if(int(l.position.w) == CONE_LIGHT && len > 0.0 && dot(v / len, l.direction.xyz) < cos(abs(l.direction.w)))
+    return vec3(0.0);
+
+  float transmittance = (len < 1.0) ? 1.0 : texture(shadow_atlas, tile_position(i, p) / vec3(TILE_WIDTH, TILE_HEIGHT * LIGHT_LIST_MAX, LIGHT_LIST_SHELLS)).r;
+
+  // this goes to 1 for distance_power = 0, otherwise models some approximation of the inverse square law
+  float lightdist = 2.0 * len / float(DIM); // measured in the [-1,1] space of the block, like the single lights
+  return intensity * transmittance / pow(lightdist, l.parameters.z);
+}
+
+void main()
+{
+  if(gl_LocalInvocationIndex == 0)
+    brick_count = 0;
+  barrier();
+
+  // one thread per light decides if it reaches this brick
+  ivec3 first = region_min + ivec3(gl_WorkGroupID.xyz * gl_WorkGroupSize);
+  vec3 lo = cell_center(first);
+  vec3 hi = cell_center(min(first + ivec3(gl_WorkGroupSize) - ivec3(1), region_max));
+  if(int(gl_LocalInvocationIndex) < num_lights && reaches_brick(lights[gl_LocalInvocationIndex], lo, hi))
+    brick_lights[atomicAdd(brick_count, 1)] = int(gl_LocalInvocationIndex);
+  barrier();
+
+  ivec3 p = region_position();
+  if(brick_count == 0 || !in_region(p))
+    return; // nothing reaches this brick, leave it alone
+  vec3 sum = vec3(0.0);
+  for(int i = 0; i < brick_count; i++)
+    sum += contribution(brick_lights[i], cell_center(p));
+
+  // add the lights to the previous value
+  vec3 prev_light = imageLoad(lighting, p).rgb; // the lighting value that was in the cell, before this operation
+  imageStore(lighting, p, vec4(prev_light + sum, 1.0));
+}
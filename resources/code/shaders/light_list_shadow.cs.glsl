@@ -0,0 +1,87 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in; //one ray per texel of a tile, z picks the light
+
+uniform layout(rgba8) image3D current;
+uniform layout(r16f) image3D shadow_atlas_image;  //every light's tile, stacked along y
+
+// one ray per texel of every light's tile, all in the same dispatch - each one marches away from its light
+// and writes the transmittance it has so far each time it crosses a shell, like light_cube.cs.glsl
+
+#define MIN_DISTANCE 0.0
+#define MAX_DISTANCE 10000.0
+
+#include "include/hit.glsl"
+#include "include/light_list.glsl"
+
+// the old per-voxel marcher took steps of this size in the [-1,1] space of the block - attenuation is
+// scaled to match it, so the same decay settings give the same look
+#define STEP 0.003
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    int i = int(gl_GlobalInvocationID.z);
+    light l = lights[i];
+
+    vec3 org, dir;
+    bool needed = true;
+
+    if(int(l.position.w) == DIRECTIONAL_LIGHT)
+    {
+        // parallel rays, starting on the far side of the block's bounding sphere
+        if(texel.x >= TILE_HEIGHT)
+            return; // the last column of faces isn't used
+
+        vec3 u, v;
+        dir = l.direction.xyz;
+        light_basis(dir, u, v);
+        vec2 ab = 2.0 * (vec2(texel) + vec2(0.5)) / TILE_HEIGHT - vec2(1.0);
+        org = block_center + block_radius * (ab.x * u + ab.y * v - dir);
+    }
+    else
+    {
+        // rays out from the light through each texel of the cube
+        int face = (texel.y / LIGHT_LIST_RES) * 3 + (texel.x / LIGHT_LIST_RES);
+        dir = cube_direction(texel % LIGHT_LIST_RES, face, LIGHT_LIST_RES);
+        org = l.position.xyz;
+
+        // cone lights only need the directions inside the cone, plus a couple texels for filtering
+        if(int(l.position.w) == CONE_LIGHT)
+            needed = dot(dir, l.direction.xyz) >= cos(abs(l.direction.w) + 4.0 / LIGHT_LIST_RES);
+    }
+
+    // where this ray is inside the block, in voxels from its origin
+    bool inside = needed && hit((vec3(2 * org) - vec3(DIM)) / float(DIM), dir);
+    float enter = float(max(tmin, 0.0lf)) * DIM / 2.0;
+    float leave = float(tmax) * DIM / 2.0;
+
+    float decay_power = l.parameters.y;
+    float spacing = l.shadow.x;
+    float step_length = STEP * DIM / 2.0;
+    float current_intensity = 1.0;
+
+    for(int k = 0; k < LIGHT_LIST_SHELLS; k++)
+    {
+        imageStore(shadow_atlas_image, ivec3(texel.x, texel.y + i * TILE_HEIGHT, k), vec4(current_intensity));
+
+        // the part of the segment out to the next shell that is inside the block
+        float start = max(k * spacing, enter);
+        float end = min((k + 1) * spacing, leave);
+
+        if(inside && end > start && current_intensity > 0.0)
+        {
+            int n = int(ceil((end - start) / step_length));
+            float len = (end - start) / float(n);
+
+            for(int j = 0; j < n; j++)
+            {
+                vec3 sample_location = org + dir * (start + (float(j) + 0.5) * len);
+
+                // decrement intensity with the value of alpha_sample, over the length of this step
+                float alpha_sample = imageLoad(current, ivec3(sample_location)).a;
+                current_intensity *= pow(1 - pow(alpha_sample, decay_power), len / step_length);
+            }
+        }
+    }
+}
@@ -3,15 +3,36 @@
 //note that this only effects what the parameters to glDispatchCompute are - by using gl_GlobalInvocationID, you don't need to worry what any of those numbers are
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
 
+uniform layout(rgba8) image3D previous;       //now-current values of the block
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
+
 uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D lighting;        //values held in the lighting buffer
+uniform layout(r32ui) uimage3D current_mask;  //values of the mask after the update
+
+uniform layout(r11f_g11f_b10f) image3D lighting;        //values held in the lighting buffer
+
+#define LIGHT_GUIDE previous
+#include "include/light_upsample.glsl"
+#include "include/mask.glsl"
+
+// dispatched over the bricks with anything in them - everywhere else, the color is zero and stays zero, so the
+// block is changed in place there instead of swapped
+#include "include/roi.glsl"
 
 void main()
 {
-    vec4 color = imageLoad(current, ivec3(gl_GlobalInvocationID.xyz));    //existing color value (what is the color?)
-    vec4 light = imageLoad(lighting, ivec3(gl_GlobalInvocationID.xyz));    //existing light value
+    ivec3 p = region_position();
+    if(!in_roi(p))
+        return;
+
+    vec4 color = imageLoad(previous, p);   //existing color value (what is the color?)
+    vec3 light = light_at(p);               //existing light value
+
+    color.rgb *= (5*light);  //same scaling as in the display shader
 
-    color.rgb *= (5*light.r);  //same scaling as in the display shader
+    imageStore(current, p, color);
 
-    imageStore(current, ivec3(gl_GlobalInvocationID.xyz), color);
+    // the mask comes along unchanged, a word at a time
+    if((p.x & 31) == 0)
+        imageStore(current_mask, MASK_WORD(p), imageLoad(previous_mask, MASK_WORD(p)));
 }
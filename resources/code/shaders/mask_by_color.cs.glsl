@@ -4,12 +4,12 @@
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
 
 uniform layout(rgba8) image3D previous;       //now-current values of the block
-uniform layout(r8) image3D previous_mask;  //now-current values of the mask
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
 
 uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D current_mask;   //values of the mask after the update
+uniform layout(r32ui) uimage3D current_mask;  //values of the mask after the update
 
-uniform layout(r8) image3D lighting; //lighting values
+uniform layout(r11f_g11f_b10f) image3D lighting; //lighting values
 
 //these variables express whether or not each channel is being used
 uniform bool use_r;
@@ -29,14 +29,20 @@ uniform float b_var;
 uniform float a_var;
 uniform float l_var;
 
-vec4 mask_true = vec4(1.0,0.0,0.0,0.0);
-vec4 mask_false = vec4(0.0,0.0,0.0,0.0);
+#define LIGHT_GUIDE previous
+#include "include/light_upsample.glsl"
+
+#include "include/mask.glsl"
+#include "include/roi.glsl"
 
 void main()
 {
-  vec4 pcol = imageLoad(previous, ivec3(gl_GlobalInvocationID.xyz));                 //existing color value (what is the previous color?)
-  vec4 pmask = imageLoad(previous_mask, ivec3(gl_GlobalInvocationID.xyz));          // this is the value of the mask before this function was called
-  vec4 light = imageLoad(lighting, ivec3(gl_GlobalInvocationID.xyz));  
+  ivec3 p = region_position();
+  if(!in_roi(p))
+    return;
+
+  vec4 pcol = imageLoad(previous, p);  //existing color value (what is the previous color?)
+  vec3 light = light_at(p);
 
   bool do_we_mask = false;
   //the logic is relatively simple - if the color matches the criteria, mask it
@@ -54,13 +60,13 @@ void main()
       do_we_mask = true;
 
 
-  if(use_l && abs(l_val - light.r) < l_var)
+  if(use_l && abs(l_val - dot(light, vec3(0.2126, 0.7152, 0.0722))) < l_var) // luminance of the light
       do_we_mask = true;
 
 
-  imageStore(current, ivec3(gl_GlobalInvocationID.xyz), pcol); //color can't change as a result of this operation
+  imageStore(current, p, pcol); //color can't change as a result of this operation
   if(do_we_mask)
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_true);
+    MASK_SET(current_mask, p);
   else
-    imageStore(current_mask, ivec3(gl_GlobalInvocationID.xyz), mask_false);
+    MASK_CLEAR(current_mask, p);
 }
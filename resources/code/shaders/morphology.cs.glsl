@@ -0,0 +1,65 @@
+#version 430
+
+//note that this only effects what the parameters to glDispatchCompute are - by using gl_GlobalInvocationID, you don't need to worry what any of those numbers are
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
+
+uniform layout(rgba8) image3D previous;       //now-current values of the block
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
+
+uniform layout(rgba8) image3D current;        //values of the block after the update
+uniform layout(r32ui) uimage3D current_mask;  //values of the mask after the update
+
+uniform layout(r16f) image3D distance_field;  //signed distance to the surface, from the previous block
+uniform layout(r32ui) uimage3D seeds;         //the nearest surface voxel to each voxel, from the same jump flood
+
+uniform float radius;
+uniform float alpha_threshold;
+
+// dilate and erode against the distance field - dilating fills the empty voxels closer than radius to the
+// surface with the color of the surface voxel nearest them, eroding clears the solid ones closer than radius
+// to it. Opening and closing are one and then the other, with the distance field rebuilt in between
+
+// these are injected by the shader preprocessor
+#ifndef ERODE
+#define ERODE 0         //0 dilates, 1 erodes
+#endif
+#ifndef RESPECT_MASK
+#define RESPECT_MASK 1  //should masked cells be left alone?
+#endif
+
+#include "include/mask.glsl"
+#include "include/roi.glsl"
+
+void main()
+{
+  ivec3 p = region_position();
+  if(!in_roi(p))
+    return;
+  bool pmask = MASK_READ(previous_mask, p);  //existing mask value (previous_mask = 0?)
+  vec4 pcol = imageLoad(previous, p);        //existing color value (what is the previous color?)
+  float d = imageLoad(distance_field, p).r;
+
+  vec4 result = pcol;
+#if ERODE
+  if(pcol.a > alpha_threshold && d > -radius)
+    result = vec4(0);
+#else
+  uint s = imageLoad(seeds, p).r;
+  if(pcol.a <= alpha_threshold && d < radius && s != 0xFFFFFFFFu)
+    result = imageLoad(previous, ivec3(s & 1023u, (s >> 10) & 1023u, (s >> 20) & 1023u));
+#endif
+
+#if RESPECT_MASK
+  if(pmask) //masked cells keep their color
+    result = pcol;
+#endif
+
+  imageStore(current, p, result);
+
+  // the mask doesn't change - it's copied a word at a time, by the first voxel of each word. With a region of
+  // interest this is in place, and the mask is already there
+#if ROI_MASK == 0
+  if((p.x & 31) == 0 && region_min == ivec3(0) && region_max == ivec3(DIM - 1))
+    imageStore(current_mask, MASK_WORD(p), imageLoad(previous_mask, MASK_WORD(p)));
+#endif
+}
@@ -1,163 +1,109 @@
 #version 430
 
-layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in; //3d workgroup
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in; //one plane of the sweep at a time
 
 uniform layout(rgba8) image3D current;
-uniform layout(r8) image3D lighting;
+uniform layout(r11f_g11f_b10f) image3D lighting;
+uniform layout(r32f) image3D transmittance; //how much light is left after passing through each cell
 
-uniform float utheta;
-uniform float uphi;
+uniform vec3 light_direction;  //the direction the light travels, normalized - the CPU plans the sweep from it too
 
-uniform float light_dim;
 uniform float light_intensity;
+uniform vec3 light_color;
 
 uniform float decay_power;
 
-// this refit of the directional lighting function is going to be the basis for the point light function
-// the goal is to reduce the artifacts that come from the regular spacing of the 2d grid ('lightmap') causing 
-// weird aliasing when they hit the different faces of the voxel block.
+uniform int sweep_step; //how many planes have been lit so far - this invocation lights the next one
+uniform ivec2 sweep_min; //the part of this plane that is swept, across the other two axes - all of it, unless
+uniform ivec2 sweep_max; // only a region is being relit (then it's that region, plus what it reads upstream)
+uniform ivec2 previous_min; //the part of the previous plane that was swept - reads past its edge clamp to it
+uniform ivec2 previous_max;
 
+// directional light as a sweep - compute_new_directional_lighting() dispatches this once per plane along
+// the axis the light mostly travels along, starting at the side it comes in from. Each cell finds where
+// its light ray crossed the previous plane, takes the transmittance there (bilinear, since the ray can
+// cross anywhere between cells), adds the light and then attenuates it by its own alpha for the next
+// plane. So every cell is touched once, instead of each one marching its own ray through the block.
 
+#include "include/region.glsl"
+#include "include/light_scale.glsl"
 
-//thanks to Neil Mendoza via http://www.neilmendoza.com/glsl-rotation-about-an-arbitrary-axis/
-mat3 rotationMatrix(vec3 axis, float angle)
-{
-    axis = normalize(axis);
-    float s = sin(angle);
-    float c = cos(angle);
-    float oc = 1.0 - c;
-
-    return mat3(oc * axis.x * axis.x + c,           oc * axis.x * axis.y - axis.z * s,  oc * axis.z * axis.x + axis.y * s,
-                oc * axis.x * axis.y + axis.z * s,  oc * axis.y * axis.y + c,           oc * axis.y * axis.z - axis.x * s,
-                oc * axis.z * axis.x - axis.y * s,  oc * axis.y * axis.z + axis.x * s,  oc * axis.z * axis.z + c);
-}
-
-double tmin, tmax; //global scope, set in hit() to tell min and max parameters
+// the old per-voxel marcher took steps of this size in the [-1,1] space of the block - attenuation per
+// cell is scaled to match it, so the same decay settings give the same look
+#define STEP 0.003
 
-#define NUM_STEPS 5000
-#define MIN_DISTANCE -10000.0
-#define MAX_DISTANCE 10000.0
-
-bool hit(vec3 org, vec3 dir)
+// transmittance of the previous plane at (fractional) position q across it - anything outside of the
+// block has not been blocked by anything, so it reads as fully lit
+float transmittance_at(ivec3 axes, int plane, ivec2 q)
 {
-  // hit() code adapted from:
-  //
-  //    Amy Williams, Steve Barrus, R. Keith Morley, and Peter Shirley
-  //    "An Efficient and Robust Ray-Box Intersection Algorithm"
-  //    Journal of graphics tools, 10(1):49-54, 2005
-
-  //the bounding box
-  vec3 min = vec3(-1,-1,-1);
-  vec3 max = vec3(1,1,1);
-
-  int sign[3];
-
-  vec3 inv_direction = vec3(1/dir.x, 1/dir.y, 1/dir.z);
-
-  sign[0] = (inv_direction[0] < 0)?1:0;
-  sign[1] = (inv_direction[1] < 0)?1:0;
-  sign[2] = (inv_direction[2] < 0)?1:0;
-
-  vec3 bbox[2] = {min,max};
+    if(any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, ivec2(LIGHT_DIM))))
+        return 1.0;
 
-  tmin = (bbox[sign[0]][0] - org[0]) * inv_direction[0];
-  tmax = (bbox[1-sign[0]][0] - org[0]) * inv_direction[0];
+    q = clamp(q, previous_min, previous_max);
 
-  double tymin = (bbox[sign[1]][1] - org[1]) * inv_direction[1];
-  double tymax = (bbox[1-sign[1]][1] - org[1]) * inv_direction[1];
-
-  if ( (tmin > tymax) || (tymin > tmax) )
-    return false;
-  if (tymin > tmin)
-    tmin = tymin;
-  if (tymax < tmax)
-    tmax = tymax;
-
-  double tzmin = (bbox[sign[2]][2] - org[2]) * inv_direction[2];
-  double tzmax = (bbox[1-sign[2]][2] - org[2]) * inv_direction[2];
-
-  if ( (tmin > tzmax) || (tzmin > tmax) )
-    return false;
-  if (tzmin > tmin)
-    tmin = tzmin;
-  if (tzmax < tmax)
-    tmax = tzmax;
-  return ( (tmin < MAX_DISTANCE) && (tmax > MIN_DISTANCE) );
-
-  return true;
+    ivec3 p;
+    p[axes.x] = plane;
+    p[axes.y] = q.x;
+    p[axes.z] = q.y;
+    return imageLoad(transmittance, p).r;
 }
 
-
-void traceray(vec3 dir)
+float previous_plane(ivec3 axes, int plane, vec2 q)
 {
-	// the location you need to consider is specified by gl_GlobalInvocationID
+    ivec2 base = ivec2(floor(q));
+    vec2 f = q - vec2(base);
 
-    vec3 org = (vec3(2*gl_GlobalInvocationID.xyz) - vec3(imageSize(lighting).x)) / imageSize(lighting).x;
-
-    hit(org, dir); // we now have tmin and tmax set - tmin will be negative and will tell where the first intersection with the block is
-
-    float current_t = float(tmin);
-    float current_intensity = light_intensity; // the strength of the light, before traversing any of the volume
+    return mix(mix(transmittance_at(axes, plane, base),              transmittance_at(axes, plane, base + ivec2(1, 0)), f.x),
+               mix(transmittance_at(axes, plane, base + ivec2(0, 1)), transmittance_at(axes, plane, base + ivec2(1, 1)), f.x), f.y);
+}
 
-    float prev_intensity = imageLoad(lighting, ivec3(gl_GlobalInvocationID.xyz)).r; // the lighting value that was in the cell, before this operation
+void main()
+{
+    vec3 dir = light_direction;
 
-    ivec3 sample_location;
-    float alpha_sample;
+    // the light travels along dir - sweep along its dominant axis, the other two are across the planes
+    vec3 a = abs(dir);
+    int k = (a.x >= a.y && a.x >= a.z) ? 0 : ((a.y >= a.z) ? 1 : 2);
+    ivec3 axes = ivec3(k, (k + 1) % 3, (k + 2) % 3);
 
+    int back = (dir[k] > 0.0) ? -1 : 1; // direction of the previous plane, toward the light
+    int plane = (dir[k] > 0.0) ? sweep_step : (LIGHT_DIM - 1 - sweep_step);
 
+    ivec2 q = sweep_min + ivec2(gl_GlobalInvocationID.xy);
+    if(any(greaterThan(q, sweep_max)))
+        return;
 
-    // float step = float((tmax-tmin))/NUM_STEPS;
-    float step = 0.003; // uniform step seems to fit better here
+    ivec3 p;
+    p[axes.x] = plane;
+    p[axes.y] = q.x;
+    p[axes.z] = q.y;
 
+    // the ray through this cell's center crossed the previous plane offset by at most one cell
+    vec2 offset = -vec2(dir[axes.y], dir[axes.z]) / a[k];
+    float current_intensity = (sweep_step == 0) ? 1.0 : previous_plane(axes, plane + back, vec2(q) + offset);
 
-    for(int i = 0; i < NUM_STEPS; i++)
+    // add the light that reached this cell to the previous intensity - the cell's own alpha doesn't shade it.
+    // Cells outside of the region are only swept for the transmittance the region needs from them
+    if(in_region(p))
     {
-        if(current_t < 0 && current_intensity > 0)
-        {
-            // new sample location
-            sample_location = ivec3((vec3(imageSize(lighting))/2.0f)*(org+current_t*dir+vec3(1)));
-
-            if(sample_location == ivec3(gl_GlobalInvocationID.xyz))
-                break;
-
-            // new read for the alpha_sample
-            alpha_sample = imageLoad(current, sample_location).a;
-
-            // decrement intensity with the value of alpha_sample
-            current_intensity *= 1-pow(alpha_sample, decay_power);
-
-            // increment t with the step
-            current_t += step;
-
-        }
-        else
-        {
-            break;
-        }
+        vec3 prev_light = imageLoad(lighting, p).rgb; // the lighting value that was in the cell, before this operation
+        imageStore(lighting, p, vec4(prev_light + light_color * light_intensity * current_intensity, 1.0));
     }
 
-    // add the current_intensity to the previous intensity
-    current_intensity += prev_intensity;
-    imageStore(lighting, ivec3(gl_GlobalInvocationID.xyz), vec4(current_intensity));
-
+    // decrement intensity with the alpha of this cell, over the length of the ray inside it. A lighting cell can
+    // cover a brick of voxels - their absorption is averaged as optical depth (the log of what each one lets
+    // through), so a wall across the brick still blocks all of the light rather than being averaged away
+    float samples = (1.0 / a[k]) / (STEP * DIM / 2.0); // per voxel of path
+#if LIGHT_SCALE == 1
+    current_intensity *= pow(1 - pow(imageLoad(current, p).a, decay_power), samples);
+#else
+    float depth = 0.0;
+    for(int x = 0; x < LIGHT_SCALE; x++)
+    for(int y = 0; y < LIGHT_SCALE; y++)
+    for(int z = 0; z < LIGHT_SCALE; z++)
+      depth += log(max(1 - pow(imageLoad(current, p * LIGHT_SCALE + ivec3(x, y, z)).a, decay_power), 1e-6));
+    current_intensity *= exp(depth / float(LIGHT_SCALE * LIGHT_SCALE) * samples);
+#endif
+
+    imageStore(transmittance, p, vec4(current_intensity));
 }
-
-
-void main()
-{
-
-	// dir calculation is the same as the old directional lighting shader, which is in turn the same as the display shader
-    vec3 dir = vec3(   0,    0, -1); //simply a vector pointing in the opposite direction, no xy offsets
-
-    // rotate dir vector 'up' by phi, e.g. about the x axis
-    mat3 rotphi = rotationMatrix(vec3(1,0,0), uphi);
-    dir *= rotphi;
-
-    // rotate about the y axis by theta
-    mat3 rottheta = rotationMatrix(vec3(0,1,0), utheta);
-    dir *= rottheta;
-
-	 // this is all the information traceray needs, the direction from which the light is coming
-	 traceray(dir);
-}
-
@@ -2,26 +2,15 @@
 
 layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;    //specifies the workgroup size
 
-//thanks to Neil Mendoza via http://www.neilmendoza.com/glsl-rotation-about-an-arbitrary-axis/
-mat3 rotationMatrix(vec3 axis, float angle)
-{
-    axis = normalize(axis);
-    float s = sin(angle);
-    float c = cos(angle);
-    float oc = 1.0 - c;
-
-    return mat3(oc * axis.x * axis.x + c,           oc * axis.x * axis.y - axis.z * s,  oc * axis.z * axis.x + axis.y * s,
-                oc * axis.x * axis.y + axis.z * s,  oc * axis.y * axis.y + c,           oc * axis.y * axis.z - axis.x * s,
-                oc * axis.z * axis.x - axis.y * s,  oc * axis.y * axis.z + axis.x * s,  oc * axis.z * axis.z + c);
-}
-
-double tmin, tmax; //global scope, set in hit() to tell min and max parameters
+#include "include/rotation.glsl"
 
 // #define NUM_STEPS 2000
 //#define NUM_STEPS 165
 
 // #define NUM_STEPS 500
+#ifndef NUM_STEPS
 #define NUM_STEPS 780
+#endif
 #define MIN_DISTANCE 0.0
 #define MAX_DISTANCE 5.0
 
@@ -29,7 +18,7 @@ double tmin, tmax; //global scope, set in hit() to tell min and max parameters
 // the display texture
 uniform layout(rgba16) image2D current; // we can get the dimensions with imageSize
 uniform layout(rgba8) image3D block;
-uniform layout(r8) image3D lighting;
+uniform layout(r11f_g11f_b10f) image3D lighting;
 
 // samplers
 // uniform sampler3D block;
@@ -55,63 +44,33 @@ uniform float scale;
 uniform float upow;
 
 
-bool hit(vec3 org, vec3 dir)
-{
-  // hit() code adapted from:
-  //
-  //    Amy Williams, Steve Barrus, R. Keith Morley, and Peter Shirley
-  //    "An Efficient and Robust Ray-Box Intersection Algorithm"
-  //    Journal of graphics tools, 10(1):49-54, 2005
-
-  //the bounding box
-  vec3 min = vec3(-1,-1,-1);
-  vec3 max = vec3(1,1,1);
-
-  int sign[3];
-
-  vec3 inv_direction = vec3(1/dir.x, 1/dir.y, 1/dir.z);
+uniform ivec3 block_offset;  //a virtual shift - the block is stored shifted back by this much, looping around
 
-  sign[0] = (inv_direction[0] < 0)?1:0;
-  sign[1] = (inv_direction[1] < 0)?1:0;
-  sign[2] = (inv_direction[2] < 0)?1:0;
+uniform vec3 content_min;   //a box around everything that's in the block, in the same space as the cube - rays
+uniform vec3 content_max;   //that miss it see nothing, and the rest only march through it
 
-  vec3 bbox[2] = {min,max};
 
-  tmin = (bbox[sign[0]][0] - org[0]) * inv_direction[0];
-  tmax = (bbox[1-sign[0]][0] - org[0]) * inv_direction[0];
+#include "include/hit.glsl"
 
-  double tymin = (bbox[sign[1]][1] - org[1]) * inv_direction[1];
-  double tymax = (bbox[1-sign[1]][1] - org[1]) * inv_direction[1];
-
-  if ( (tmin > tymax) || (tymin > tmax) )
-    return false;
-  if (tymin > tmin)
-    tmin = tymin;
-  if (tymax < tmax)
-    tmax = tymax;
-
-  double tzmin = (bbox[sign[2]][2] - org[2]) * inv_direction[2];
-  double tzmax = (bbox[1-sign[2]][2] - org[2]) * inv_direction[2];
-
-  if ( (tmin > tzmax) || (tzmin > tmax) )
-    return false;
-  if (tzmin > tmin)
-    tmin = tzmin;
-  if (tzmax < tmax)
-    tmax = tzmax;
-  return ( (tmin < MAX_DISTANCE) && (tmax > MIN_DISTANCE) );
-
-  return true;
+// the voxel that shows up at p - nothing outside of the block, and the shift undone inside of it
+vec4 block_at(ivec3 p)
+{
+  if(any(lessThan(p, ivec3(0))) || any(greaterThanEqual(p, ivec3(DIM))))
+    return vec4(0);
+  return imageLoad(block, (p - block_offset + DIM) % DIM);
 }
 
-vec4 get_color_for_pixel(vec3 org, vec3 dir)
+#define LIGHT_GUIDE_AT(p) block_at(p)
+#include "include/light_upsample.glsl"
+
+// step is what NUM_STEPS makes of the ray's way through the whole cube, so a smaller box takes fewer of them
+vec4 get_color_for_pixel(vec3 org, vec3 dir, float step)
 {
   float current_t = float(tmax);
   //vec4 t_color = vec4(1, 1, 1, 0);
 
   vec4 t_color = clear_color;
 
-  float step = float((tmax-tmin))/NUM_STEPS;
   if(step < 0.001f)
     step = 0.001f;
     
@@ -119,30 +78,26 @@ vec4 get_color_for_pixel(vec3 org, vec3 dir)
 
   ivec3 samp = ivec3((block_size/2.0f)*(org+current_t*dir+vec3(1)));
 
-  vec4 new_read = imageLoad(block,samp);
-  vec4 new_light_read = imageLoad(lighting,samp);
+  vec4 new_read = block_at(samp);
 
   float alpha_squared;
 
-  for(int i = 0; i < NUM_STEPS; i++)
+  for(int i = 0; i < NUM_STEPS && current_t >= tmin; i++)
   {
-    if(current_t>=tmin)
-    {
-      //apply the lighting scaling
-      new_read.rgb *= (4*new_light_read.r);
+    //apply the lighting scaling - only where there's something to see, since the lookup isn't free
+    if(new_read.a > 0.0)
+      new_read.rgb *= (4*light_at(samp));
 
 		alpha_squared = pow(new_read.a, upow); // parameterizing the alpha power
 
-      // it's a over b, where a is the new sample and b is the current color, t_color
-      t_color.rgb = new_read.rgb * alpha_squared + t_color.rgb * t_color.a * ( 1 - alpha_squared );
-      t_color.a = alpha_squared + t_color.a * ( 1 - alpha_squared );
+    // it's a over b, where a is the new sample and b is the current color, t_color
+    t_color.rgb = new_read.rgb * alpha_squared + t_color.rgb * t_color.a * ( 1 - alpha_squared );
+    t_color.a = alpha_squared + t_color.a * ( 1 - alpha_squared );
 
-      current_t -= step;
-      samp = ivec3((block_size/2.0f)*(org+current_t*dir+vec3(1)));
+    current_t -= step;
+    samp = ivec3((block_size/2.0f)*(org+current_t*dir+vec3(1)));
 
-      new_read = imageLoad(block,samp);
-      new_light_read = imageLoad(lighting,samp);
-    }
+    new_read = block_at(samp);
   }
   return t_color;
 }
@@ -176,7 +131,11 @@ void main()
 	{  // we are good to check the ray against the AABB
 		if(hit(org,dir))
 		{
-			imageStore(current, Global_Loc, get_color_for_pixel(org, dir));
+			float step = float((tmax-tmin))/NUM_STEPS;
+			if(hit_box(org, dir, content_min, content_max))
+				imageStore(current, Global_Loc, get_color_for_pixel(org, dir, step));
+			else
+				imageStore(current, Global_Loc, clear_color);
 		}
 		else
 		{
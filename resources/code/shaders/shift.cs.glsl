@@ -4,37 +4,43 @@
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //specifies the workgroup size
 
 uniform layout(rgba8) image3D previous;       //now-current values of the block
-uniform layout(r8) image3D previous_mask;  //now-current values of the mask
+uniform layout(r32ui) uimage3D previous_mask;  //now-current values of the mask
 
 uniform layout(rgba8) image3D current;        //values of the block after the update
-uniform layout(r8) image3D current_mask;   //values of the mask after the update
+uniform layout(r32ui) uimage3D current_mask;  //values of the mask after the update
 
-uniform layout(r8) image3D lighting;  //wanted to make the lighting buffer shift with the
+uniform layout(r11f_g11f_b10f) image3D lighting;  //wanted to make the lighting buffer shift with the
 // color buffer, but to do that I'm going to need a second lighting buffer
 
 uniform ivec3 movement;     //how much are you moving this current cell by? 
-uniform bool loop;          //does the data loop off the sides (toroid style)
-uniform int mode;           //will you respect the current value of the mask? this could get ambiguous but we'll deal
+// LOOP and MODE are injected by the shader preprocessor, so each variant only carries its own path
+#ifndef LOOP
+#define LOOP 0              //does the data loop off the sides (toroid style)
+#endif
+#ifndef MODE
+#define MODE 1              //will you respect the current value of the mask? this could get ambiguous but we'll deal
+#endif
 
-vec4 mask_true = vec4(1.0,0.0,0.0,0.0);
-vec4 mask_false = vec4(0.0,0.0,0.0,0.0);
+#include "include/mask.glsl"
+#include "include/roi.glsl"
 
 void main()
 {
-    ivec3 regular_pos = ivec3(gl_GlobalInvocationID.xyz);
+    ivec3 regular_pos = region_position();
+    if(!in_roi(regular_pos))
+        return;
+
     ivec3 shifted_pos = regular_pos - movement;
 
     ivec3 image_size = imageSize(current);
 
-    if(loop)
-    {
-        shifted_pos.x = shifted_pos.x % image_size.x;
-        shifted_pos.y = shifted_pos.y % image_size.y;
-        shifted_pos.z = shifted_pos.z % image_size.z;
-    }
+#if LOOP
+    // movement comes in already wrapped to 0..DIM-1, so this never takes % of anything negative - that's undefined in GLSL
+    shifted_pos = (regular_pos - movement + image_size) % image_size;
+#endif
 
-  bool pmask = (imageLoad(previous_mask, regular_pos).r > 0.5);  //existing mask value (previous_mask = 0?)
-  bool psmask = (imageLoad(previous_mask, shifted_pos).r > 0.5);  //existing mask value (shifted)
+  bool pmask = MASK_READ(previous_mask, regular_pos);  //existing mask value (previous_mask = 0?)
+  bool psmask = MASK_READ(previous_mask, shifted_pos);  //existing mask value (shifted)
   
   vec4 plight = imageLoad(lighting, regular_pos);
   vec4 pslight = imageLoad(lighting, shifted_pos);
@@ -44,7 +50,7 @@ void main()
   
   
 
-    if(mode == 1)       //ignore mask buffer, move color and light data only (current_mask takes value of previous_mask)
+#if MODE == 1       //ignore mask buffer, move color and light data only (current_mask takes value of previous_mask)
     {
         // do the color shift
         imageStore(current, regular_pos, pscol);
@@ -53,27 +59,27 @@ void main()
         //imageStore(lighting, regular_pos, pslight);
         
         //write the same value of mask back to current_mask
-        imageStore(current_mask, regular_pos, pmask?mask_true:mask_false);
+        MASK_WRITE(current_mask, regular_pos, pmask);
     }
-    else if(mode == 2)  //respect mask buffer, if pmask is true, current takes value of previous, if false, do the shift
+#elif MODE == 2    //respect mask buffer, if pmask is true, current takes value of previous, if false, do the shift
     {
         //is the cell masked?
         if(pmask)
         {
-            //if yes, write previous color and mask_true
+            //if yes, write previous color and set the mask
             imageStore(current, regular_pos, pcol);
             //imageStore(lighting, regular_pos, plight);
-            imageStore(current_mask, regular_pos, mask_true);
+            MASK_SET(current_mask, regular_pos);
         }
         else
         {
-            //if no, write shifted color, and mask_false 
+            //if no, write shifted color, and clear the mask
             imageStore(current, regular_pos, pscol);
             //imageStore(lighting, regular_pos, pslight);
-            imageStore(current_mask, regular_pos, mask_false);
+            MASK_CLEAR(current_mask, regular_pos);
         }
     }
-    else if(mode == 3)  //carry mask buffer, mask comes along for the ride with the color values
+#elif MODE == 3    //carry mask buffer, mask comes along for the ride with the color values
     {
         //do the color shift
         imageStore(current, regular_pos, pscol);
@@ -82,6 +88,7 @@ void main()
         //imageStore(lighting, regular_pos, pslight);
         
         //do the mask shift
-        imageStore(current_mask, regular_pos, psmask?mask_true:mask_false);
+        MASK_WRITE(current_mask, regular_pos, psmask);
     }
+#endif
 }
@@ -0,0 +1,87 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //one brick
+
+// statistics of the block, by reduction - each workgroup reduces its brick in shared memory (counts, the box
+// around the occupied voxels, and the histograms), then adds that into the totals with one global atomic per
+// value it has, so the global atomics are per brick instead of per voxel. Occupied means alpha above a threshold,
+// or anything other than all zero for a threshold below zero (ANY_NONZERO in gpu_data.h)
+
+uniform layout(rgba8) image3D current;
+uniform layout(r32ui) uimage3D current_mask;
+
+#include "include/mask.glsl"
+
+uniform float alpha_threshold;
+
+// volume_statistics in gpu_data.h
+layout(std430, binding = 8) buffer statistics
+{
+  uint occupied;
+  uint masked;
+  int bounds_min[3];    //cleared to DIM, and -1 - min > max for an empty block
+  int bounds_max[3];
+  uint histogram[4 * 256];  //r, g, b, a of the occupied voxels, 256 bins each
+};
+
+shared uint local_occupied, local_masked;
+shared int local_min[3], local_max[3];
+shared uint local_histogram[4 * 256];
+
+void main()
+{
+  ivec3 p = ivec3(gl_GlobalInvocationID.xyz);
+  uint index = gl_LocalInvocationIndex;
+
+  if(index == 0u)
+  {
+    local_occupied = 0u;
+    local_masked = 0u;
+    for(int i = 0; i < 3; i++)
+    {
+      local_min[i] = DIM;
+      local_max[i] = -1;
+    }
+  }
+  local_histogram[index] = 0u;  //512 threads, two bins each
+  local_histogram[index + 512u] = 0u;
+  barrier();
+
+  vec4 color = imageLoad(current, p);
+  if((alpha_threshold < 0.0) ? (packUnorm4x8(color) != 0u) : (color.a > alpha_threshold))
+  {
+    atomicAdd(local_occupied, 1u);
+    for(int i = 0; i < 3; i++)
+    {
+      atomicMin(local_min[i], p[i]);
+      atomicMax(local_max[i], p[i]);
+    }
+
+    uvec4 bins = uvec4(round(clamp(color, 0.0, 1.0) * 255.0));
+    for(int c = 0; c < 4; c++)
+      atomicAdd(local_histogram[256 * c + int(bins[c])], 1u);
+  }
+  if(MASK_READ(current_mask, p))
+    atomicAdd(local_masked, 1u);
+  barrier();
+
+  // into the totals - only what this brick has anything in
+  if(index == 0u)
+  {
+    if(local_occupied != 0u)
+    {
+      atomicAdd(occupied, local_occupied);
+      for(int i = 0; i < 3; i++)
+      {
+        atomicMin(bounds_min[i], local_min[i]);
+        atomicMax(bounds_max[i], local_max[i]);
+      }
+    }
+    if(local_masked != 0u)
+      atomicAdd(masked, local_masked);
+  }
+  if(local_histogram[index] != 0u)
+    atomicAdd(histogram[index], local_histogram[index]);
+  if(local_histogram[index + 512u] != 0u)
+    atomicAdd(histogram[index + 512u], local_histogram[index + 512u]);
+}
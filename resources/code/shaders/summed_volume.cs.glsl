@@ -0,0 +1,94 @@
+#version 430
+
+// one pass of the summed volume table (3d prefix sum) - running this along x, then y, then z leaves every texel
+// holding the sum of everything in the box between the origin and itself, so the sum over any box is eight loads.
+// One workgroup scans one line: each thread sums a contiguous chunk of it, the chunk totals are scanned in shared
+// memory, then each thread walks its chunk again, writing the running sum starting from everything before it.
+// The table covers the box region_min..region_max, which is the whole block unless there's a region of interest
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;    //specifies the workgroup size
+
+// these are injected by the shader preprocessor
+#ifndef AXIS
+#define AXIS 0      //which axis this pass sums along - the x pass reads the source, the others work in place
+#endif
+#ifndef CHANNEL
+#define CHANNEL 0   //0-3 pick a channel of a color block, 4 means the source is a mask
+#endif
+
+#if AXIS == 0
+#if CHANNEL == 4
+uniform layout(r32ui) uimage3D source;
+#include "include/mask.glsl"
+#else
+uniform layout(rgba8) image3D source;
+#endif
+#endif
+
+// the sums wrap around 32 bits - box sums taken from the table still come out right, as long as the true sum
+// over the box fits in 32 bits (the subtractions wrap back the same way the additions did)
+uniform layout(r32ui) uimage3D sat;
+
+#include "include/region.glsl"
+
+shared uint partial[64];
+
+// position along the line -> position in the block, the line is picked by the workgroup
+ivec3 volume_position(int along)
+{
+  ivec2 across = ivec2(gl_WorkGroupID.yz);
+#if AXIS == 0
+  return region_min + ivec3(along, across.x, across.y);
+#elif AXIS == 1
+  return region_min + ivec3(across.x, along, across.y);
+#else
+  return region_min + ivec3(across.x, across.y, along);
+#endif
+}
+
+uint load(ivec3 p)
+{
+#if AXIS == 0
+  // everything is in 0-255 units - a masked cell counts as 255, so masks normalize the same way colors do
+#if CHANNEL == 4
+  return MASK_READ(source, p) ? 255u : 0u;
+#else
+  return uint(imageLoad(source, p)[CHANNEL] * 255.0 + 0.5);
+#endif
+#else
+  return imageLoad(sat, p).r;
+#endif
+}
+
+void main()
+{
+  uint index = gl_LocalInvocationID.x;
+  int length = region_max[AXIS] - region_min[AXIS] + 1;
+  int chunk = (length + 63) / 64;
+  int first = int(index) * chunk;
+  int last = min(first + chunk, length);
+
+  uint total = 0u;
+  for(int i = first; i < last; i++)
+    total += load(volume_position(i));
+
+  partial[index] = total;
+  barrier();
+
+  // inclusive scan of the chunk totals, log2(64) steps
+  for(uint offset = 1u; offset < 64u; offset *= 2u)
+  {
+    uint add = (index >= offset) ? partial[index - offset] : 0u;
+    barrier();
+    partial[index] += add;
+    barrier();
+  }
+
+  // each texel is read before it is written, and only by the thread that owns the chunk, so in place is fine
+  uint running = partial[index] - total;
+  for(int i = first; i < last; i++)
+  {
+    ivec3 p = volume_position(i);
+    running += load(p);
+    imageStore(sat, p, uvec4(running));
+  }
+}
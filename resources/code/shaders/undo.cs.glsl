@@ -0,0 +1,165 @@
+#version 430
+
+// undo history, GPU side - one workgroup per 8^3 brick. After an operation, the previous block holds what it
+// started from and the current block holds what it made: the first pass lists the bricks that differ, the fourth
+// turns the count into workgroups, the second gathers the XOR of the two for all of the listed bricks at once so
+// it can be read back over the next few frames, and the third XORs a delta back into the current block, which is
+// undo or redo depending on which way the block is at the time
+
+// this is injected by the shader preprocessor
+#ifndef PASS
+#define PASS 0  // 0 finds the changed bricks, 1 gathers their deltas, 2 applies deltas, 3 sizes the gather
+#endif
+
+#if PASS == 3
+layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+#else
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;    //one brick
+#endif
+
+#define BRICK_ROW 1024u   //BRICK_ROW in gpu_data.h
+
+#if PASS != 2
+uniform layout(rgba8) image3D previous;       //the block before the operation
+uniform layout(r32ui) uimage3D previous_mask;
+#endif
+uniform layout(rgba8) image3D current;        //the block after it
+uniform layout(r32ui) uimage3D current_mask;
+
+#include "include/mask.glsl"
+
+#define BRICK_WORDS (512 + 16)  //UNDO_BRICK_WORDS in undo.h
+
+layout(std430, binding = 2) buffer undo_list
+{
+  uint count;
+  uint groups[3];   //the gather's workgroups, for glDispatchComputeIndirect
+  uint bricks[];
+};
+
+layout(std430, binding = 3) buffer undo_payload
+{
+  uint payload[];
+};
+
+#if PASS == 2
+uniform uint first;   //where this batch starts in the list
+#endif
+
+#if PASS == 1 || PASS == 3
+uniform uint limit;   //how many bricks' deltas there's room for - past that, the record can't be kept anyway
+#endif
+
+// this is injected by the shader preprocessor
+#ifndef BRICK_LIST
+#define BRICK_LIST 0  //does the first pass look through the bricks of an in-place brick edit, instead of a box?
+#endif
+
+#if PASS == 0
+#if BRICK_LIST
+// the bricks the operation was allowed to change - a copy of its brick list, dispatched indirectly like it was
+layout(std430, binding = 9) readonly buffer edit_list
+{
+  uint edit_count;
+  uint edit_groups[3];
+  uint edit_bricks[];
+};
+#else
+uniform ivec3 brick_min;  //the first brick of the box the operation could have changed, dispatched from here
+#endif
+#endif
+
+#if PASS == 0
+shared bool changed;
+#endif
+
+#define BRICKS (DIM / 8)
+
+ivec3 brick_origin(uint b)
+{
+  return 8 * ivec3(b % BRICKS, (b / BRICKS) % BRICKS, b / (BRICKS * BRICKS));
+}
+
+// this voxel's row of the brick in the mask, as 8 bits
+#if PASS != 2
+uint mask_row(ivec3 p)
+{
+  return ((imageLoad(previous_mask, MASK_WORD(p)).r ^ imageLoad(current_mask, MASK_WORD(p)).r) >> uint(p.x & 31)) & 0xFFu;
+}
+#endif
+
+void main()
+{
+#if PASS == 3
+  uint n = min(count, limit);
+  groups[0] = min(n, BRICK_ROW);
+  groups[1] = (n + BRICK_ROW - 1u) / BRICK_ROW;
+  groups[2] = 1u;
+#else
+  ivec3 l = ivec3(gl_LocalInvocationID.xyz);
+
+#if PASS == 0
+#if BRICK_LIST
+  uint i = gl_WorkGroupID.x + gl_WorkGroupID.y * BRICK_ROW;
+  if(i >= edit_count)
+    return; // past the end of the list - the whole workgroup is, so this is fine before the barriers
+  uint e = edit_bricks[i];
+  ivec3 brick = ivec3(e & 1023u, (e >> 10) & 1023u, e >> 20);
+#else
+  ivec3 brick = ivec3(gl_WorkGroupID.xyz) + brick_min;
+#endif
+  ivec3 p = 8 * brick + l;
+  if(l == ivec3(0))
+    changed = false;
+  barrier();
+
+  bool differs = packUnorm4x8(imageLoad(previous, p)) != packUnorm4x8(imageLoad(current, p));
+  if(l.x == 0 && mask_row(p) != 0u)
+    differs = true;
+  if(differs)
+    changed = true;
+  barrier();
+
+  if(l == ivec3(0) && changed)
+    bricks[atomicAdd(count, 1u)] = uint(brick.x + BRICKS * (brick.y + BRICKS * brick.z));
+#else
+#if PASS == 1
+  uint slot = gl_WorkGroupID.x + gl_WorkGroupID.y * BRICK_ROW;
+  if(slot >= min(count, limit))
+    return; // past the end of the list, on the last row
+  ivec3 p = brick_origin(bricks[slot]) + l;
+#else
+  uint slot = gl_WorkGroupID.x;
+  ivec3 p = brick_origin(bricks[first + slot]) + l;
+#endif
+  uint base = slot * BRICK_WORDS;
+  uint voxel = uint(l.x + 8 * (l.y + 8 * l.z));
+
+#if PASS == 1
+  payload[base + voxel] = packUnorm4x8(imageLoad(previous, p)) ^ packUnorm4x8(imageLoad(current, p));
+
+  // four rows of mask bits to a word, gathered by the first voxel of every fourth row
+  if(l.x == 0 && (l.y % 4) == 0)
+  {
+    uint word = 0u;
+    for(int r = 0; r < 4; r++)
+      word |= mask_row(p + ivec3(0, r, 0)) << (8 * r);
+    payload[base + 512u + voxel / 32u] = word;
+  }
+#else
+  imageStore(current, p, unpackUnorm4x8(packUnorm4x8(imageLoad(current, p)) ^ payload[base + voxel]));
+
+  // mask words are shared with the bricks on either side along x, so the rows go in atomically
+  if(l.x == 0 && (l.y % 4) == 0)
+  {
+    uint word = payload[base + 512u + voxel / 32u];
+    for(int r = 0; r < 4; r++)
+    {
+      ivec3 q = p + ivec3(0, r, 0);
+      imageAtomicXor(current_mask, MASK_WORD(q), ((word >> (8 * r)) & 0xFFu) << uint(q.x & 31));
+    }
+  }
+#endif
+#endif
+#endif
+}
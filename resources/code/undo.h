@@ -0,0 +1,88 @@
+//  ╦ ╦┌┐┌┌┬┐┌─┐
+//  ║ ║│││ │││ │
+//  ╚═╝┘└┘─┴┘└─┘
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// undo history, CPU side - each operation is kept as the XOR of the block before and after it, for just the 8^3
+// bricks it changed. XOR makes undo and redo the same thing (applying a delta to the block after the operation
+// gives the block before it, and the other way around), and it leaves everything the operation didn't touch as
+// zero bytes, so the deltas compress well with a simple scheme: runs of zero bytes become a single control byte,
+// everything else is copied through as literals. That's fast enough to not be noticed next to the readback.
+
+// words per brick in a delta - 512 colors (rgba8, packed), then the brick's 512 mask bits, 8 to a row of x
+#define UNDO_BRICK_WORDS (512 + 16)
+
+struct undo_record
+{
+    std::vector<uint32_t> bricks;                // which bricks changed, x + y*(DIM/8) + z*(DIM/8)^2
+    std::vector<std::vector<uint8_t>> chunks;    // their deltas, compressed, UNDO_BATCH bricks per chunk
+    int lo[3], hi[3];                            // the box the bricks cover, in voxels - for relighting
+
+    size_t bytes() const
+    {
+        size_t total = sizeof(undo_record) + bricks.size() * sizeof(uint32_t);
+        for(auto &c : chunks)
+            total += c.size();
+        return total;
+    }
+};
+
+// control bytes 0-127 are followed by that many plus one literal bytes, 128-255 stand for that many minus 126
+// zero bytes (2-129) - a single zero in the middle of literals is cheaper left as a literal
+inline std::vector<uint8_t> undo_compress(const uint8_t *src, size_t n)
+{
+    std::vector<uint8_t> out;
+    out.reserve(n / 8);
+
+    size_t i = 0;
+    while(i < n)
+    {
+        size_t run = 0;
+        while(i + run < n && src[i + run] == 0 && run < 129)
+            run++;
+
+        if(run >= 2)
+        {
+            out.push_back(uint8_t(126 + run));
+            i += run;
+            continue;
+        }
+
+        // literals, up to the next pair of zeros
+        size_t start = i;
+        while(i < n && (i - start) < 128 && !(src[i] == 0 && i + 1 < n && src[i + 1] == 0))
+            i++;
+
+        out.push_back(uint8_t(i - start - 1));
+        out.insert(out.end(), src + start, src + i);
+    }
+    return out;
+}
+
+inline void undo_decompress(const std::vector<uint8_t> &src, uint8_t *dst, size_t n)
+{
+    size_t i = 0, o = 0;
+    while(i < src.size() && o < n)
+    {
+        uint8_t control = src[i++];
+        if(control >= 128)
+        {
+            size_t run = control - 126;
+            for(size_t k = 0; k < run && o < n; k++)
+                dst[o++] = 0;
+        }
+        else
+        {
+            size_t count = size_t(control) + 1;
+            for(size_t k = 0; k < count && i < src.size() && o < n; k++)
+                dst[o++] = src[i++];
+        }
+    }
+}
+
+#endif
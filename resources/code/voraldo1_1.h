@@ -36,6 +36,7 @@ class Voraldo
 		void HelpMarker(const char* indicator, const char* desc);
 		void QuitConfirm(bool *open);
 		void WrappedText(const char* string, float wrap);
+		void RegionOfInterest();
 		
 		void create_window();
 		void gl_setup();
@@ -290,6 +290,22 @@ void Voraldo::WrappedText(const char* string, float wrap)
     ImGui::PopTextWrapPos();
 }
 
+// region of interest controls, shared by the utilities and the lighting tabs
+void Voraldo::RegionOfInterest()
+{
+    ImGui::Checkbox(" region of interest ", &GPU_Data.roi_enabled);
+    ImGui::SameLine();
+    HelpMarker("(?)", "With this on, the utilities and the lighting only change the box between min and max, and only cost about what the box does. Masked only further restricts the utilities to the masked voxels in the box. Connected components are only found inside the box, and masking one only looks at the box. Undo, paste, the distance field and the statistics always work on the whole block.");
+    if(GPU_Data.roi_enabled)
+    {
+        ImGui::SameLine();
+        ImGui::Checkbox(" masked only ", &GPU_Data.roi_masked);
+        ImGui::SliderInt3(" min", &GPU_Data.roi_min.x, 0, DIM-1);
+        ImGui::SliderInt3(" max", &GPU_Data.roi_max.x, 0, DIM-1);
+    }
+    ImGui::Separator();
+}
+
 
 // small overlay to show the FPS counter, FPS graph
 void Voraldo::FPSOverlay(bool* p_open)
@@ -331,6 +347,11 @@ void Voraldo::FPSOverlay(bool* p_open)
         sprintf(overlay, "avg %.2f fps (%.2f ms)", average, 1000.0f/average);
         ImGui::PlotLines("", values, IM_ARRAYSIZE(values), 0, overlay, 0.0f, 100.0f, ImVec2(240,60));
 
+        // shaders still being compiled in the background
+        int pending = GPU_Data.shaders_pending();
+        if(pending)
+            ImGui::Text("compiling... (%d shaders left)", pending);
+
 
         if (ImGui::BeginPopupContextWindow())
         {
@@ -1220,12 +1241,96 @@ void Voraldo::ControlWindow(bool *open)
                     ImGui::EndTabItem();
                 }
 
+                if(ImGui::BeginTabItem(" Mesh "))
+                {
+                    static char filename[256] = "";
+                    static float scale = 0.9;
+                    static bool solid = true;
+                    static bool use_mesh_color = true;
+                    static bool respect_mask = false;
+                    static ImVec4 mesh_draw_color;
+                    static std::string status;
+
+                    WrappedText("Voxelizes an OBJ or STL file into the block. Surface mode marks every cell a triangle passes through, solid mode fills the inside as well. Vertex colors, material colors and PNG textures are used if the file has them, otherwise the color below.", windowsize.x);
+                    ImGui::Text(" ");
+
+                    ImGui::Text("Path to the mesh file:");
+                    ImGui::InputTextWithHint(" ", "e.g. meshes/bunny.obj", filename, IM_ARRAYSIZE(filename));
+
+                    ImGui::Text(" ");
+                    ImGui::SliderFloat(" scale", &scale, 0.1f, 1.0f, "%.3f");
+                    ImGui::SameLine();
+                    HelpMarker("(?)", "How much of the block the longest side of the mesh spans.");
+
+                    ImGui::Checkbox(" solid", &solid);
+                    ImGui::Checkbox(" use mesh color", &use_mesh_color);
+                    ImGui::ColorEdit4(" Color", (float*)&mesh_draw_color, ImGuiColorEditFlags_AlphaBar | ImGuiColorEditFlags_AlphaPreviewHalf);
+
+                    ImGui::Text(" ");
+                    ImGui::Checkbox(" respect mask ", &respect_mask);
+
+                    ImGui::Text(" ");
+                    ImGui::SetCursorPosX(16);
+
+                    if (ImGui::Button("Voxelize", ImVec2(100, 22)))
+                    {
+                        status = GPU_Data.load_mesh(std::string(filename), scale, solid, use_mesh_color, glm::vec4(mesh_draw_color.x, mesh_draw_color.y, mesh_draw_color.z, mesh_draw_color.w), respect_mask);
+                    }
+
+                    if(status.length())
+                        WrappedText(status.c_str(), windowsize.x);
+
+                    ImGui::EndTabItem();
+                }
+
+                if(ImGui::BeginTabItem(" Point Cloud "))
+                {
+                    static char filename[256] = "";
+                    static float scale = 0.9;
+                    static bool z_up = true;
+                    static bool respect_mask = false;
+                    static ImVec4 point_draw_color = ImVec4(1.0, 1.0, 1.0, 1.0);
+                    static std::string status;
+
+                    WrappedText("Splats a PLY or XYZ point cloud into the block - each voxel takes the average color of the points that land in it. Points without color use the color below, and its alpha is used for every voxel.", windowsize.x);
+                    ImGui::Text(" ");
+
+                    ImGui::Text("Path to the point cloud file:");
+                    ImGui::InputTextWithHint(" ", "e.g. scans/room.ply", filename, IM_ARRAYSIZE(filename));
+
+                    ImGui::Text(" ");
+                    ImGui::SliderFloat(" scale", &scale, 0.1f, 1.0f, "%.3f");
+                    ImGui::SameLine();
+                    HelpMarker("(?)", "How much of the block the longest side of the cloud spans.");
+
+                    ImGui::Checkbox(" z is up", &z_up);
+                    ImGui::ColorEdit4(" Color", (float*)&point_draw_color, ImGuiColorEditFlags_AlphaBar | ImGuiColorEditFlags_AlphaPreviewHalf);
+
+                    ImGui::Text(" ");
+                    ImGui::Checkbox(" respect mask ", &respect_mask);
+
+                    ImGui::Text(" ");
+                    ImGui::SetCursorPosX(16);
+
+                    if (ImGui::Button("Splat", ImVec2(100, 22)))
+                    {
+                        status = GPU_Data.load_point_cloud(std::string(filename), scale, z_up, glm::vec4(point_draw_color.x, point_draw_color.y, point_draw_color.z, point_draw_color.w), respect_mask);
+                    }
+
+                    if(status.length())
+                        WrappedText(status.c_str(), windowsize.x);
+
+                    ImGui::EndTabItem();
+                }
+
                 ImGui::EndTabBar();
                 ImGui::EndTabItem();
             }
 
             if (ImGui::BeginTabItem(" Utilities "))
             {
+                RegionOfInterest();
+
                 ImGui::BeginTabBar("u", tab_bar_flags);
 
                 if(ImGui::BeginTabItem(" Clear "))
@@ -1249,6 +1354,30 @@ void Voraldo::ControlWindow(bool *open)
                     ImGui::EndTabItem();
                 }
 
+                if(ImGui::BeginTabItem(" History "))
+                {
+                    static int budget_mb = UNDO_BUDGET_MB;
+
+                    WrappedText("Every operation on the block is kept as the bricks it changed, so it can be undone (ctrl+z) and redone (ctrl+y). Once the history is using more memory than the budget, the oldest steps are dropped, and an operation too big for the budget by itself isn't kept.", windowsize.x);
+                    ImGui::Text(" ");
+
+                    ImGui::SetCursorPosX(16);
+                    if (ImGui::Button("Undo", ImVec2(100, 22)))
+                        GPU_Data.undo();
+                    ImGui::SameLine();
+                    if (ImGui::Button("Redo", ImVec2(100, 22)))
+                        GPU_Data.redo();
+
+                    ImGui::Text("%d steps to undo, %d to redo, %.1f MB%s", GPU_Data.undo_steps(), GPU_Data.redo_steps(), GPU_Data.undo_memory() / (1024.0 * 1024.0), GPU_Data.undo_recording() ? " (recording)" : "");
+                    if(!GPU_Data.undo_message().empty())
+                        WrappedText(GPU_Data.undo_message().c_str(), windowsize.x);
+
+                    if(ImGui::SliderInt(" Budget (MB)", &budget_mb, 16, 4096))
+                        GPU_Data.undo_budget = size_t(budget_mb) << 20;
+
+                    ImGui::EndTabItem();
+                }
+
                 if(ImGui::BeginTabItem(" Masking "))
                 {
                     WrappedText("This will clear the mask value for all cells. Equivalently, set mask to false for all voxels. ", windowsize.x);
@@ -1337,6 +1466,31 @@ void Voraldo::ControlWindow(bool *open)
                         GPU_Data.mask_by_color(use_r, use_g, use_b, use_a, use_l, glm::vec4(select_color.x, select_color.y, select_color.z, select_color.w), light_val, r_variance, g_variance, b_variance, a_variance, l_variance);
                     }
 
+                    ImGui::Text(" ");
+                    ImGui::Text(" ");
+
+                    static glm::ivec3 component_seed = glm::ivec3(DIM/2);
+                    static float component_alpha = 0.0;
+                    static int component_count = -1;
+
+                    WrappedText("This masks one connected object - everything reachable from the seed voxel through the faces of voxels with alpha over the threshold. An empty seed voxel masks nothing. ", windowsize.x);
+                    ImGui::Text(" ");
+
+                    ImGui::SliderInt3("seed", (int*)&component_seed, 0, DIM-1);
+                    ImGui::SliderFloat("alpha threshold", &component_alpha, 0.0f, 1.0f, "%.3f");
+
+                    if (ImGui::Button("Mask Object", ImVec2(100, 22)))
+                    {
+                        component_count = GPU_Data.mask_component(component_seed, component_alpha);
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Count", ImVec2(100, 22)))
+                    {
+                        component_count = GPU_Data.label_components(component_alpha);
+                    }
+                    if(component_count >= 0)
+                        ImGui::Text("%d separate objects in the block", component_count);
+
                     ImGui::EndTabItem();
                 }
 
@@ -1346,10 +1500,10 @@ void Voraldo::ControlWindow(bool *open)
                     static bool touch_alpha = true;
                     static bool respect_mask = false;
 
-                    WrappedText("This is a simple box blur. It will consider the size neighborhood you select, and average the colors to give smoother transitions beteen neighboring cells.", windowsize.x);
+                    WrappedText("This is a simple box blur. It will consider the size neighborhood you select, and average the colors to give smoother transitions beteen neighboring cells. It works from a summed volume table, so the radius doesn't change how long it takes.", windowsize.x);
                     ImGui::Text(" ");
 
-                    ImGui::SliderInt(" Radius", &blur_radius, 0, 5);
+                    ImGui::SliderInt(" Radius", &blur_radius, 0, 127);
 
                     ImGui::Separator();
 
@@ -1374,10 +1528,10 @@ void Voraldo::ControlWindow(bool *open)
                     static bool touch_alpha = true;
                     static bool respect_mask = false;
 
-                    WrappedText("This is a gaussian blur. It will consider the size neighborhood you select, and average the colors to give smoother transitions beteen neighboring cells.", windowsize.x);
+                    WrappedText("This is a gaussian blur. It will consider the size neighborhood you select, and average the colors to give smoother transitions beteen neighboring cells. It is done one axis at a time, so large radii are cheap.", windowsize.x);
                     ImGui::Text(" ");
 
-                    ImGui::SliderInt(" Radius", &blur_radius, 0, 5);
+                    ImGui::SliderInt(" Radius", &blur_radius, 0, 32);
 
                     ImGui::Separator();
 
@@ -1397,6 +1551,45 @@ void Voraldo::ControlWindow(bool *open)
                 }
 
 
+                if(ImGui::BeginTabItem(" Morphology "))
+                {
+                    static int morph_radius = 1;
+                    static float morph_alpha = 0.0;
+                    static bool respect_mask = false;
+
+                    WrappedText("These grow or shrink everything with alpha over the threshold, by a distance in voxels. Dilate grows the surface outwards, taking the color of the nearest surface voxel - erode eats into it. Open erodes then dilates, to remove thin parts. Close dilates then erodes, to fill in small gaps and holes.", windowsize.x);
+                    ImGui::Text(" ");
+
+                    ImGui::SliderInt(" Radius", &morph_radius, 0, DISTANCE_RANGE-1);
+                    ImGui::SliderFloat(" Alpha threshold", &morph_alpha, 0.0f, 1.0f, "%.3f");
+
+                    ImGui::Separator();
+
+                    ImGui::Checkbox("  Respect mask ", &respect_mask);
+                    ImGui::Checkbox("  Keep distance field updated ", &GPU_Data.auto_update_distance);
+                    ImGui::SameLine();
+                    HelpMarker("(?)", "Once a distance field has been built, patch it up after each edit, in just the part of the block the edit can have changed.");
+
+                    ImGui::Text(" ");
+                    ImGui::SetCursorPosX(16);
+
+                    if (ImGui::Button("Dilate", ImVec2(100, 22)))
+                        GPU_Data.dilate(morph_radius, morph_alpha, respect_mask);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Erode", ImVec2(100, 22)))
+                        GPU_Data.erode(morph_radius, morph_alpha, respect_mask);
+
+                    ImGui::SetCursorPosX(16);
+
+                    if (ImGui::Button("Open", ImVec2(100, 22)))
+                        GPU_Data.morphological_open(morph_radius, morph_alpha, respect_mask);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Close", ImVec2(100, 22)))
+                        GPU_Data.morphological_close(morph_radius, morph_alpha, respect_mask);
+
+                    ImGui::EndTabItem();
+                }
+
                 if(ImGui::BeginTabItem(" Limiter "))
                 {
                     if (ImGui::Button("Limit", ImVec2(100, 22)))
@@ -1461,11 +1654,136 @@ void Voraldo::ControlWindow(bool *open)
                     if (ImGui::Button("Shift", ImVec2(90,22)))
                         GPU_Data.shift(glm::ivec3(xmove,ymove,zmove), loop, shift_mode);
 
+                    ImGui::Text(" ");
+                    WrappedText("With virtual shifting on, looping shifts in mode 3 don't move any data, so nudging things into place is free. The data is moved for real, once, by the next operation that needs it (or on save). ", windowsize.x);
+                    ImGui::Text(" ");
+
+                    ImGui::SetCursorPosX(16);
+                    ImGui::Checkbox(" virtual shifting", &GPU_Data.virtual_shift);
+
+                    glm::ivec3 pending = GPU_Data.pending_offset();
+                    if(pending != glm::ivec3(0))
+                    {
+                        ImGui::SetCursorPosX(16);
+                        ImGui::Text("pending shift: %d %d %d", pending.x, pending.y, pending.z);
+                        ImGui::SameLine();
+                        if (ImGui::Button("Apply", ImVec2(90,22)))
+                            GPU_Data.materialize_offset();
+                    }
+
                     ImGui::EndTabItem();
                 }
 
                 if(ImGui::BeginTabItem(" Copy/Paste "))
                 {
+                    static glm::ivec3 copy_min = glm::ivec3(0), copy_max = glm::ivec3(DIM-1);
+                    static bool copy_masked = false;
+
+                    static glm::ivec3 paste_offset = glm::ivec3(0), paste_turns = glm::ivec3(0);
+                    static bool mirror_x = false, mirror_y = false, mirror_z = false;
+                    static bool paste_respect_mask = true, paste_overwrite = false;
+
+                    WrappedText("Copy takes a box out of the block, or just the masked voxels in it. Only the parts of the box with something in them are kept, so copying a small object out of a big box doesn't cost much. ", windowsize.x);
+                    ImGui::Text(" ");
+
+                    ImGui::SliderInt3(" min", (int*)&copy_min, 0, DIM-1);
+                    ImGui::SliderInt3(" max", (int*)&copy_max, 0, DIM-1);
+                    ImGui::Checkbox(" masked voxels only", &copy_masked);
+
+                    ImGui::SetCursorPosX(16);
+                    if (ImGui::Button("Copy", ImVec2(100, 22)))
+                        GPU_Data.copy(copy_min, copy_max, copy_masked);
+
+                    glm::ivec3 size = GPU_Data.clipboard_size();
+                    glm::ivec3 bricks = (size + glm::ivec3(7)) / 8;
+                    if(size != glm::ivec3(0))
+                        ImGui::Text("clipboard is %d x %d x %d, %d of %d bricks kept (%.1f MB)", size.x, size.y, size.z, GPU_Data.clipboard_bricks(), bricks.x * bricks.y * bricks.z, GPU_Data.clipboard_bricks() * 2048 / (1024.0 * 1024.0));
+                    else
+                        ImGui::Text("clipboard is empty");
+
+                    ImGui::Text(" ");
+                    ImGui::Text(" ");
+
+                    WrappedText("Paste puts the clipboard back down with its low corner at the offset. It can be mirrored along its own axes, then turned in quarter turns about x, y and z. Empty space in the clipboard leaves the block alone, unless overwrite is on. ", windowsize.x);
+                    ImGui::Text(" ");
+
+                    ImGui::SliderInt3(" offset", (int*)&paste_offset, -DIM, DIM);
+                    ImGui::SliderInt3(" quarter turns", (int*)&paste_turns, 0, 3);
+
+                    ImGui::Checkbox(" mirror x", &mirror_x);
+                    ImGui::SameLine();
+                    ImGui::Checkbox(" mirror y", &mirror_y);
+                    ImGui::SameLine();
+                    ImGui::Checkbox(" mirror z", &mirror_z);
+
+                    ImGui::Checkbox(" respect mask", &paste_respect_mask);
+                    ImGui::SameLine();
+                    ImGui::Checkbox(" overwrite", &paste_overwrite);
+
+                    ImGui::SetCursorPosX(16);
+                    if (ImGui::Button("Paste", ImVec2(100, 22)))
+                        GPU_Data.paste(paste_offset, paste_turns, glm::bvec3(mirror_x, mirror_y, mirror_z), paste_respect_mask, paste_overwrite);
+
+                    ImGui::EndTabItem();
+                }
+
+                if(ImGui::BeginTabItem(" Statistics "))
+                {
+                    static float threshold = 0.0f;
+                    static int channel = 3;
+
+                    WrappedText("Counts the occupied voxels (alpha above the threshold) and the masked ones, finds the box the occupied voxels are in, and makes histograms of their colors. It runs on the GPU and shows up here a frame or so later.", windowsize.x);
+                    ImGui::Text(" ");
+
+                    ImGui::SliderFloat(" threshold", &threshold, 0.0f, 1.0f, "%.3f");
+                    if (ImGui::Button("Compute", ImVec2(120, 22)))
+                        GPU_Data.compute_statistics(threshold);
+
+                    const volume_statistics &stats = GPU_Data.statistics();
+                    if(GPU_Data.statistics_pending())
+                    {
+                        ImGui::SameLine();
+                        ImGui::Text(" working...");
+                    }
+                    else if(stats.valid && !GPU_Data.statistics_current())
+                    {
+                        ImGui::SameLine();
+                        ImGui::Text(" out of date");
+                    }
+
+                    if(stats.valid)
+                    {
+                        ImGui::Text(" ");
+                        if(stats.threshold < 0.0f) // from a cropped save
+                            ImGui::Text("occupied voxels: %u (anything non-zero)", stats.occupied);
+                        else
+                            ImGui::Text("occupied voxels: %u (at %.3f)", stats.occupied, stats.threshold);
+                        ImGui::Text("masked voxels:   %u", stats.masked);
+                        if(stats.occupied)
+                            ImGui::Text("bounds: (%d, %d, %d) to (%d, %d, %d)", stats.min.x, stats.min.y, stats.min.z, stats.max.x, stats.max.y, stats.max.z);
+                        else
+                            ImGui::Text("bounds: nothing there");
+
+                        ImGui::Text(" ");
+                        ImGui::RadioButton(" red ", &channel, 0); ImGui::SameLine();
+                        ImGui::RadioButton(" green ", &channel, 1); ImGui::SameLine();
+                        ImGui::RadioButton(" blue ", &channel, 2); ImGui::SameLine();
+                        ImGui::RadioButton(" alpha ", &channel, 3);
+
+                        float values[256];
+                        for(int i = 0; i < 256; i++)
+                            values[i] = float(stats.histogram[channel][i]);
+                        ImGui::PlotHistogram("", values, 256, 0, NULL, 0.0f, FLT_MAX, ImVec2(windowsize.x - 40, 120));
+                    }
+
+                    ImGui::Text(" ");
+                    ImGui::Text("Cropping to the content");
+                    ImGui::SliderFloat(" screenshot crop threshold", &GPU_Data.crop_threshold, 0.0f, 1.0f, "%.3f");
+                    ImGui::Checkbox(" crop saves ", &GPU_Data.crop_saves);
+                    ImGui::SameLine();
+                    ImGui::Checkbox(" crop screenshots ", &GPU_Data.crop_screenshots);
+                    ImGui::SameLine();
+                    HelpMarker("(?)", "Saves keep just the box around every voxel that isn't all zero, and put it back in the same place when they're loaded. Screenshots keep just the part of the screen covered by the box around the voxels with alpha above the threshold.");
 
                     ImGui::EndTabItem();
                 }
@@ -1503,6 +1821,7 @@ void Voraldo::ControlWindow(bool *open)
 
                     ImGui::Text(" ");
                     ImGui::Checkbox("  Respect mask on load", &respect_mask_on_load);
+                    ImGui::Checkbox("  Crop to content on save", &GPU_Data.crop_saves);
 
                     ImGui::SetCursorPosX(16);
 
@@ -1536,6 +1855,8 @@ void Voraldo::ControlWindow(bool *open)
 
             if (ImGui::BeginTabItem(" Lighting "))
             {
+                RegionOfInterest();
+
                 ImGui::BeginTabBar("l", tab_bar_flags);
 
                 static float clear_level;
@@ -1545,18 +1866,27 @@ void Voraldo::ControlWindow(bool *open)
                 static float directional_phi;
                 static float directional_intensity;
                 static float decay_power;
+                static glm::vec3 directional_color = glm::vec3(1.0);
 
-                static int AO_radius;
+                static glm::ivec3 AO_radii = glm::ivec3(2, 8, 32);       // near, mid, far
+                static glm::vec3 AO_weights = glm::vec3(1.0, 0.5, 0.25);
 
                 static float GI_scale_factor = 0.028;
                 static float GI_alpha_thresh = 0.010;
                 static float GI_sky_intensity = 0.16;
+                static glm::vec3 GI_sky_color = glm::vec3(1.0);
+
+                static int cone_GI_preset = 1;
+                static float cone_GI_strength = 0.5;
+                static float cone_GI_sky_intensity = 0.1;
+                static glm::vec3 cone_GI_sky_color = glm::vec3(1.0);
 
 
                 static glm::vec3 point_light_position = glm::vec3(0,0,0);
                 static float point_intensity = 0;
                 static float point_decay_power = 0;
                 static float point_distance_power = 0;
+                static glm::vec3 point_color = glm::vec3(1.0);
 
 
                 static glm::vec3 cone_light_position = glm::vec3(0,0,0);
@@ -1566,6 +1896,7 @@ void Voraldo::ControlWindow(bool *open)
                 static float cone_intensity = 0;
                 static float cone_decay_power = 0;
                 static float cone_distance_power = 0;
+                static glm::vec3 cone_color = glm::vec3(1.0);
                     
                 if(ImGui::BeginTabItem(" Clear "))
                 {
@@ -1578,6 +1909,20 @@ void Voraldo::ControlWindow(bool *open)
                     if (ImGui::Button("Clear", ImVec2(120, 22))) // Buttons return true when clicked (most widgets return true when edited/activated)
                         GPU_Data.lighting_clear(use_cache, clear_level);
 
+                    ImGui::Separator();
+                    ImGui::Text("Relighting after edits");
+                    ImGui::Checkbox(" relight automatically ", &GPU_Data.auto_relight);
+                    ImGui::SameLine();
+                    HelpMarker("(?)", "The lighting operations since the last clear are remembered. After an edit, relighting applies them again, but only in the part of the block the edit can have changed - the edit itself, and the shadows it casts from each light.");
+                    ImGui::Checkbox(" sparse lighting ", &GPU_Data.sparse_lighting);
+                    ImGui::SameLine();
+                    HelpMarker("(?)", "Point and cone lights only light the cells near something, so they take about as long as the scene is big instead of the block. Anything drawn into empty space afterwards is lit by the next relight.");
+
+                    if (ImGui::Button("Relight", ImVec2(120, 22)))
+                        GPU_Data.relight_dirty();
+                    ImGui::SameLine();
+                    ImGui::Text(GPU_Data.lighting_dirty() ? "edited since the last relight" : "up to date");
+
                     ImGui::Separator();
                     ImGui::EndTabItem();
                 }
@@ -1591,11 +1936,15 @@ void Voraldo::ControlWindow(bool *open)
                     ImGui::SliderFloat("loc z", &point_light_position.z, -100, DIM+100, "%.3f");
                     ImGui::Text(" ");
                     ImGui::SliderFloat("value", &point_intensity, 0, 1.0, "%.3f");
+                    ImGui::ColorEdit3("color", (float*)&point_color);
                     ImGui::SliderFloat("decay", &point_decay_power, 0, 3.0, "%.3f");
                     ImGui::SliderFloat("dist power", &point_distance_power, 0, 3.0f, "%.3f");
                     
                     if (ImGui::Button("Point Light", ImVec2(120, 22))) // Buttons return true when clicked (most widgets return true when edited/activated)
-                        GPU_Data.compute_point_lighting(point_light_position, point_intensity, point_decay_power, point_distance_power);
+                        GPU_Data.compute_point_lighting(point_light_position, point_intensity, point_decay_power, point_distance_power, point_color);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Add to List", ImVec2(120, 22)))
+                        GPU_Data.add_point_light(point_light_position, point_intensity, point_decay_power, point_distance_power, 0.0, point_color);
 
                     
                     ImGui::Separator();
@@ -1618,11 +1967,19 @@ void Voraldo::ControlWindow(bool *open)
                     ImGui::Text(" ");
                     ImGui::Text("Defines the initial intensity of this light source");
                     ImGui::SliderFloat("value", &cone_intensity, 0, 1.0, "%.3f");
+                    ImGui::ColorEdit3("color", (float*)&cone_color);
                     ImGui::Text(" ");
                     ImGui::Text("Defines the falloff - decay is interaction with alpha");
                     ImGui::SliderFloat("decay", &cone_decay_power, 0, 3.0, "%.3f");
                     ImGui::SliderFloat("dist power", &cone_distance_power, 0, 3.0f, "%.3f");
 
+                    if (ImGui::Button("Cone Light", ImVec2(120, 22))) // Buttons return true when clicked (most widgets return true when edited/activated)
+                        GPU_Data.compute_cone_lighting(cone_light_position, cone_theta, cone_phi, cone_angle, cone_intensity, cone_decay_power, cone_distance_power, cone_color);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Add to List", ImVec2(120, 22)))
+                        GPU_Data.add_cone_light(cone_light_position, cone_theta, cone_phi, cone_angle, cone_intensity, cone_decay_power, cone_distance_power, 0.0, cone_color);
+
+
                     ImGui::Separator();
                     ImGui::EndTabItem();
                 }
@@ -1630,20 +1987,65 @@ void Voraldo::ControlWindow(bool *open)
                 if(ImGui::BeginTabItem(" Directional "))
                 {
 
+                    static bool animate_directional = false;
+                    bool changed = false;
+
                     ImGui::Text("Directional");
-                    ImGui::SliderFloat("theta", &directional_theta, -3.14f, 3.14f, "%.3f");
-                    ImGui::SliderFloat("phi", &directional_phi, -3.14f, 3.14f, "%.3f");
+                    changed |= ImGui::SliderFloat("theta", &directional_theta, -3.14f, 3.14f, "%.3f");
+                    changed |= ImGui::SliderFloat("phi", &directional_phi, -3.14f, 3.14f, "%.3f");
                     ImGui::Text(" ");
-                    ImGui::SliderFloat("value", &directional_intensity, 0.0f, 1.0f, "%.3f");
-                    ImGui::SliderFloat("decay", &decay_power, 0.0f, 3.0f, "%.3f");
+                    changed |= ImGui::SliderFloat("value", &directional_intensity, 0.0f, 1.0f, "%.3f");
+                    changed |= ImGui::ColorEdit3("color", (float*)&directional_color);
+                    changed |= ImGui::SliderFloat("decay", &decay_power, 0.0f, 3.0f, "%.3f");
+
+                    ImGui::Checkbox(" live update ", &animate_directional);
+                    ImGui::SameLine();
+                    HelpMarker("(?)", "With this checked, moving the sliders clears the lighting (using the settings on the Clear tab) and reapplies the directional light, so you can move the sun around interactively.");
 
                     if (ImGui::Button("New Directional", ImVec2(120, 22))) // Buttons return true when clicked (most widgets return true when edited/activated)
-                        GPU_Data.compute_new_directional_lighting(directional_theta, directional_phi, directional_intensity, decay_power);
+                        GPU_Data.compute_new_directional_lighting(directional_theta, directional_phi, directional_intensity, decay_power, directional_color);
+                    else if(animate_directional && changed)
+                    {
+                        GPU_Data.lighting_clear(use_cache, clear_level);
+                        GPU_Data.compute_new_directional_lighting(directional_theta, directional_phi, directional_intensity, decay_power, directional_color);
+                    }
+
+                    ImGui::SameLine();
+                    if (ImGui::Button("Add to List", ImVec2(120, 22)))
+                        GPU_Data.add_directional_light(directional_theta, directional_phi, directional_intensity, decay_power, directional_color);
 
                     ImGui::Separator();
                     ImGui::EndTabItem();
                 }
   
+                if(ImGui::BeginTabItem(" Light List "))
+                {
+                    WrappedText("Lights added from the Point, Cone and Directional tabs collect here, and are applied all at once - each one's shadowing is worked out at a lower resolution than the single lights, then they are all added to the lighting buffer in one pass.", windowsize.x);
+                    ImGui::Text(" ");
+
+                    const char *type_names[] = {"point", "cone", "directional"};
+                    auto &list = GPU_Data.light_list();
+                    ImGui::Text("%d of %d lights", int(list.size()), LIGHT_LIST_MAX);
+                    for(auto &l : list)
+                    {
+                        ImGui::PushID(&l);
+                        ImGui::ColorButton("##light color", ImVec4(l.color.r, l.color.g, l.color.b, 1.0), 0, ImVec2(12, 12));
+                        ImGui::PopID();
+                        ImGui::SameLine();
+                        ImGui::Text("%-12s value %.3f  decay %.3f", type_names[int(l.position.w)], l.parameters.x, l.parameters.y);
+                    }
+
+                    ImGui::Text(" ");
+                    if (ImGui::Button("Apply List", ImVec2(120, 22)))
+                        GPU_Data.apply_light_list();
+                    ImGui::SameLine();
+                    if (ImGui::Button("Clear List", ImVec2(120, 22)))
+                        GPU_Data.clear_light_list();
+
+                    ImGui::Separator();
+                    ImGui::EndTabItem();
+                }
+
                 if(ImGui::BeginTabItem(" Fake GI "))
                 {
                     WrappedText("Fake GI is computed by tracing rays upwards from each cell. If they escape the volume, they get the sky_intensity added. Otherwise they take a portion of the light of the cell they hit, set by sfactor.", windowsize.x);
@@ -1651,10 +2053,33 @@ void Voraldo::ControlWindow(bool *open)
                     ImGui::SliderFloat("sfactor", &GI_scale_factor, 0.0f, 1.0f);
                     ImGui::SliderFloat("alpha threshold", &GI_alpha_thresh, 0.0f, 1.0f);
                     ImGui::SliderFloat("sky intensity", &GI_sky_intensity, 0.0f, 1.0f);
+                    ImGui::ColorEdit3("sky color", (float*)&GI_sky_color);
 
                     if(ImGui::Button("Apply GI", ImVec2(120, 22)))
                     {
-                        GPU_Data.compute_fake_GI(GI_scale_factor, GI_sky_intensity, GI_alpha_thresh);
+                        GPU_Data.compute_fake_GI(GI_scale_factor, GI_sky_intensity, GI_alpha_thresh, GI_sky_color);
+                    }
+
+                    ImGui::Separator();
+                    ImGui::EndTabItem();
+                }
+
+                if(ImGui::BeginTabItem(" Cone GI "))
+                {
+                    WrappedText("Cone traced GI gathers the light around each cell through a handful of cones, sampled from a coarse, filtered copy of the block and its lighting. Cells on a surface look out away from it, so lit surfaces bounce their color onto what faces them. Cones that leave the block get the sky.", windowsize.x);
+                    ImGui::Text(" ");
+
+                    const char *presets[] = {"fast", "balanced", "quality"};
+                    ImGui::Combo("preset", &cone_GI_preset, presets, 3);
+                    ImGui::SameLine();
+                    HelpMarker("(?)", "fast traces 6 short cones per cell, balanced 16, quality 32 that reach across the whole block with finer steps.");
+                    ImGui::SliderFloat("strength", &cone_GI_strength, 0.0f, 2.0f);
+                    ImGui::SliderFloat("sky intensity", &cone_GI_sky_intensity, 0.0f, 1.0f);
+                    ImGui::ColorEdit3("sky color", (float*)&cone_GI_sky_color);
+
+                    if(ImGui::Button("Apply Cone GI", ImVec2(120, 22)))
+                    {
+                        GPU_Data.compute_cone_GI(cone_GI_preset, cone_GI_strength, cone_GI_sky_intensity, cone_GI_sky_color);
                     }
 
                     ImGui::Separator();
@@ -1663,13 +2088,18 @@ void Voraldo::ControlWindow(bool *open)
 
                 if(ImGui::BeginTabItem(" Ambient Occlusion "))
                 {
-                    WrappedText("Ambient occlusion is based on a weighted average of the alpha values in the specified size neighborhood.", windowsize.x);
+                    WrappedText("Ambient occlusion is based on the average alpha value in a neighborhood around each cell. Three neighborhood sizes are considered at once - near, mid and far - and blended by weight, so small crevices and large enclosed spaces can both be darkened. Radius does not affect how long this takes.", windowsize.x);
                     ImGui::Text(" ");
-                    ImGui::SliderInt("radius", &AO_radius, 0, 5);
+                    ImGui::SliderInt("near radius", &AO_radii.x, 0, 127);
+                    ImGui::SliderFloat("near weight", &AO_weights.x, 0.0f, 1.0f);
+                    ImGui::SliderInt("mid radius", &AO_radii.y, 0, 127);
+                    ImGui::SliderFloat("mid weight", &AO_weights.y, 0.0f, 1.0f);
+                    ImGui::SliderInt("far radius", &AO_radii.z, 0, 127);
+                    ImGui::SliderFloat("far weight", &AO_weights.z, 0.0f, 1.0f);
 
                     if (ImGui::Button("Apply AO", ImVec2(120, 22)))
                     {
-                        GPU_Data.compute_ambient_occlusion(AO_radius);
+                        GPU_Data.compute_ambient_occlusion(AO_radii, AO_weights);
                     }
 
 
@@ -1722,6 +2152,11 @@ void Voraldo::ControlWindow(bool *open)
 
             ImGui::SliderFloat("alpha correction power", &GPU_Data.alpha_correction_power, 0.5, 4.0);
 
+            ImGui::Text(" ");
+
+            WrappedText("Rays only march through the box around what's in the block, and skip the rest of it. The box grows with edits, and is brought back in by a statistics reduction once things settle.", windowsize.x);
+            ImGui::Checkbox(" skip empty space", &GPU_Data.tight_bounds);
+
             ImGui::Text(" ");
             ImGui::Text(" ");
 
@@ -1806,9 +2241,27 @@ void Voraldo::draw_everything()
 
 
 
+    // get last frame's operation into the undo history - it's read back and compressed over the next few frames
+    GPU_Data.commit_undo();
+    GPU_Data.poll_undo();
+
+    // bring the lighting up to date with any edits made last frame, if that's turned on
+    if(GPU_Data.auto_relight)
+        GPU_Data.relight_dirty();
+
+    // same for the distance field, if there is one
+    if(GPU_Data.auto_update_distance)
+        GPU_Data.update_distance_field();
+
+    // pick up statistics, if the GPU is done with them - and keep the box the raycaster marches through tight
+    GPU_Data.poll_statistics();
+    GPU_Data.update_content_box();
+
     // draw the stuff on the GPU (block and orientation widget)
     GPU_Data.display();
 
+    // start one more of the deferred compute shaders compiling in the background, if there are any left
+    GPU_Data.prewarm_shaders(1);
 
 
     // Start the Dear ImGui frame
@@ -1899,6 +2352,13 @@ void Voraldo::draw_everything()
         if(event.type == SDL_KEYDOWN  && event.key.keysym.sym == SDLK_j)
             GPU_Data.clickndragy -= SDL_GetModState() & KMOD_SHIFT ? 50 : 5;
 
+
+        // undo and redo - not while typing in a text box, where these undo the typing instead
+        bool typing = ImGui::GetIO().WantCaptureKeyboard;
+        if(!typing && event.type == SDL_KEYDOWN  && event.key.keysym.sym == SDLK_z && (SDL_GetModState() & KMOD_CTRL))
+            GPU_Data.undo();
+        if(!typing && event.type == SDL_KEYDOWN  && event.key.keysym.sym == SDLK_y && (SDL_GetModState() & KMOD_CTRL))
+            GPU_Data.redo();
         
         // snap to cardinal directions
         if(event.type == SDL_KEYDOWN  && event.key.keysym.sym == SDLK_F1)